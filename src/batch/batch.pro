@@ -0,0 +1,23 @@
+# Command line batch inference and monitoring (bayes-batch)
+
+QT = core network
+CONFIG += console
+CONFIG -= app_bundle
+
+TARGET = bayes-batch
+TEMPLATE = app
+
+INCLUDEPATH += ../libbayes
+LIBS += -L$$OUT_PWD/../libbayes -lbayes
+unix:QMAKE_RPATHDIR += $$OUT_PWD/../libbayes
+
+SOURCES += \
+    main.cpp \
+    evidenceparser.cpp \
+    batchjob.cpp \
+    monitorjob.cpp
+
+HEADERS += \
+    evidenceparser.h \
+    batchjob.h \
+    monitorjob.h
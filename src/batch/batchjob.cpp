@@ -0,0 +1,299 @@
+/*
+    Copyright (C) 2012 Ivan Radicek
+
+    This file is part of Bayes.
+
+    Bayes is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bayes is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Bayes.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "batchjob.h"
+
+#include <QIODevice>
+#include <QThread>
+
+#include <stdio.h>
+
+#include "networksnapshot.h"
+
+// Rows in one chunk of work
+static const int chunkRows = 1024;
+
+// Chunks read but not yet written (per worker)
+static const int chunksPerWorker = 4;
+
+/*
+ * Thread running BatchJob::work()
+ */
+class BatchWorker : public QThread {
+
+public:
+    BatchWorker(BatchJob *job) {
+        this->job = job;
+    }
+
+protected:
+    void run() {
+        job->work();
+    }
+
+private:
+    BatchJob *job;
+};
+
+/*
+ * Creates job answering queries on `queryNodes' of network compiled to `tree'
+ */
+BatchJob::BatchJob(const NetworkSnapshot &network, const JunctionTree &tree,
+                   EvidenceParser::Format format, QVector<int> queryNodes)
+    : parser(network, format) {
+    this->tree = tree;
+    nodes = queryNodes;
+    nextResult = 0;
+    inputDone = false;
+
+    foreach ( int n, nodes ) {
+        names << network.nodeName(n);
+        values << network.values(n);
+    }
+}
+
+/*
+ * Reads all rows from `input' and writes their posteriors to `output' using
+ * `threads' workers; returns false if input can not be read
+ */
+bool BatchJob::run(QIODevice *input, QIODevice *output, int threads) {
+    qint64 line = 0;
+
+    // CSV starts with names of evidence columns (empty read is end of input,
+    // atEnd() is not reliable for pipes)
+    if ( parser.format() == EvidenceParser::Csv ) {
+        QByteArray row;
+        do {
+            row = input->readLine();
+            ++line;
+        } while ( !row.isEmpty() && row.trimmed().isEmpty() );
+
+        QString error = "Missing header";
+        if ( row.isEmpty() || !parser.setHeader(row.trimmed(), error) ) {
+            fprintf(stderr, "bayes-batch: %s\n", error.toUtf8().constData());
+            return false;
+        }
+    }
+    output->write(header());
+
+    QList<BatchWorker*> workers;
+    for ( int i=0; i<qMax(1, threads); ++i ) {
+        workers << new BatchWorker(this);
+        workers.last()->start();
+    }
+
+    int count = 0;
+    bool more = true;
+    while ( more ) {
+        BatchChunk chunk;
+        chunk.index = count;
+        chunk.firstLine = line + 1;
+
+        while ( chunk.rows.length() < chunkRows ) {
+            QByteArray row = input->readLine();
+            if ( row.isEmpty() ) {
+                more = false;
+                break;
+            }
+
+            chunk.rows << row;
+            ++line;
+        }
+
+        if ( chunk.rows.isEmpty() ) {
+            break;
+        }
+        ++count;
+
+        // Wait until there are not too many unwritten chunks, writing
+        // answers meanwhile
+        mutex.lock();
+        writeReady(output);
+        int limit = chunksPerWorker * workers.length();
+        while ( chunk.index - nextResult >= limit ) {
+            changed.wait(&mutex);
+            writeReady(output);
+        }
+        chunks.enqueue(chunk);
+        changed.wakeAll();
+        mutex.unlock();
+    }
+
+    // Rest of answers
+    mutex.lock();
+    inputDone = true;
+    changed.wakeAll();
+    writeReady(output);
+    while ( nextResult < count ) {
+        changed.wait(&mutex);
+        writeReady(output);
+    }
+    mutex.unlock();
+
+    foreach ( BatchWorker *w, workers ) {
+        w->wait();
+        delete w;
+    }
+
+    return true;
+}
+
+/*
+ * Writes answers which are next in order (called with mutex locked, it is
+ * released while writing)
+ */
+void BatchJob::writeReady(QIODevice *output) {
+    while ( results.contains(nextResult) ) {
+        QByteArray text = results.take(nextResult++);
+
+        mutex.unlock();
+        output->write(text);
+        mutex.lock();
+    }
+}
+
+/*
+ * Worker loop - answers chunks until input is done
+ */
+void BatchJob::work() {
+    JunctionTree own = tree;
+
+    while ( true ) {
+        mutex.lock();
+        while ( chunks.isEmpty() && !inputDone ) {
+            changed.wait(&mutex);
+        }
+
+        if ( chunks.isEmpty() ) {
+            mutex.unlock();
+            return;
+        }
+
+        BatchChunk chunk = chunks.dequeue();
+        mutex.unlock();
+
+        QByteArray answers;
+        for ( int i=0; i<chunk.rows.length(); ++i ) {
+            answers += answer(own, chunk.rows.at(i), chunk.firstLine + i);
+        }
+
+        mutex.lock();
+        results[chunk.index] = answers;
+        changed.wakeAll();
+        mutex.unlock();
+    }
+}
+
+/*
+ * Gets first line of output (CSV header with column for every value of
+ * query nodes)
+ */
+QByteArray BatchJob::header() const {
+    if ( parser.format() != EvidenceParser::Csv ) {
+        return QByteArray();
+    }
+
+    QList<QByteArray> columns;
+    for ( int i=0; i<nodes.size(); ++i ) {
+        foreach ( QString v, values.at(i) ) {
+            columns << EvidenceParser::quoteCsv(names.at(i) + "=" + v);
+        }
+    }
+
+    QByteArray h;
+    foreach ( QByteArray c, columns ) {
+        h += (h.isEmpty() ? "" : ",") + c;
+    }
+
+    return h + "\n";
+}
+
+/*
+ * Answers one row of evidence (empty rows are skipped)
+ */
+QByteArray BatchJob::answer(JunctionTree &tree, QByteArray row,
+                            qint64 line) const {
+    row = row.trimmed();
+    if ( row.isEmpty() ) {
+        return QByteArray();
+    }
+
+    QVector<int> evidence;
+    QString error;
+    bool ok = parser.parse(row, evidence, error);
+
+    if ( ok ) {
+        for ( int n=0; n<evidence.size(); ++n ) {
+            tree.setEvidence(n, evidence.at(n));
+        }
+    } else {
+        fprintf(stderr, "bayes-batch: line %lld: %s\n", (long long) line,
+                error.toUtf8().constData());
+    }
+
+    QByteArray out;
+    bool csv = parser.format() == EvidenceParser::Csv;
+
+    if ( !csv ) {
+        out += "{";
+    }
+
+    for ( int i=0; i<nodes.size(); ++i ) {
+        QVector<double> p;
+        if ( ok ) {
+            p = tree.marginal(nodes.at(i));
+        }
+
+        if ( csv ) {
+            for ( int v=0; v<values.at(i).length(); ++v ) {
+                if ( i > 0 || v > 0 ) {
+                    out += ",";
+                }
+                if ( ok ) {
+                    out += QByteArray::number(p.at(v), 'g', 8);
+                }
+            }
+            continue;
+        }
+
+        if ( i > 0 ) {
+            out += ",";
+        }
+        out += EvidenceParser::quoteJson(names.at(i)) + ":";
+
+        if ( !ok ) {
+            out += "null";
+            continue;
+        }
+
+        out += "{";
+        for ( int v=0; v<values.at(i).length(); ++v ) {
+            out += (v > 0 ? "," : "") +
+                   EvidenceParser::quoteJson(values.at(i).at(v)) + ":" +
+                   QByteArray::number(p.at(v), 'g', 8);
+        }
+        out += "}";
+    }
+
+    if ( !csv ) {
+        out += "}";
+    }
+
+    return out + "\n";
+}
@@ -0,0 +1,83 @@
+/*
+    Copyright (C) 2012 Ivan Radicek
+
+    This file is part of Bayes.
+
+    Bayes is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bayes is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Bayes.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BATCHJOB_H
+#define BATCHJOB_H
+
+#include <QByteArray>
+#include <QList>
+#include <QMap>
+#include <QMutex>
+#include <QQueue>
+#include <QVector>
+#include <QWaitCondition>
+
+#include "junctiontree.h"
+#include "evidenceparser.h"
+
+class QIODevice;
+class NetworkSnapshot;
+
+/*
+ * Rows of input processed together (worker gets whole chunk)
+ */
+struct BatchChunk {
+    int index;
+    qint64 firstLine;
+    QList<QByteArray> rows;
+};
+
+/*
+ * Batch inference: evidence rows are read in chunks, answered by worker
+ * threads (each with its own copy of junction tree) and posteriors of query
+ * nodes are written in order of input rows, in same format as input (row
+ * with invalid evidence gets empty posteriors and warning on stderr).
+ */
+class BatchJob {
+
+public:
+    BatchJob(const NetworkSnapshot &network, const JunctionTree &tree,
+             EvidenceParser::Format format, QVector<int> queryNodes);
+
+    bool run(QIODevice *input, QIODevice *output, int threads);
+
+    void work();
+
+private:
+    QByteArray header() const;
+    QByteArray answer(JunctionTree &tree, QByteArray row,
+                      qint64 line) const;
+    void writeReady(QIODevice *output);
+
+    JunctionTree tree;
+    EvidenceParser parser;
+    QVector<int> nodes;
+    QVector<QString> names;
+    QVector<QStringList> values;
+
+    // Shared by reader, workers and writer
+    QMutex mutex;
+    QWaitCondition changed;
+    QQueue<BatchChunk> chunks;
+    QMap<int, QByteArray> results;
+    int nextResult;
+    bool inputDone;
+};
+
+#endif // BATCHJOB_H
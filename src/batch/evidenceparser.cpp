@@ -0,0 +1,349 @@
+/*
+    Copyright (C) 2012 Ivan Radicek
+
+    This file is part of Bayes.
+
+    Bayes is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bayes is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Bayes.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "evidenceparser.h"
+
+#include "networksnapshot.h"
+
+/*
+ * Moves `i' past white space
+ */
+static void skipSpace(const QString &s, int &i) {
+    while ( i < s.length() && s.at(i).isSpace() ) {
+        ++i;
+    }
+}
+
+/*
+ * Moves `i' past character `c' (and white space before it) if it is next
+ */
+static bool expect(const QString &s, int &i, char c) {
+    skipSpace(s, i);
+
+    if ( i < s.length() && s.at(i) == c ) {
+        ++i;
+        return true;
+    }
+
+    return false;
+}
+
+/*
+ * Reads JSON string literal starting at `i' (after white space)
+ */
+static bool readString(const QString &s, int &i, QString &str) {
+    if ( !expect(s, i, '"') ) {
+        return false;
+    }
+
+    str = "";
+    for ( ; i < s.length(); ++i ) {
+        QChar c = s.at(i);
+
+        if ( c == '"' ) {
+            ++i;
+            return true;
+
+        } else if ( c != '\\' || i+1 >= s.length() ) {
+            str += c;
+            continue;
+        }
+
+        QChar e = s.at(++i);
+        if ( e == 'n' ) {
+            str += '\n';
+        } else if ( e == 't' ) {
+            str += '\t';
+        } else if ( e == 'r' ) {
+            str += '\r';
+        } else if ( e == 'b' ) {
+            str += '\b';
+        } else if ( e == 'f' ) {
+            str += '\f';
+        } else if ( e == 'u' && i+4 < s.length() ) {
+            str += QChar(s.mid(i+1, 4).toUShort(0, 16));
+            i += 4;
+        } else {
+            str += e;
+        }
+    }
+
+    return false;
+}
+
+/*
+ * Creates parser for evidence of `network' in given format
+ */
+EvidenceParser::EvidenceParser(const NetworkSnapshot &network, Format format) {
+    fmt = format;
+    nodeCount = network.nodeCount();
+
+    for ( int i=0; i<nodeCount; ++i ) {
+        if ( !nodeIds.contains(network.nodeName(i)) ) {
+            nodeIds[network.nodeName(i)] = i;
+        }
+
+        QHash<QString, int> ids;
+        QStringList values = network.values(i);
+        for ( int v=0; v<values.length(); ++v ) {
+            ids[values.at(v)] = v;
+        }
+        valueIds << ids;
+    }
+}
+
+/*
+ * Gets format of rows
+ */
+EvidenceParser::Format EvidenceParser::format() const {
+    return fmt;
+}
+
+/*
+ * Sets CSV header - names of nodes whose evidence columns hold
+ */
+bool EvidenceParser::setHeader(QByteArray line, QString &error) {
+    columns.clear();
+
+    foreach ( QString name, splitCsv(QString::fromUtf8(line)) ) {
+        if ( !nodeIds.contains(name) ) {
+            error = "Unknown node in header: " + name;
+            return false;
+        }
+        columns << nodeIds.value(name);
+    }
+
+    return true;
+}
+
+/*
+ * Parses one row into evidence (value index of every node, -1 for none)
+ */
+bool EvidenceParser::parse(QByteArray line, QVector<int> &evidence,
+                           QString &error) const {
+    evidence.fill(-1, nodeCount);
+
+    if ( fmt == Jsonl ) {
+        QList<QPair<int, int> > changes;
+        if ( !parseJson(QString::fromUtf8(line), changes, error) ) {
+            return false;
+        }
+
+        for ( int i=0; i<changes.length(); ++i ) {
+            evidence[changes.at(i).first] = changes.at(i).second;
+        }
+        return true;
+    }
+
+    QStringList cells = splitCsv(QString::fromUtf8(line));
+    if ( cells.length() != columns.size() ) {
+        error = QString("Row has %1 cells, header has %2")
+                .arg(cells.length()).arg(columns.size());
+        return false;
+    }
+
+    for ( int i=0; i<cells.length(); ++i ) {
+        if ( cells.at(i).isEmpty() ) {
+            continue;
+        }
+
+        int node = columns.at(i);
+        int value = valueIds.at(node).value(cells.at(i), -1);
+        if ( value < 0 ) {
+            error = "Unknown value " + cells.at(i) + " of node " +
+                    nodeIds.key(node);
+            return false;
+        }
+        evidence[node] = value;
+    }
+
+    return true;
+}
+
+/*
+ * Parses JSON object as changes of evidence - pairs of node and value index
+ * (-1 removes evidence)
+ */
+bool EvidenceParser::parseChanges(QByteArray line,
+                                  QList<QPair<int, int> > &changes,
+                                  QString &error) const {
+    changes.clear();
+
+    return parseJson(QString::fromUtf8(line), changes, error);
+}
+
+/*
+ * Finds indexes of named node and its value (null value is -1)
+ */
+bool EvidenceParser::lookup(QString node, QString value,
+                            QPair<int, int> &change, QString &error) const {
+    change.first = nodeIds.value(node, -1);
+    if ( change.first < 0 ) {
+        error = "Unknown node " + node;
+        return false;
+    }
+
+    change.second = value.isNull() ? -1 :
+                    valueIds.at(change.first).value(value, -1);
+    if ( change.second < 0 && !value.isNull() ) {
+        error = "Unknown value " + value + " of node " + node;
+        return false;
+    }
+
+    return true;
+}
+
+/*
+ * Parses flat JSON object of node names and values (strings, numbers and
+ * booleans are taken as text, null is no evidence)
+ */
+bool EvidenceParser::parseJson(QString line, QList<QPair<int, int> > &changes,
+                               QString &error) const {
+    int i = 0;
+
+    if ( !expect(line, i, '{') ) {
+        error = "Row is not JSON object";
+        return false;
+    }
+
+    if ( expect(line, i, '}') ) {
+        return true;
+    }
+
+    while ( true ) {
+        QString node;
+        QString value;
+
+        if ( !readString(line, i, node) || !expect(line, i, ':') ) {
+            break;
+        }
+
+        skipSpace(line, i);
+        if ( i < line.length() && line.at(i) == '"' ) {
+            if ( !readString(line, i, value) ) {
+                break;
+            }
+
+        } else {
+            int start = i;
+            while ( i < line.length() && line.at(i) != ',' &&
+                    line.at(i) != '}' && !line.at(i).isSpace() ) {
+                ++i;
+            }
+            value = line.mid(start, i - start);
+
+            if ( value.isEmpty() ) {
+                break;
+            } else if ( value == "null" ) {
+                value = QString();
+            }
+        }
+
+        QPair<int, int> change;
+        if ( !lookup(node, value, change, error) ) {
+            return false;
+        }
+        changes << change;
+
+        if ( expect(line, i, '}') ) {
+            return true;
+        } else if ( !expect(line, i, ',') ) {
+            break;
+        }
+    }
+
+    error = "Invalid JSON object";
+    return false;
+}
+
+/*
+ * Splits CSV line into cells (quoted cells can hold commas and doubled
+ * quotes)
+ */
+QStringList EvidenceParser::splitCsv(QString line) {
+    QStringList cells;
+    QString cell;
+    bool quoted = false;
+
+    for ( int i=0; i<line.length(); ++i ) {
+        QChar c = line.at(i);
+
+        if ( quoted ) {
+            if ( c != '"' ) {
+                cell += c;
+            } else if ( i+1 < line.length() && line.at(i+1) == '"' ) {
+                cell += c;
+                ++i;
+            } else {
+                quoted = false;
+            }
+
+        } else if ( c == '"' ) {
+            quoted = true;
+
+        } else if ( c == ',' ) {
+            cells << cell.trimmed();
+            cell.clear();
+
+        } else {
+            cell += c;
+        }
+    }
+    cells << cell.trimmed();
+
+    return cells;
+}
+
+/*
+ * Quotes CSV cell if it needs it
+ */
+QByteArray EvidenceParser::quoteCsv(QString field) {
+    QByteArray f = field.toUtf8();
+
+    if ( f.contains(',') || f.contains('"') || f.contains('\n') ||
+         f != f.trimmed() ) {
+        f.replace("\"", "\"\"");
+        f = "\"" + f + "\"";
+    }
+
+    return f;
+}
+
+/*
+ * Writes string as JSON string literal
+ */
+QByteArray EvidenceParser::quoteJson(QString s) {
+    QByteArray q = "\"";
+
+    foreach ( char c, s.toUtf8() ) {
+        if ( c == '"' || c == '\\' ) {
+            q += '\\';
+            q += c;
+        } else if ( c == '\n' ) {
+            q += "\\n";
+        } else if ( (unsigned char) c < 0x20 ) {
+            q += "\\u00" +
+                 QByteArray::number((int) c, 16).rightJustified(2, '0');
+        } else {
+            q += c;
+        }
+    }
+
+    return q + "\"";
+}
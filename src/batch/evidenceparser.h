@@ -0,0 +1,74 @@
+/*
+    Copyright (C) 2012 Ivan Radicek
+
+    This file is part of Bayes.
+
+    Bayes is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bayes is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Bayes.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef EVIDENCEPARSER_H
+#define EVIDENCEPARSER_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QPair>
+#include <QVector>
+#include <QStringList>
+
+class NetworkSnapshot;
+
+/*
+ * Parsing of evidence rows into value index of every node (-1 for nodes
+ * without evidence). Rows are either CSV lines, whose columns are named by
+ * header line (empty cell is no evidence), or JSON objects mapping node names
+ * to values, one per line (null is no evidence). JSON object can also be
+ * parsed as changes of evidence (null removes evidence of node).
+ */
+class EvidenceParser {
+
+public:
+    enum Format {
+        Csv,
+        Jsonl
+    };
+
+    EvidenceParser(const NetworkSnapshot &network, Format format);
+
+    Format format() const;
+    bool setHeader(QByteArray line, QString &error);
+    bool parse(QByteArray line, QVector<int> &evidence, QString &error) const;
+    bool parseChanges(QByteArray line, QList<QPair<int, int> > &changes,
+                      QString &error) const;
+
+    static QStringList splitCsv(QString line);
+    static QByteArray quoteCsv(QString field);
+    static QByteArray quoteJson(QString s);
+
+private:
+    bool lookup(QString node, QString value, QPair<int, int> &change,
+                QString &error) const;
+    bool parseJson(QString line, QList<QPair<int, int> > &changes,
+                   QString &error) const;
+
+    Format fmt;
+    int nodeCount;
+
+    QHash<QString, int> nodeIds;
+    QVector<QHash<QString, int> > valueIds;
+
+    // Node of every CSV column
+    QVector<int> columns;
+};
+
+#endif // EVIDENCEPARSER_H
@@ -0,0 +1,201 @@
+/*
+    Copyright (C) 2012 Ivan Radicek
+
+    This file is part of Bayes.
+
+    Bayes is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bayes is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Bayes.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <QCoreApplication>
+#include <QFile>
+#include <QStringList>
+#include <QThread>
+
+#include <stdio.h>
+
+#include "network.h"
+#include "networksnapshot.h"
+#include "netfile.h"
+#include "junctiontree.h"
+#include "compilecache.h"
+#include "batchjob.h"
+#include "monitorjob.h"
+
+/*
+ * Prints usage
+ */
+static void usage() {
+    fprintf(stderr,
+            "Usage: bayes-batch [options] network.net [evidence]\n"
+            "       bayes-batch --monitor [options] network.net [changes]\n"
+            "\n"
+            "Answers queries for every row of evidence (file or standard\n"
+            "input) and writes posteriors in order of rows. Monitor mode\n"
+            "reads lines of evidence changes (jsonl, null removes evidence)\n"
+            "and writes posteriors of query nodes which have changed.\n"
+            "\n"
+            "Options:\n"
+            "  -t, --threads N      number of worker threads\n"
+            "  -f, --format F       evidence format: csv (header with node\n"
+            "                       names) or jsonl (object per line)\n"
+            "  -n, --nodes A,B,...  query nodes (all nodes by default)\n"
+            "  -o, --output FILE    output file (standard output by\n"
+            "                       default)\n"
+            "  -m, --monitor        monitor mode\n"
+            "  -d, --threshold P    smallest reported change of posterior\n"
+            "                       in monitor mode (0 by default)\n"
+            "  -s, --socket NAME    read changes from clients of local\n"
+            "                       socket instead of file in monitor mode\n"
+            "  -c, --convert FILE   write network to FILE (binary if it\n"
+            "                       ends with .netb) and exit\n"
+            "      --no-cache       always compile network (do not use\n"
+            "                       cache of compiled networks)\n");
+}
+
+/*
+ * Prints error and returns exit code for it
+ */
+static int fail(QString message) {
+    fprintf(stderr, "bayes-batch: %s\n", message.toUtf8().constData());
+    return 1;
+}
+
+int main(int argc, char *argv[]) {
+    QCoreApplication a(argc, argv);
+    QStringList args = a.arguments();
+    args.removeFirst();
+
+    int threads = QThread::idealThreadCount();
+    QString format;
+    QStringList queryNames;
+    QString outputName;
+    QStringList files;
+    bool monitor = false;
+    double threshold = 0.0;
+    QString socketName;
+    QString convertName;
+    bool cache = true;
+
+    while ( !args.isEmpty() ) {
+        QString arg = args.takeFirst();
+        bool hasValue = !args.isEmpty();
+
+        if ( (arg == "-t" || arg == "--threads") && hasValue ) {
+            threads = args.takeFirst().toInt();
+        } else if ( (arg == "-f" || arg == "--format") && hasValue ) {
+            format = args.takeFirst().toLower();
+        } else if ( (arg == "-n" || arg == "--nodes") && hasValue ) {
+            queryNames = args.takeFirst().split(',');
+        } else if ( (arg == "-o" || arg == "--output") && hasValue ) {
+            outputName = args.takeFirst();
+        } else if ( arg == "-m" || arg == "--monitor" ) {
+            monitor = true;
+        } else if ( (arg == "-d" || arg == "--threshold") && hasValue ) {
+            threshold = args.takeFirst().toDouble();
+        } else if ( (arg == "-s" || arg == "--socket") && hasValue ) {
+            socketName = args.takeFirst();
+        } else if ( (arg == "-c" || arg == "--convert") && hasValue ) {
+            convertName = args.takeFirst();
+        } else if ( arg == "--no-cache" ) {
+            cache = false;
+        } else if ( arg.startsWith('-') && arg != "-" ) {
+            usage();
+            return 1;
+        } else {
+            files << arg;
+        }
+    }
+
+    if ( files.isEmpty() || files.length() > 2 || threads < 1 ) {
+        usage();
+        return 1;
+    }
+
+    // Format follows extension of evidence file unless given
+    QString evidenceName = files.value(1, "-");
+    if ( format.isEmpty() && monitor ) {
+        format = "jsonl";
+    } else if ( format.isEmpty() ) {
+        format = evidenceName.endsWith(".jsonl") ? "jsonl" : "csv";
+    }
+    if ( format != "csv" && format != "jsonl" ) {
+        return fail("Unknown format " + format);
+    }
+    if ( monitor && format != "jsonl" ) {
+        return fail("Monitor mode reads only jsonl");
+    }
+
+    // Network
+    Network network;
+    QString error;
+    if ( !NetFile::read(files.first(), &network, error) ) {
+        return fail(error);
+    }
+
+    if ( !convertName.isEmpty() ) {
+        return NetFile::write(convertName, &network, error) ? 0 : fail(error);
+    }
+
+    NetworkSnapshot snapshot = network.snapshot();
+
+    QVector<int> nodes;
+    if ( queryNames.isEmpty() ) {
+        for ( int i=0; i<snapshot.nodeCount(); ++i ) {
+            nodes << i;
+        }
+    }
+    foreach ( QString name, queryNames ) {
+        int id = network.nodeId(name.trimmed());
+        if ( id < 0 ) {
+            return fail("Unknown node " + name);
+        }
+        nodes << id;
+    }
+
+    JunctionTree tree = cache ? CompileCache().tree(snapshot) :
+                                JunctionTree(snapshot);
+
+    if ( monitor && !socketName.isEmpty() ) {
+        MonitorJob job(snapshot, tree, nodes, threshold);
+        return job.serve(socketName) ? 0 : 1;
+    }
+
+    // Input and output
+    QFile input(evidenceName);
+    bool inputOpen = evidenceName == "-" ?
+                     input.open(stdin, QIODevice::ReadOnly) :
+                     input.open(QIODevice::ReadOnly);
+    if ( !inputOpen ) {
+        return fail("Cannot open file " + evidenceName);
+    }
+
+    QFile output(outputName);
+    bool outputOpen = outputName.isEmpty() ?
+                      output.open(stdout, QIODevice::WriteOnly) :
+                      output.open(QIODevice::WriteOnly | QIODevice::Truncate);
+    if ( !outputOpen ) {
+        return fail("Cannot open file " + outputName);
+    }
+
+    if ( monitor ) {
+        MonitorJob job(snapshot, tree, nodes, threshold);
+        return job.run(&input, &output) ? 0 : 1;
+    }
+
+    BatchJob job(snapshot, tree,
+                 format == "csv" ? EvidenceParser::Csv : EvidenceParser::Jsonl,
+                 nodes);
+
+    return job.run(&input, &output, threads) ? 0 : 1;
+}
@@ -0,0 +1,173 @@
+/*
+    Copyright (C) 2012 Ivan Radicek
+
+    This file is part of Bayes.
+
+    Bayes is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bayes is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Bayes.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "monitorjob.h"
+
+#include <QFile>
+#include <QLocalServer>
+#include <QLocalSocket>
+
+#include <stdio.h>
+
+/*
+ * Creates job watching `watched' nodes of network compiled to `tree'
+ */
+MonitorJob::MonitorJob(const NetworkSnapshot &network,
+                       const JunctionTree &tree, QVector<int> watched,
+                       double threshold)
+    : parser(network, EvidenceParser::Jsonl), monitor(tree, threshold) {
+    this->network = network;
+    updates = 0;
+
+    foreach ( int n, watched ) {
+        monitor.watch(n);
+    }
+    monitor.update();
+    initial = monitor;
+}
+
+/*
+ * Applies evidence changes read from `input' until its end and writes
+ * reports to `output' (starting with current posteriors of all watched
+ * nodes)
+ */
+bool MonitorJob::run(QIODevice *input, QIODevice *output) {
+    output->write(report(monitor.watched()));
+    flush(output);
+
+    QByteArray row;
+    QList<QPair<int, int> > changes;
+    QString error;
+
+    while ( readRow(input, row) ) {
+        row = row.trimmed();
+        if ( row.isEmpty() ) {
+            continue;
+        }
+
+        if ( !parser.parseChanges(row, changes, error) ) {
+            fprintf(stderr, "bayes-batch: update %lld: %s\n",
+                    (long long) updates + 1, error.toUtf8().constData());
+            continue;
+        }
+
+        for ( int i=0; i<changes.length(); ++i ) {
+            monitor.setEvidence(changes.at(i).first, changes.at(i).second);
+        }
+        ++updates;
+
+        QVector<int> changed = monitor.update();
+        if ( !changed.isEmpty() ) {
+            output->write(report(changed));
+        }
+
+        // Reports are flushed once input waiting for processing is done
+        if ( input->bytesAvailable() == 0 ) {
+            flush(output);
+        }
+    }
+
+    flush(output);
+
+    return true;
+}
+
+/*
+ * Serves clients connecting to local socket one after another (evidence of
+ * one client is not seen by next one)
+ */
+bool MonitorJob::serve(QString socketName) {
+    QLocalServer server;
+    QLocalServer::removeServer(socketName);
+
+    if ( !server.listen(socketName) ) {
+        fprintf(stderr, "bayes-batch: %s\n",
+                server.errorString().toUtf8().constData());
+        return false;
+    }
+
+    while ( server.waitForNewConnection(-1) ) {
+        QLocalSocket *client = server.nextPendingConnection();
+        monitor = initial;
+        updates = 0;
+        run(client, client);
+
+        // Last reports may still be waiting in socket buffer
+        while ( client->bytesToWrite() > 0 &&
+                client->waitForBytesWritten(-1) ) {
+        }
+        client->disconnectFromServer();
+        delete client;
+    }
+
+    return true;
+}
+
+/*
+ * Reads next line (blocking until it arrives); returns false at end of input
+ */
+bool MonitorJob::readRow(QIODevice *input, QByteArray &row) {
+    QLocalSocket *socket = qobject_cast<QLocalSocket*>(input);
+
+    if ( socket != NULL ) {
+        while ( !socket->canReadLine() ) {
+            if ( !socket->waitForReadyRead(-1) ) {
+                row = socket->readAll();
+                return !row.isEmpty();
+            }
+        }
+    }
+
+    row = input->readLine();
+
+    return !row.isEmpty();
+}
+
+/*
+ * Pushes written reports out to reader
+ */
+void MonitorJob::flush(QIODevice *output) {
+    if ( QFile *file = qobject_cast<QFile*>(output) ) {
+        file->flush();
+    } else if ( QLocalSocket *socket = qobject_cast<QLocalSocket*>(output) ) {
+        socket->flush();
+    }
+}
+
+/*
+ * Gets report line with posteriors of `nodes'
+ */
+QByteArray MonitorJob::report(QVector<int> nodes) const {
+    QByteArray out = "{\"update\":" + QByteArray::number(updates);
+
+    foreach ( int n, nodes ) {
+        QStringList values = network.values(n);
+        QVector<double> p = monitor.posterior(n);
+
+        out += "," + EvidenceParser::quoteJson(network.nodeName(n)) + ":{";
+        for ( int v=0; v<values.length(); ++v ) {
+            out += (v > 0 ? "," : "") +
+                   EvidenceParser::quoteJson(values.at(v)) + ":" +
+                   QByteArray::number(p.value(v), 'g', 8);
+        }
+        out += "}";
+    }
+
+    return out + "}\n";
+}
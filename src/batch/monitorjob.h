@@ -0,0 +1,62 @@
+/*
+    Copyright (C) 2012 Ivan Radicek
+
+    This file is part of Bayes.
+
+    Bayes is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bayes is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Bayes.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MONITORJOB_H
+#define MONITORJOB_H
+
+#include <QByteArray>
+#include <QStringList>
+#include <QVector>
+
+#include "networksnapshot.h"
+#include "monitor.h"
+#include "evidenceparser.h"
+
+class QIODevice;
+
+/*
+ * Online monitoring: every input line is JSON object of evidence changes and
+ * watched nodes whose posterior has changed by more than threshold are
+ * written as one JSON line ({"update":n,"Node":{"Value":p,...},...}); nothing
+ * is written for changes which moved none of them. Input comes from pipe or
+ * from clients of local socket (every client starts from evidence network
+ * was compiled with).
+ */
+class MonitorJob {
+
+public:
+    MonitorJob(const NetworkSnapshot &network, const JunctionTree &tree,
+               QVector<int> watched, double threshold);
+
+    bool run(QIODevice *input, QIODevice *output);
+    bool serve(QString socketName);
+
+private:
+    static bool readRow(QIODevice *input, QByteArray &row);
+    static void flush(QIODevice *output);
+    QByteArray report(QVector<int> nodes) const;
+
+    NetworkSnapshot network;
+    EvidenceParser parser;
+    Monitor monitor;
+    Monitor initial; // Monitor before any evidence changes were read
+    qint64 updates;
+};
+
+#endif // MONITORJOB_H
@@ -1,4 +1,4 @@
-QT += gui core
+QT += gui core network
 
 TARGET = bayes-gui
 TEMPLATE = app
@@ -6,12 +6,18 @@ TEMPLATE = app
 INCLUDEPATH += $(SEXPR)
 LIBS += -L$(SEXPR) -lsexp
 
+# Network model comes from libbayes (built first by bayes.pro)
+INCLUDEPATH += libbayes
+LIBS += -L$$OUT_PWD/libbayes -lbayes
+unix:QMAKE_RPATHDIR += $$OUT_PWD/libbayes
+
+# shm_open lives in librt with older glibc
+linux-*:LIBS += -lrt
+
 SOURCES += \
     main.cpp \
     mainwindow.cpp \
     settings.cpp \
-    network.cpp \
-    node.cpp \
     networkeditor.cpp \
     engine.cpp \
     networkdock.cpp \
@@ -22,13 +28,17 @@ SOURCES += \
     valuemodel.cpp \
     edgemodel.cpp \
     probabilitymodel.cpp \
-    settingsdialog.cpp
+    settingsdialog.cpp \
+    querycache.cpp \
+    queryscheduler.cpp \
+    enginewriter.cpp \
+    engineio.cpp \
+    enginepool.cpp \
+    sharedsegment.cpp
 
 HEADERS += \
     mainwindow.h \
     settings.h \
-    network.h \
-    node.h \
     networkeditor.h \
     engine.h \
     networkdock.h \
@@ -39,4 +49,11 @@ HEADERS += \
     valuemodel.h \
     edgemodel.h \
     probabilitymodel.h \
-    settingsdialog.h
+    settingsdialog.h \
+    querycache.h \
+    queryscheduler.h \
+    enginewriter.h \
+    engineio.h \
+    enginepool.h \
+    sharedsegment.h \
+    spscqueue.h
@@ -0,0 +1,12 @@
+# Builds inference library, GUI and command line tools using it
+
+TEMPLATE = subdirs
+
+SUBDIRS = libbayes gui batch tests
+
+gui.file = bayes-gui.pro
+gui.depends = libbayes
+
+batch.depends = libbayes
+
+tests.depends = libbayes
@@ -22,35 +22,37 @@
 #include "settings.h"
 
 #include <stdio.h>
-#include <QApplication>
+#include <QThread>
 
 #include "node.h"
+#include "networksnapshot.h"
+#include "enginewriter.h"
+#include "engineio.h"
+#include "sharedsegment.h"
+
+int Engine::lastRequest = 0;
 
 /*
- * Inits communication witj Lisp engine
+ * Inits communication witj Lisp engine (process is run and its output parsed
+ * in separate I/O thread)
  */
 Engine::Engine(QObject *parent) : QObject(parent) {
 
-    // Internal S-Expression parser stuff
-    sexp = NULL;
-    cont = NULL;
-
-    // Set up process
-    process = new QProcess(this);
-    QString enginePath = Settings::enginePath();
-
-    // Setup communication
-    connect(process, SIGNAL(readyReadStandardOutput()),
-            this, SLOT(dataReady()));
-    connect(process, SIGNAL(readyReadStandardError()),
-            this, SLOT(errorReady()));
-
-    // Start process
-    //process->setWorkingDirectory(QApplication::applicationDirPath()
-    //                                                    + "/../src/lisp/");
-    //printf("wdir: %s\n", process->workingDirectory().toUtf8().data());
-    process->start(enginePath);
-    process->waitForStarted(-1);
+    // Engine starts talking S-Expressions
+    proto = SexpProtocol;
+    exited = false;
+
+    // Set up I/O thread
+    ioThread = new QThread(this);
+    io = new EngineIO(Settings::enginePath(), Settings::engineSocket(), this);
+    io->moveToThread(ioThread);
+    connect(ioThread, SIGNAL(started()), io, SLOT(start()));
+
+    // Commands are written in GUI thread and passed to I/O thread
+    output = new EngineOutput(io, this);
+    writer = new EngineWriter(output);
+
+    ioThread->start();
 }
 
 /*
@@ -60,13 +62,8 @@ Engine::~Engine() {
 
     exit();
 
-    if ( cont != NULL ) {
-        destroy_continuation(cont);
-    }
-
-    if ( sexp != NULL ) {
-        destroy_sexp(sexp);
-    }
+    delete writer;
+    delete io;
 }
 
 // COMMANDS ////////////////////////////////////////////////////////////////////
@@ -75,239 +72,422 @@ Engine::~Engine() {
  * Sends exit command to engine
  */
 void Engine::exit() {
-    command("quit");
-    process->waitForFinished(-1);
-}
+    if ( exited ) {
+        return;
+    }
+    exited = true;
 
-/*
- * Sends command to load file
- */
-void Engine::loadFile(QString fileName) {
-    QVariantList args = QVariantList();
-    args << fileName << true;
-    command("load-file", args);
+    send("quit");
+
+    QMetaObject::invokeMethod(io, "finish", Qt::BlockingQueuedConnection);
+    ioThread->quit();
+    ioThread->wait();
+
+    // Engine is gone - segments it has not read would be left behind
+    releaseSegments(lastRequest);
 }
 
 /*
- * Sends command to save file
+ * Sends command to list algorithms
  */
-void Engine::saveFile(QString fileName) {
-    QVariantList args = QVariantList();
-    args << fileName;
-    command("save-file", args);
+int Engine::algorithms() {
+    return send("algorithms");
 }
 
 /*
- * Sends command to list algorithms
+ * Sends query command with evidence set in `network' (in binary protocol
+ * nodes and values are given by index, otherwise by name)
  */
-void Engine::algorithms() {
-    command("algorithms");
+int Engine::query(QString algorithm, bool hasParam, int param,
+                  const NetworkSnapshot &network) {
+    QVariantList args;
+    args << algorithm;
+
+    if ( hasParam ) {
+        args << param;
+    }
+
+    for ( int i=0; i<network.nodeCount(); ++i ) {
+        int e = network.evidence(i);
+
+        if ( e != -1 ) {
+            QVariantList evidence;
+            if ( proto == BinaryProtocol ) {
+                evidence << i << e;
+            } else {
+                evidence << network.nodeName(i) << network.values(i).at(e);
+            }
+            args << QVariant(evidence);
+        }
+    }
+
+    return send("query", args);
 }
 
 /*
- * Send query command
+ * Sends command to cancel query `request' (engine stops it at first safe
+ * point or does not start it at all)
  */
-void Engine::query(QVariantList l) {
-    command("query", l);
+void Engine::cancel(int request) {
+    send("cancel", QVariantList() << request);
 }
 
 /*
  * Sets named option to value
  */
-void Engine::setOption(QString name, QVariant value) {
+int Engine::setOption(QString name, QVariant value) {
     QVariantList args;
     args << name << value;
-    command("set-option", args);
+    return send("set-option", args);
 }
 
 /*
- * Sends command to load network
+ * Lets bulk arrays of at least `bytes' bytes go through shared memory in both
+ * directions (binary protocol only, 0 disables it)
  */
-void Engine::loadNetwork(QString name, QList<Node*> nodes) {
-    // Here we have to build arguments manually because of complexity
-    QVariantList args;
-
-    QVariantList net;
-    net << QVariant() << "network" << QVariant() << ":name" << name;
-    args << QVariant(net);
-
-    foreach (Node *n, nodes) {
-        QVariantList node;
-        node << QVariant() << "node" << QVariant() << ":name" << n->name();
-
-        QVariantList vals;
-        foreach(QString val, n->valueList()) {
-            vals << val;
-        }
-        node << QVariant() << ":vals" << QVariant(vals);
+void Engine::setSharedThreshold(int bytes) {
+    if ( !SharedSegment::isSupported() ) {
+        return;
+    }
 
-        QVariantList parents;
-        foreach (Node *p, n->getParents()) {
-            parents << p->name();
-        }
-        node << QVariant() << ":parents" << QVariant(parents);
+    writer->setSharedThreshold(bytes);
+    setOption("shared-memory-threshold", bytes);
+}
 
-        QVariantList table;
-        foreach ( double d, n->getTable() ) {
-            table << d;
-        }
-        node << QVariant() << ":table" << QVariant(table);
+/*
+ * Makes network of `session' current (engine keeps networks of other sessions)
+ */
+int Engine::selectNetwork(int session) {
+    return send("select-network", QVariantList() << session);
+}
 
-        QVariantList m;
-        QVariantHash meta = n->getMeta();
-        foreach (QString name, meta.keys()) {
-            m << QVariant() << (":"+name) << meta[name];
-        }
-        node << QVariant() << ":meta" << QVariant(m);
+/*
+ * Tells engine it does not need to keep network of `session' any more
+ */
+int Engine::forgetNetwork(int session) {
+    return send("forget-network", QVariantList() << session);
+}
 
-        args << QVariant(node);
+/*
+ * Asks engine to switch to protocol `p' (commands are written in new protocol
+ * right away, I/O thread holds them until engine acknowledges the switch)
+ */
+void Engine::setProtocol(Protocol p) {
+    if ( p == proto ) {
+        return;
     }
 
-    printf("Network cmd:\n%s\n", toArg(args).toUtf8().data());
+    if ( p == BinaryProtocol ) {
+        proto = BinaryProtocol;
+        io->postProtocolSwitch();
+    }
+}
 
-    command("load-network", args);
+/*
+ * Returns protocol currently used for communication with engine
+ */
+Engine::Protocol Engine::protocol() const {
+    return proto;
 }
 
 /*
- * Sends command named `cmd' and list of `args' to engine
+ * Sends command to load network (written straight from nodes)
  */
-void Engine::command(QString cmd, QVariantList args) {
-    // TODO: Check if engine is running and probablly restart it?
+int Engine::loadNetwork(QString name, QList<Node*> nodes) {
+    int id = beginCommand("load-network", 1 + nodes.length());
 
-    QString t = QString("");
+    writer->beginList(3);
+    writer->symbol("network");
+    writer->symbol(":name");
+    writer->string(name);
+    writer->endList();
+
+    foreach (Node *n, nodes) {
+        writeNode("node", n, true);
+    }
 
-    // Start building command string
-    t += "(" + esc(cmd) + " " + toArg(args) + ")\n";
-    printf("-> %s\n", t.toUtf8().data());
+    endCommand(id, "load-network");
 
-    // Send command
-    process->write(t.toUtf8().data());
+    return id;
 }
 
+// Kinds of node changes sent by updateNetwork
+enum NodeChange {
+    RenameNode,
+    AddNode,
+    SetVals,
+    SetParents,
+    SetTable,
+    SetMeta
+};
+
 /*
- * Creates arguments from list
+ * Sends only changes of network made since it was sent to engine as
+ * `synced' (`name' is new network name or empty if it has not changed;
+ * synced nodes missing from `nodes' are removed). Returns id of request,
+ * 0 if engine is up to date or -1 if changes can not be sent incrementally -
+ * whole network has to be loaded then.
  */
-QString Engine::toArg(QVariantList l) {
-    QString t = QString("");
-    bool symNext = false;
+int Engine::updateNetwork(QString name, QList<Node*> nodes,
+                           const SyncedNetwork &synced) {
+    // Changes are collected first - their number is sent before them
+    QList<QPair<NodeChange, Node*> > changes;
+
+    // Nodes engine has but editor does not
+    QHash<int, QString> removed = synced.nodes;
+    foreach ( Node *n, nodes ) {
+        removed.remove(n->id());
+    }
 
-    foreach (QVariant v, l) {
-        t += " ";
+    // Renames first (new name must not be taken by other node in engine)
+    QStringList engineNames;
+    foreach ( Node *n, nodes ) {
+        engineNames << synced.nodes.value(n->id());
+    }
+    foreach ( Node *n, nodes ) {
+        QString engineName = synced.nodes.value(n->id());
 
-        if (symNext) {
-            symNext = false;
-            t += v.toString();
+        if ( !engineName.isEmpty() && engineName != n->name() ) {
+            if ( engineNames.contains(n->name()) ) {
+                return -1;
+            }
 
-        } else if (v.type() == QVariant::Int) {
-            t += QString::number(v.toInt());
+            changes << qMakePair(RenameNode, n);
+        }
+    }
 
-        } else if ( v.type() == QVariant::Double ) {
-            t += QString::number(v.toDouble());
+    // New nodes are added without parents (they may be new too)
+    foreach ( Node *n, nodes ) {
+        if ( !synced.nodes.contains(n->id()) ) {
+            changes << qMakePair(AddNode, n);
+        }
+    }
 
-        } else if ( v.type() == QVariant::List ) {
-            t += "(" + toArg(v.toList()) + ")";
+    // Changed parts of nodes
+    foreach ( Node *n, nodes ) {
+        bool isNew = !synced.nodes.contains(n->id());
+        int c = n->changesSince(synced.revision);
 
-        } else if ( v.isNull() ) {
-            symNext = true;
+        if ( !isNew && (c & Node::ValuesChange) ) {
+            changes << qMakePair(SetVals, n);
+        }
 
-        } else if ( v.type() == QVariant::Bool ) {
-            t += (v.toBool() ? "T" : "NIL");
+        if ( isNew || (c & Node::ParentsChange) ) {
+            changes << qMakePair(SetParents, n);
+        }
 
-        } else {
-            t += "\"" + esc(v.toString()) + "\"";
+        if ( !isNew && (c & Node::TableChange) ) {
+            changes << qMakePair(SetTable, n);
+        }
 
+        if ( !isNew && (c & Node::MetaChange) ) {
+            changes << qMakePair(SetMeta, n);
         }
     }
 
-    return t;
+    int count = changes.length() + removed.length() + (name.isEmpty() ? 0 : 1);
+
+    // Engine is up to date
+    if ( count == 0 ) {
+        return 0;
+    }
+
+    int id = beginCommand("update-network", count);
+
+    if ( !name.isEmpty() ) {
+        writer->beginList(2);
+        writer->symbol("set-name");
+        writer->string(name);
+        writer->endList();
+    }
+
+    foreach ( QString r, removed.values() ) {
+        writer->beginList(2);
+        writer->symbol("remove-node");
+        writer->string(r);
+        writer->endList();
+    }
+
+    for ( int i=0; i<changes.length(); ++i ) {
+        Node *n = changes.at(i).second;
+
+        switch ( changes.at(i).first ) {
+        case RenameNode:
+            writer->beginList(3);
+            writer->symbol("rename-node");
+            writer->string(synced.nodes.value(n->id()));
+            writer->string(n->name());
+            writer->endList();
+            break;
+
+        case AddNode:
+            writeNode("add-node", n, false);
+            break;
+
+        case SetVals:
+            writer->beginList(3);
+            writer->symbol("set-vals");
+            writer->string(n->name());
+            writer->strings(n->valueList());
+            writer->endList();
+            break;
+
+        case SetParents:
+            writer->beginList(3);
+            writer->symbol("set-parents");
+            writer->string(n->name());
+            writeParents(n);
+            writer->endList();
+            break;
+
+        case SetTable:
+            writer->beginList(3);
+            writer->symbol("set-table");
+            writer->string(n->name());
+            writer->reals(n->getTable());
+            writer->endList();
+            break;
+
+        case SetMeta:
+            writer->beginList(3);
+            writer->symbol("set-meta");
+            writer->string(n->name());
+            writeMeta(n);
+            writer->endList();
+            break;
+        }
+    }
+
+    endCommand(id, "update-network");
+
+    return id;
 }
 
 /*
- * Escapes string to be sent to engine
- *
+ * Writes list starting with `head' followed by property list describing node
+ * (parents are optional)
  */
-QString Engine::esc(QString s) {
-    s = s.replace("\\", "\\\\");
-    s = s.replace("\"", "\\\"");
+void Engine::writeNode(QString head, Node *n, bool withParents) {
+    writer->beginList(withParents ? 11 : 9);
+    writer->symbol(head);
+
+    writer->symbol(":name");
+    writer->string(n->name());
+    writer->symbol(":vals");
+    writer->strings(n->valueList());
+    if ( withParents ) {
+        writer->symbol(":parents");
+        writeParents(n);
+    }
+    writer->symbol(":table");
+    writer->reals(n->getTable());
+    writer->symbol(":meta");
+    writeMeta(n);
 
-    return s;
+    writer->endList();
 }
 
 /*
- * Analyses whole command received from engine
+ * Writes list of node parent names
  */
-void Engine::commandReceived(sexp_t* cmd) {
-    QStringList vals = QStringList();
+void Engine::writeParents(Node *n) {
+    QList<Node*> parents = n->getParents();
 
-    while ( cmd ) {
-        if ( cmd->ty == SEXP_LIST ) {
-            cmd = cmd->list;
-
-        } else if ( cmd->ty == SEXP_VALUE ) {
-            vals.append(QString(cmd->val));
-            cmd = cmd->next;
+    writer->beginList(parents.length());
+    foreach (Node *p, parents) {
+        writer->string(p->name());
+    }
+    writer->endList();
+}
 
+/*
+ * Writes property list of node meta data
+ */
+void Engine::writeMeta(Node *n) {
+    QVariantHash meta = n->getMeta();
+
+    writer->beginList(2 * meta.size());
+    foreach (QString name, meta.keys()) {
+        writer->symbol(":" + name);
+        if ( meta[name].isNull() ) {
+            writer->boolean(false);
         } else {
-            return;
+            writer->values(QVariantList() << meta[name]);
         }
     }
+    writer->endList();
+}
 
-    if ( vals.empty() ) {
-        return;
-    }
-
-    QString cmds = vals.first().toLower();
-    vals.pop_front();
-
-    //printf("Got commdand: %s\n", cmds.toUtf8().data());
-    //printf("With args: %s\n\n", vals.join(", ").toUtf8().data());
+/*
+ * Sends command named `cmd' and list of `args' to engine; returns id of
+ * request
+ */
+int Engine::send(QString cmd, QVariantList args) {
+    int id = beginCommand(cmd, writer->valueCount(args));
+    writer->values(args);
+    endCommand(id, cmd);
 
-    emit command(cmds, vals);
+    return id;
 }
 
-// SLOTS ///////////////////////////////////////////////////////////////////////
-
 /*
- * Private slot called when data on stdout of process is ready
+ * Starts writing command named `cmd' with `argCount' arguments; returns id of
+ * request
  */
-void Engine::dataReady() {
+int Engine::beginCommand(QString cmd, int argCount) {
+    // TODO: Check if engine is running and probablly restart it?
 
-    // Fetch data and information
-    QByteArray ba = process->readAllStandardOutput();
-    int len = ba.length();
-    char *data = ba.data();
+    int id = ++lastRequest;
 
-    // Output data
-    //printf("[out] %s\n", data);
-    printf("<- %s\n", data);
+    writer->setBinary(proto == BinaryProtocol);
+    writer->beginMessage(2 + argCount);
+    writer->integer(id);
+    writer->symbol(cmd);
 
-    // Init continuation
-    if ( cont == NULL ) {
-        cont = init_continuation(data);
-    }
+    return id;
+}
 
-    // Start parsings S-expression(s)
-    while ( true ) {
+/*
+ * Finishes writing command `id'
+ */
+void Engine::endCommand(int id, QString cmd) {
+    qint64 size = writer->endMessage();
+    printf("-> %s [%lld bytes]\n", cmd.toUtf8().data(), size);
 
-        // Try to get one expression
-        sexp = (sexp_t*) iparse_sexp(data, len, cont);
+    QList<QByteArray> names = writer->takeSegments();
+    if ( !names.isEmpty() ) {
+        segments[id] = names;
+    }
+}
 
-        // If one not available yet - stop parsing
-        if ( ! sexp ) {
-            break;
+/*
+ * Removes shared memory segments of `request' and of requests sent before it
+ * (engine reads commands in order, so it is done with them once it answers
+ * `request')
+ */
+void Engine::releaseSegments(int request) {
+    while ( !segments.isEmpty() && segments.begin().key() <= request ) {
+        foreach ( QByteArray name, segments.begin().value() ) {
+            SharedSegment::remove(name);
         }
-
-        // We have a command available
-        commandReceived(sexp);
-        destroy_sexp(sexp);
+        segments.erase(segments.begin());
     }
 }
 
 /*
- * Private slot called when data om stderr of process is ready
+ * Emits messages decoded by I/O thread
  */
-void Engine::errorReady() {
-    char *data = process->readAllStandardError().data();
-    fprintf(stderr, "[err] %s\n", data);
-    //emit error(data);
+void Engine::deliverMessages() {
+    QList<EngineMessage> messages = io->takeMessages();
+
+    for ( int i=0; i<messages.length(); ++i ) {
+        const EngineMessage &m = messages.at(i);
+        releaseSegments(m.id);
+
+        if ( m.cmd == "query-result" ) {
+            emit queryResult(m.id, m.result);
+        } else {
+            emit command(m.id, m.cmd, m.args);
+        }
+    }
 }
@@ -20,50 +20,122 @@
 #ifndef ENGINE_H
 #define ENGINE_H
 
-#include <QProcess>
+#include <QObject>
 #include <QVariantList>
-
-#include "sexp.h"
+#include <QVector>
+#include <QHash>
+#include <QMap>
 
 class Node;
+class NetworkSnapshot;
+class EngineWriter;
+class EngineIO;
+class EngineOutput;
+class QThread;
+
+/*
+ * Network as engine has it for one editor: its name, names engine knows
+ * nodes under (by node id) and network version and revision it was sent at
+ */
+struct SyncedNetwork {
+    QString name;
+    QHash<int, QString> nodes;
+    quint64 version;
+    quint64 revision;
+};
 
+/*
+ * Communication with engine is either textual (S-expressions, useful for
+ * debugging) or binary. Binary protocol is negotiated with text command
+ * (set-protocol "binary") which engine acknowledges with (PROTOCOL "binary");
+ * after that every message is sent in frames: 4-byte little-endian header
+ * (bits 0-30 payload length, bit 31 set if more frames of same message
+ * follow) and payload. Message is one typed value:
+ *   'L' u32 count, values    'S' u32 length, UTF-8    'Y' u32 length, symbol
+ *   'I' int32                'D' IEEE-754 double      'T' true   'N' nil
+ *   'V' u32 count, doubles   'M' u32 length, name, u32 count
+ * All numbers are little-endian. In binary protocol nodes and values in
+ * query evidence are referenced by indices instead of names. 'M' is packed
+ * vector of doubles passed in shared memory segment of given name (receiver
+ * removes it); it is used for vectors of at least shared memory threshold
+ * bytes when threshold is set.
+ *
+ * Every command is sent as (id command args...) and every message engine
+ * outputs while executing it starts with the same id, so several commands
+ * can be in flight at once. Methods sending commands return their id (ids
+ * are unique across all engines).
+ *
+ * Engine keeps network of every session (editor tab) it serves; commands
+ * working with network use network of session selected last.
+ *
+ * Query result comes in one QUERY-RESULT message with probabilities of all
+ * values of all nodes (in order of nodes sent to engine) and is reported with
+ * queryResult() signal instead of command().
+ */
 class Engine : public QObject {
     Q_OBJECT
 
 public:
+    enum Protocol {
+        SexpProtocol,
+        BinaryProtocol
+    };
+
     Engine(QObject *parent = 0);
     ~Engine();
 
-    void loadFile(QString fielName);
-    void algorithms();
-    void loadNetwork(QString name, QList<Node*>);
-    void query(QVariantList l);
-    void saveFile(QString fileName);
+    int algorithms();
+    int loadNetwork(QString name, QList<Node*>);
+    int updateNetwork(QString name, QList<Node*> nodes,
+                      const SyncedNetwork &synced);
+    int query(QString algorithm, bool hasParam, int param,
+              const NetworkSnapshot &network);
+    void cancel(int request);
 
-    void setOption(QString name, QVariant value);
+    int setOption(QString name, QVariant value);
+
+    int selectNetwork(int session);
+    int forgetNetwork(int session);
+
+    void setProtocol(Protocol p);
+    Protocol protocol() const;
+
+    void setSharedThreshold(int bytes);
 
 protected:
 
 signals:
-    void command(QString cmd, QStringList args, bool rawArg=false);
+    void command(int request, QString cmd, QVariantList args);
+    void queryResult(int request, QVector<double> result);
 
 public slots:
     void exit();
 
 private slots:
-    void dataReady();
-    void errorReady();
+    void deliverMessages();
 
 private:
-    void commandReceived(sexp_t* cmd);
-    void command(QString cmd, QVariantList args = QVariantList());
-    QString esc(QString s);
-    QString toArg(QVariantList l);
-
-    QProcess *process;
-
-    sexp_t *sexp;  // Temp S-Expression
-    pcont_t *cont; // Continuation help
+    int send(QString cmd, QVariantList args = QVariantList());
+    int beginCommand(QString cmd, int argCount);
+    void endCommand(int id, QString cmd);
+    void releaseSegments(int request);
+
+    void writeNode(QString head, Node *n, bool withParents);
+    void writeParents(Node *n);
+    void writeMeta(Node *n);
+
+    QThread *ioThread;
+    EngineIO *io;          // Lives in I/O thread
+    EngineOutput *output;
+    EngineWriter *writer;
+
+    Protocol proto;
+    bool exited;
+
+    // Shared memory segments sent with each request (removed when engine
+    // answers request or one sent after it, or when engine exits)
+    QMap<int, QList<QByteArray> > segments;
+    static int lastRequest; // Id of last command sent (by any engine)
 };
 
 #endif // ENGINE_H
@@ -0,0 +1,585 @@
+/*
+    Copyright (C) 2012 Ivan Radicek
+
+    This file is part of Bayes.
+
+    Bayes is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bayes is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Bayes.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "engineio.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef Q_OS_UNIX
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include "sharedsegment.h"
+
+// Frame header bit set when more frames of same message follow
+static const quint32 MoreFrames = 0x80000000u;
+
+// How long (in ms) to wait for engine daemon before starting own engine
+static const int DaemonConnectTimeout = 500;
+
+/*
+ * Reads 32-bit little-endian integer from buffer
+ */
+static quint32 getU32(const char *data) {
+    const uchar *b = (const uchar*) data;
+    return b[0] | (b[1] << 8) | (b[2] << 16) | ((quint32) b[3] << 24);
+}
+
+/*
+ * Checks if process on other end of local socket runs as same user (anybody
+ * could otherwise pose as engine daemon)
+ */
+static bool sameUser(QLocalSocket *socket) {
+    int fd = (int) socket->socketDescriptor();
+
+#if defined(Q_OS_LINUX)
+    struct ucred cred;
+    socklen_t len = sizeof(cred);
+    return getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) == 0 &&
+            cred.uid == getuid();
+#elif defined(Q_OS_UNIX)
+    uid_t uid;
+    gid_t gid;
+    return getpeereid(fd, &uid, &gid) == 0 && uid == getuid();
+#else
+    Q_UNUSED(fd);
+    return false;
+#endif
+}
+
+/*
+ * Appends list of values to result flattening nested lists
+ */
+static void flatten(QVariantList &out, QVariantList l) {
+    foreach ( QVariant v, l ) {
+        if ( v.type() == QVariant::List ) {
+            flatten(out, v.toList());
+        } else {
+            out << v;
+        }
+    }
+}
+
+/*
+ * Creates engine I/O; connection to daemon on `socketPath' (if not empty) or
+ * process `enginePath' is started by start() in I/O thread and `receiver' is
+ * notified about messages through its deliverMessages() slot
+ */
+EngineIO::EngineIO(QString enginePath, QString socketPath, QObject *receiver)
+    : QObject() {
+    this->enginePath = enginePath;
+    this->socketPath = socketPath;
+    this->receiver = receiver;
+    device = NULL;
+    process = NULL;
+    socket = NULL;
+
+    // Engine starts talking S-Expressions
+    binary = false;
+    switchingProtocol = false;
+    textScanned = 0;
+    textDepth = 0;
+    textInString = false;
+    textEscaped = false;
+}
+
+/*
+ * Queues data to be written to engine (called from GUI thread)
+ */
+void EngineIO::post(QByteArray data) {
+    outgoing.push(data);
+
+    if ( outgoingPosted.testAndSetOrdered(0, 1) ) {
+        QMetaObject::invokeMethod(this, "writePending", Qt::QueuedConnection);
+    }
+}
+
+/*
+ * Queues switch to binary protocol - data posted after it is written once
+ * engine acknowledges the switch (called from GUI thread)
+ */
+void EngineIO::postProtocolSwitch() {
+    post(QByteArray());
+}
+
+/*
+ * Takes decoded messages received so far (called from GUI thread)
+ */
+QList<EngineMessage> EngineIO::takeMessages() {
+    QList<EngineMessage> messages;
+    EngineMessage m;
+
+    // Messages pushed from now on need new delivery
+    incomingPosted.fetchAndStoreOrdered(0);
+
+    while ( incoming.pop(m) ) {
+        messages << m;
+    }
+
+    return messages;
+}
+
+/*
+ * Passes decoded message to GUI thread
+ */
+void EngineIO::deliver(EngineMessage m) {
+    incoming.push(m);
+
+    if ( incomingPosted.testAndSetOrdered(0, 1) ) {
+        QMetaObject::invokeMethod(receiver, "deliverMessages",
+                                  Qt::QueuedConnection);
+    }
+}
+
+// SLOTS ///////////////////////////////////////////////////////////////////////
+
+/*
+ * Connects to engine daemon or starts engine process if daemon does not run
+ * or belongs to other user (in I/O thread)
+ */
+void EngineIO::start() {
+    if ( !socketPath.isEmpty() ) {
+        socket = new QLocalSocket(this);
+        socket->connectToServer(socketPath);
+
+        if ( socket->waitForConnected(DaemonConnectTimeout) ) {
+            if ( sameUser(socket) ) {
+                printf("Using engine daemon %s\n", socketPath.toUtf8().data());
+                device = socket;
+                connect(socket, SIGNAL(readyRead()), this, SLOT(dataReady()));
+                return;
+            }
+
+            fprintf(stderr, "Engine daemon %s runs as other user\n",
+                    socketPath.toUtf8().data());
+            socket->abort();
+        }
+
+        delete socket;
+        socket = NULL;
+    }
+
+    process = new QProcess(this);
+    device = process;
+
+    // Setup communication
+    connect(process, SIGNAL(readyReadStandardOutput()),
+            this, SLOT(dataReady()));
+    connect(process, SIGNAL(readyReadStandardError()),
+            this, SLOT(errorReady()));
+
+    // Start process
+    //process->setWorkingDirectory(QApplication::applicationDirPath()
+    //                                                    + "/../src/lisp/");
+    //printf("wdir: %s\n", process->workingDirectory().toUtf8().data());
+    process->start(enginePath);
+    process->waitForStarted(-1);
+}
+
+/*
+ * Writes queued data to engine (stops at protocol switch until engine
+ * acknowledges it)
+ */
+void EngineIO::writePending() {
+    outgoingPosted.fetchAndStoreOrdered(0);
+
+    QByteArray data;
+    while ( !switchingProtocol && outgoing.pop(data) ) {
+        if ( data.isNull() ) {
+            // No newline after command - engine reads binary data right
+            // after it
+            switchingProtocol = true;
+            device->write("(set-protocol \"binary\")");
+        } else {
+            device->write(data);
+        }
+    }
+}
+
+/*
+ * Writes queued data and waits until engine process quits (or daemon closes
+ * connection)
+ */
+void EngineIO::finish() {
+    writePending();
+
+    // Engine understands rest of data only after protocol switch
+    while ( switchingProtocol && device->waitForReadyRead(-1) ) {
+    }
+
+    if ( socket != NULL ) {
+        socket->waitForBytesWritten(-1);
+        if ( socket->state() != QLocalSocket::UnconnectedState ) {
+            socket->waitForDisconnected(-1);
+        }
+    } else {
+        process->waitForFinished(-1);
+    }
+}
+
+/*
+ * Decodes binary value starting at `pos' (advanced past value). Symbols, true
+ * and nil are decoded as strings, as they are in S-Expression protocol.
+ * Returns invalid variant if data is malformed.
+ */
+QVariant EngineIO::fromBinary(const char *data, int len, int &pos) {
+    if ( pos >= len ) {
+        return QVariant();
+    }
+
+    char tag = data[pos++];
+
+    switch ( tag ) {
+    case 'L': {
+        if ( len - pos < 4 ) {
+            return QVariant();
+        }
+        quint32 count = getU32(data + pos);
+        pos += 4;
+
+        QVariantList l;
+        for ( quint32 i=0; i<count; ++i ) {
+            QVariant v = fromBinary(data, len, pos);
+            if ( !v.isValid() ) {
+                return QVariant();
+            }
+            l << v;
+        }
+        return QVariant(l);
+    }
+
+    case 'S':
+    case 'Y': {
+        if ( len - pos < 4 ) {
+            return QVariant();
+        }
+        quint32 n = getU32(data + pos);
+        pos += 4;
+        if ( (quint32) (len - pos) < n ) {
+            return QVariant();
+        }
+        QString s = QString::fromUtf8(data + pos, n);
+        pos += n;
+        return QVariant(s);
+    }
+
+    case 'I': {
+        if ( len - pos < 4 ) {
+            return QVariant();
+        }
+        int i = (int) getU32(data + pos);
+        pos += 4;
+        return QVariant(i);
+    }
+
+    case 'D': {
+        if ( len - pos < 8 ) {
+            return QVariant();
+        }
+        quint64 bits = getU32(data + pos)
+                       | ((quint64) getU32(data + pos + 4) << 32);
+        pos += 8;
+        double d;
+        memcpy(&d, &bits, sizeof(d));
+        return QVariant(d);
+    }
+
+    case 'V': {
+        if ( len - pos < 4 ) {
+            return QVariant();
+        }
+        quint32 count = getU32(data + pos);
+        pos += 4;
+        if ( (quint32) (len - pos) / 8 < count ) {
+            return QVariant();
+        }
+
+        QVector<double> v(count);
+        for ( quint32 i=0; i<count; ++i ) {
+            quint64 bits = getU32(data + pos)
+                           | ((quint64) getU32(data + pos + 4) << 32);
+            memcpy(&v[i], &bits, sizeof(double));
+            pos += 8;
+        }
+        return QVariant::fromValue(v);
+    }
+
+    case 'M': {
+        if ( len - pos < 4 ) {
+            return QVariant();
+        }
+        quint32 n = getU32(data + pos);
+        pos += 4;
+        if ( (quint32) (len - pos) < n || len - pos - n < 4 ) {
+            return QVariant();
+        }
+        QByteArray name(data + pos, n);
+        pos += n;
+        quint32 count = getU32(data + pos);
+        pos += 4;
+
+        QVector<double> v;
+        if ( !SharedSegment::read(name, count, v) ) {
+            return QVariant();
+        }
+        return QVariant::fromValue(v);
+    }
+
+    case 'T':
+        return QVariant(QString("T"));
+
+    case 'N':
+        return QVariant(QString("NIL"));
+    }
+
+    return QVariant();
+}
+
+/*
+ * Analyses whole command received from engine
+ */
+void EngineIO::commandReceived(sexp_t* cmd) {
+    QStringList vals = QStringList();
+
+    while ( cmd ) {
+        if ( cmd->ty == SEXP_LIST ) {
+            cmd = cmd->list;
+
+        } else if ( cmd->ty == SEXP_VALUE ) {
+            vals.append(QString(cmd->val));
+            cmd = cmd->next;
+
+        } else {
+            return;
+        }
+    }
+
+    // Request id and command name
+    if ( vals.length() < 2 ) {
+        return;
+    }
+
+    int id = vals.takeFirst().toInt();
+    QString cmds = vals.takeFirst().toLower();
+
+    //printf("Got commdand: %s\n", cmds.toUtf8().data());
+    //printf("With args: %s\n\n", vals.join(", ").toUtf8().data());
+
+    // Engine acknowledged protocol switch - send commands waiting for it
+    if ( cmds == "protocol" ) {
+        if ( !vals.isEmpty() && vals.first().toLower() == "binary" ) {
+            binary = true;
+        }
+        switchingProtocol = false;
+        writePending();
+        return;
+    }
+
+    EngineMessage m;
+    m.id = id;
+    m.cmd = cmds;
+
+    // Query result
+    if ( cmds == "query-result" ) {
+        m.result.resize(vals.length());
+        for ( int i=0; i<vals.length(); ++i ) {
+            m.result[i] = vals.at(i).toDouble();
+        }
+
+    } else {
+        foreach ( QString v, vals ) {
+            m.args << v;
+        }
+    }
+
+    deliver(m);
+}
+
+/*
+ * Analyses whole binary command received from engine
+ */
+void EngineIO::commandReceived(QVariantList cmd) {
+    EngineMessage m;
+
+    // Request id and command name
+    if ( cmd.length() < 2 ) {
+        return;
+    }
+    m.id = cmd.at(0).toInt();
+
+    // Query result is packed vector
+    if ( cmd.length() == 3 && cmd.at(1).toString().toLower() == "query-result"
+         && cmd.at(2).userType() == qMetaTypeId<QVector<double> >() ) {
+        m.cmd = "query-result";
+        m.result = cmd.at(2).value<QVector<double> >();
+        deliver(m);
+        return;
+    }
+
+    flatten(m.args, cmd.mid(1));
+
+    if ( m.args.empty() ) {
+        return;
+    }
+
+    m.cmd = m.args.first().toString().toLower();
+    m.args.pop_front();
+
+    deliver(m);
+}
+
+/*
+ * Private slot called when data from engine (stdout of process) is ready
+ */
+void EngineIO::dataReady() {
+    inBuffer.append(device->readAll());
+
+    // Frames may follow acknowledgement of protocol switch in same data
+    if ( !binary ) {
+        textDataReady();
+    }
+
+    if ( binary ) {
+        binaryDataReady();
+    }
+}
+
+/*
+ * Splits received text to top-level S-expressions and analyses complete
+ * ones. Scanning stops right after acknowledgement of protocol switch, so
+ * data following it stays in buffer.
+ */
+void EngineIO::textDataReady() {
+    int start = 0;
+
+    while ( !binary && textScanned < inBuffer.size() ) {
+        char c = inBuffer.at(textScanned++);
+
+        if ( textEscaped ) {
+            textEscaped = false;
+
+        } else if ( textInString ) {
+            if ( c == '\\' ) {
+                textEscaped = true;
+            } else if ( c == '"' ) {
+                textInString = false;
+            }
+
+        } else if ( c == '(' ) {
+            ++textDepth;
+
+        } else if ( textDepth == 0 ) {
+            // Whitespace between expressions
+            start = textScanned;
+
+        } else if ( c == '"' ) {
+            textInString = true;
+
+        } else if ( c == ')' && --textDepth == 0 ) {
+            QByteArray text = inBuffer.mid(start, textScanned - start);
+            start = textScanned;
+
+            sexp_t *sexp = parse_sexp(text.data(), text.size());
+            if ( sexp != NULL ) {
+                commandReceived(sexp);
+                destroy_sexp(sexp);
+            } else {
+                fprintf(stderr, "Malformed message from engine\n");
+            }
+        }
+    }
+
+    inBuffer.remove(0, start);
+    textScanned -= start;
+}
+
+/*
+ * Splits received binary data to frames and analyses complete messages
+ */
+void EngineIO::binaryDataReady() {
+    int pos = 0;
+    while ( inBuffer.size() - pos >= 4 ) {
+        quint32 header = getU32(inBuffer.constData() + pos);
+        int n = header & ~MoreFrames;
+
+        // Wait for whole frame
+        if ( inBuffer.size() - pos - 4 < n ) {
+            break;
+        }
+
+        inMessage.append(inBuffer.constData() + pos + 4, n);
+        pos += 4 + n;
+
+        if ( !(header & MoreFrames) ) {
+            int p = 0;
+            QVariant msg = fromBinary(inMessage.constData(), inMessage.size(),
+                                      p);
+            inMessage.clear();
+
+            if ( msg.type() == QVariant::List ) {
+                commandReceived(msg.toList());
+            } else {
+                fprintf(stderr, "Malformed message from engine\n");
+            }
+        }
+    }
+
+    inBuffer.remove(0, pos);
+}
+
+/*
+ * Private slot called when data om stderr of process is ready
+ */
+void EngineIO::errorReady() {
+    char *data = process->readAllStandardError().data();
+    fprintf(stderr, "[err] %s\n", data);
+    //emit error(data);
+}
+
+/*
+ * Creates device writing to engine I/O
+ */
+EngineOutput::EngineOutput(EngineIO *io, QObject *parent) : QIODevice(parent) {
+    this->io = io;
+    open(QIODevice::WriteOnly | QIODevice::Unbuffered);
+}
+
+/*
+ * Nothing can be read from device
+ */
+qint64 EngineOutput::readData(char *data, qint64 maxSize) {
+    Q_UNUSED(data);
+    Q_UNUSED(maxSize);
+
+    return -1;
+}
+
+/*
+ * Passes written data to engine I/O thread
+ */
+qint64 EngineOutput::writeData(const char *data, qint64 size) {
+    if ( size > 0 ) {
+        io->post(QByteArray(data, size));
+    }
+
+    return size;
+}
@@ -0,0 +1,124 @@
+/*
+    Copyright (C) 2012 Ivan Radicek
+
+    This file is part of Bayes.
+
+    Bayes is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bayes is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Bayes.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ENGINEIO_H
+#define ENGINEIO_H
+
+#include <QObject>
+#include <QIODevice>
+#include <QProcess>
+#include <QLocalSocket>
+#include <QVariantList>
+#include <QVector>
+#include <QAtomicInt>
+
+#include "sexp.h"
+#include "spscqueue.h"
+
+/*
+ * Decoded message from engine (`id' is id of request message belongs to and
+ * packed query result is kept in `result')
+ */
+struct EngineMessage {
+    int id;
+    QString cmd;
+    QVariantList args;
+    QVector<double> result;
+};
+
+Q_DECLARE_METATYPE(QVector<double>)
+
+/*
+ * Engine connection with framing and parsing of its messages, living in its
+ * own thread. Engine daemon listening on local socket is used if one is
+ * configured, runs and belongs to same user, otherwise private engine
+ * process is started. Encoded commands come from GUI thread through post()
+ * and decoded messages go back through takeMessages(); both directions use
+ * lock-free queues and receiver's deliverMessages() slot is invoked when new
+ * messages arrive.
+ */
+class EngineIO : public QObject {
+    Q_OBJECT
+
+public:
+    EngineIO(QString enginePath, QString socketPath, QObject *receiver);
+
+    void post(QByteArray data);
+    void postProtocolSwitch();
+    QList<EngineMessage> takeMessages();
+
+public slots:
+    void start();
+    void writePending();
+    void finish();
+
+private slots:
+    void dataReady();
+    void errorReady();
+
+private:
+    void deliver(EngineMessage m);
+    void commandReceived(sexp_t* cmd);
+    void commandReceived(QVariantList cmd);
+    QVariant fromBinary(const char *data, int len, int &pos);
+    void textDataReady();
+    void binaryDataReady();
+
+    QString enginePath;
+    QString socketPath;
+    QObject *receiver;
+    QIODevice *device;    // Process or socket
+    QProcess *process;    // Private engine process (if daemon is not used)
+    QLocalSocket *socket; // Connection to engine daemon
+
+    SpscQueue<QByteArray> outgoing;     // Null array marks protocol switch
+    SpscQueue<EngineMessage> incoming;
+    QAtomicInt outgoingPosted;          // Write of outgoing data is invoked
+    QAtomicInt incomingPosted;          // Delivery of messages is invoked
+
+    bool binary;
+    bool switchingProtocol;
+    QByteArray inBuffer;  // Received data not yet processed
+    QByteArray inMessage; // Frames of binary message being received
+
+    // Scanning of text in inBuffer (position and state reached so far)
+    int textScanned;
+    int textDepth;
+    bool textInString;
+    bool textEscaped;
+};
+
+/*
+ * Write-only device passing written data to engine I/O thread
+ */
+class EngineOutput : public QIODevice {
+    Q_OBJECT
+
+public:
+    EngineOutput(EngineIO *io, QObject *parent = 0);
+
+protected:
+    qint64 readData(char *data, qint64 maxSize);
+    qint64 writeData(const char *data, qint64 size);
+
+private:
+    EngineIO *io;
+};
+
+#endif // ENGINEIO_H
@@ -0,0 +1,139 @@
+/*
+    Copyright (C) 2012 Ivan Radicek
+
+    This file is part of Bayes.
+
+    Bayes is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bayes is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Bayes.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "enginepool.h"
+
+#include "engine.h"
+#include "settings.h"
+
+/*
+ * Creates pool of at most `size' engines (first one is started right away)
+ */
+EnginePool::EnginePool(int size, QObject *parent) : QObject(parent) {
+    maxSize = qMax(size, 1);
+    lastSession = 0;
+
+    createEngine();
+}
+
+/*
+ * Gets engine for commands not related to any session
+ */
+Engine* EnginePool::engine() {
+    return engines.first();
+}
+
+/*
+ * Gets engine serving `session' (session is assigned to one when it is
+ * seen first time)
+ */
+Engine* EnginePool::engine(QObject *session) {
+    if ( sessionEngine.contains(session) ) {
+        return sessionEngine.value(session);
+    }
+
+    Engine *e = NULL;
+    if ( engines.length() < maxSize ) {
+        e = createEngine();
+
+    } else {
+        // Least loaded engine
+        foreach ( Engine *candidate, engines ) {
+            if ( e == NULL || sessionEngine.keys(candidate).length() <
+                              sessionEngine.keys(e).length() ) {
+                e = candidate;
+            }
+        }
+    }
+
+    sessionEngine[session] = e;
+    sessionId[session] = ++lastSession;
+
+    return e;
+}
+
+/*
+ * Gets engine serving `session' with network of session made current
+ */
+Engine* EnginePool::select(QObject *session) {
+    Engine *e = engine(session);
+    int id = sessionId.value(session);
+
+    if ( selected.value(e) != id ) {
+        e->selectNetwork(id);
+        selected[e] = id;
+    }
+
+    return e;
+}
+
+/*
+ * Session is closed - its engine may forget its network
+ */
+void EnginePool::release(QObject *session) {
+    if ( !sessionEngine.contains(session) ) {
+        return;
+    }
+
+    Engine *e = sessionEngine.take(session);
+    int id = sessionId.take(session);
+
+    e->forgetNetwork(id);
+    if ( selected.value(e) == id ) {
+        selected.remove(e);
+    }
+}
+
+/*
+ * Gets largest number of engines in pool
+ */
+int EnginePool::size() const {
+    return maxSize;
+}
+
+/*
+ * Quits all engines
+ */
+void EnginePool::exit() {
+    foreach ( Engine *e, engines ) {
+        e->exit();
+    }
+}
+
+/*
+ * Starts new engine and relays its messages
+ */
+Engine* EnginePool::createEngine() {
+    Engine *e = new Engine(this);
+    connect(e, SIGNAL(command(int,QString,QVariantList)),
+            this, SIGNAL(command(int,QString,QVariantList)));
+    connect(e, SIGNAL(queryResult(int,QVector<double>)),
+            this, SIGNAL(queryResult(int,QVector<double>)));
+
+    if ( Settings::engineProtocol() == "binary" ) {
+        e->setProtocol(Engine::BinaryProtocol);
+
+        if ( Settings::sharedMemoryThreshold() > 0 ) {
+            e->setSharedThreshold(Settings::sharedMemoryThreshold());
+        }
+    }
+
+    engines << e;
+    return e;
+}
@@ -0,0 +1,71 @@
+/*
+    Copyright (C) 2012 Ivan Radicek
+
+    This file is part of Bayes.
+
+    Bayes is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bayes is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Bayes.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ENGINEPOOL_H
+#define ENGINEPOOL_H
+
+#include <QObject>
+#include <QHash>
+#include <QList>
+#include <QVariantList>
+#include <QVector>
+
+class Engine;
+
+/*
+ * Pool of at most `size' engine processes. Every session (editor tab) is
+ * served by one engine for its whole life, so its network stays resident in
+ * that engine and networks of different sessions can be queried in parallel.
+ * New sessions go to a new engine while pool is not full, otherwise to the
+ * engine serving fewest sessions. Messages of all engines are relayed through
+ * pool's signals (request ids are unique across engines).
+ */
+class EnginePool : public QObject {
+    Q_OBJECT
+
+public:
+    EnginePool(int size, QObject *parent = 0);
+
+    Engine* engine();
+    Engine* engine(QObject *session);
+    Engine* select(QObject *session);
+    void release(QObject *session);
+
+    int size() const;
+
+signals:
+    void command(int request, QString cmd, QVariantList args);
+    void queryResult(int request, QVector<double> result);
+
+public slots:
+    void exit();
+
+private:
+    Engine* createEngine();
+
+    int maxSize;
+    QList<Engine*> engines;
+
+    QHash<QObject*, Engine*> sessionEngine; // Engine serving session
+    QHash<QObject*, int> sessionId;         // Id of session in its engine
+    QHash<Engine*, int> selected;           // Session current in engine
+    int lastSession;
+};
+
+#endif // ENGINEPOOL_H
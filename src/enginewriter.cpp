@@ -0,0 +1,396 @@
+/*
+    Copyright (C) 2012 Ivan Radicek
+
+    This file is part of Bayes.
+
+    Bayes is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bayes is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Bayes.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "enginewriter.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "sharedsegment.h"
+
+// Frame header bit set when more frames of same message follow
+static const quint32 MoreFrames = 0x80000000u;
+
+/*
+ * Creates writer to device with buffer of `chunkSize' bytes
+ */
+EngineWriter::EngineWriter(QIODevice *device, int chunkSize) {
+    this->device = device;
+    binary = false;
+    sharedThreshold = 0;
+
+    buffer.resize(chunkSize);
+    used = 0;
+    needSpace = false;
+    written = 0;
+}
+
+/*
+ * Sets if binary protocol is used (S-expressions are written otherwise)
+ */
+void EngineWriter::setBinary(bool binary) {
+    this->binary = binary;
+}
+
+/*
+ * Returns true if binary protocol is used
+ */
+bool EngineWriter::isBinary() const {
+    return binary;
+}
+
+/*
+ * Sets size (in bytes) from which lists of doubles are passed in shared
+ * memory in binary protocol (0 disables it)
+ */
+void EngineWriter::setSharedThreshold(qint64 bytes) {
+    sharedThreshold = SharedSegment::isSupported() ? bytes : 0;
+}
+
+/*
+ * Starts new message with `count' items (command name and arguments)
+ */
+void EngineWriter::beginMessage(int count) {
+    used = 0;
+    written = 0;
+    needSpace = false;
+    segments.clear();
+    beginList(count);
+}
+
+/*
+ * Finishes message and writes rest of it; returns size of message in bytes
+ */
+qint64 EngineWriter::endMessage() {
+    endList();
+
+    if ( !binary ) {
+        put('\n');
+    }
+
+    flush(false);
+
+    return written;
+}
+
+/*
+ * Starts list of `count' items
+ */
+void EngineWriter::beginList(int count) {
+    if ( binary ) {
+        put('L');
+        putU32(count);
+    } else {
+        separate();
+        put('(');
+        needSpace = false;
+    }
+}
+
+/*
+ * Ends list
+ */
+void EngineWriter::endList() {
+    if ( !binary ) {
+        put(')');
+        needSpace = true;
+    }
+}
+
+/*
+ * Writes symbol
+ */
+void EngineWriter::symbol(QString s) {
+    if ( binary ) {
+        putString('Y', s.toUtf8());
+    } else {
+        separate();
+        QByteArray u = s.toUtf8();
+        put(u.constData(), u.size());
+    }
+}
+
+/*
+ * Writes string
+ */
+void EngineWriter::string(QString s) {
+    if ( binary ) {
+        putString('S', s.toUtf8());
+        return;
+    }
+
+    separate();
+    put('"');
+
+    QByteArray u = s.toUtf8();
+    const char *d = u.constData();
+    int start = 0;
+    for ( int i=0; i<u.size(); ++i ) {
+        if ( d[i] == '"' || d[i] == '\\' ) {
+            put(d + start, i - start);
+            put('\\');
+            start = i;
+        }
+    }
+    put(d + start, u.size() - start);
+
+    put('"');
+}
+
+/*
+ * Writes integer
+ */
+void EngineWriter::integer(int i) {
+    if ( binary ) {
+        put('I');
+        putU32((quint32) i);
+    } else {
+        char t[16];
+        separate();
+        put(t, qsnprintf(t, sizeof(t), "%d", i));
+    }
+}
+
+/*
+ * Writes double (text has enough digits to read back same double)
+ */
+void EngineWriter::real(double d) {
+    if ( binary ) {
+        quint64 bits;
+        memcpy(&bits, &d, sizeof(bits));
+        put('D');
+        putU32(bits & 0xffffffffu);
+        putU32(bits >> 32);
+    } else {
+        char t[32];
+        separate();
+        int n = qsnprintf(t, sizeof(t), "%.17g", d);
+        put(t, n);
+    }
+}
+
+/*
+ * Writes boolean (T or NIL)
+ */
+void EngineWriter::boolean(bool b) {
+    if ( binary ) {
+        put(b ? 'T' : 'N');
+    } else {
+        separate();
+        put(b ? "T" : "NIL", b ? 1 : 3);
+    }
+}
+
+/*
+ * Writes list of doubles (packed vector in binary protocol, placed in shared
+ * memory segment if it is big enough)
+ */
+void EngineWriter::reals(const QList<double> &l) {
+    if ( binary ) {
+        qint64 size = (qint64) l.length() * sizeof(double);
+        if ( sharedThreshold > 0 && size >= sharedThreshold ) {
+            QByteArray name = SharedSegment::write(l);
+            if ( !name.isEmpty() ) {
+                segments << name;
+                putString('M', name);
+                putU32(l.length());
+                return;
+            }
+        }
+
+        put('V');
+        putU32(l.length());
+        for ( int i=0; i<l.length(); ++i ) {
+            quint64 bits;
+            double d = l.at(i);
+            memcpy(&bits, &d, sizeof(bits));
+            putU32(bits & 0xffffffffu);
+            putU32(bits >> 32);
+        }
+        return;
+    }
+
+    beginList(l.length());
+    for ( int i=0; i<l.length(); ++i ) {
+        real(l.at(i));
+    }
+    endList();
+}
+
+/*
+ * Writes list of strings
+ */
+void EngineWriter::strings(const QStringList &l) {
+    beginList(l.length());
+    for ( int i=0; i<l.length(); ++i ) {
+        string(l.at(i));
+    }
+    endList();
+}
+
+/*
+ * Writes items of list (null value marks that next value is symbol); nested
+ * lists are written as lists
+ */
+void EngineWriter::values(QVariantList l) {
+    bool symNext = false;
+
+    foreach ( QVariant v, l ) {
+        if ( symNext ) {
+            symNext = false;
+            symbol(v.toString());
+
+        } else if ( v.type() == QVariant::Int ) {
+            integer(v.toInt());
+
+        } else if ( v.type() == QVariant::Double ) {
+            real(v.toDouble());
+
+        } else if ( v.type() == QVariant::List ) {
+            beginList(valueCount(v.toList()));
+            values(v.toList());
+            endList();
+
+        } else if ( v.isNull() ) {
+            symNext = true;
+
+        } else if ( v.type() == QVariant::Bool ) {
+            boolean(v.toBool());
+
+        } else {
+            string(v.toString());
+        }
+    }
+}
+
+/*
+ * Returns number of items values() writes for list
+ */
+int EngineWriter::valueCount(QVariantList l) {
+    int count = 0;
+    foreach ( QVariant v, l ) {
+        if ( !v.isNull() ) {
+            ++count;
+        }
+    }
+
+    return count;
+}
+
+/*
+ * Returns names of shared memory segments created for last message (caller
+ * removes them once engine has read them)
+ */
+QList<QByteArray> EngineWriter::takeSegments() {
+    QList<QByteArray> names = segments;
+    segments.clear();
+
+    return names;
+}
+
+/*
+ * Writes separator before text item if needed
+ */
+void EngineWriter::separate() {
+    if ( needSpace ) {
+        put(' ');
+    }
+    needSpace = true;
+}
+
+/*
+ * Puts byte to buffer
+ */
+void EngineWriter::put(char c) {
+    if ( used == buffer.size() ) {
+        flush(true);
+    }
+    buffer.data()[used++] = c;
+}
+
+/*
+ * Puts bytes to buffer (they are written directly if they do not fit)
+ */
+void EngineWriter::put(const char *data, int len) {
+    if ( used + len > buffer.size() ) {
+        flush(true);
+    }
+
+    if ( len > buffer.size() ) {
+        if ( binary ) {
+            char h[4];
+            quint32 v = len | MoreFrames;
+            for ( int i=0; i<4; ++i ) {
+                h[i] = (v >> (8*i)) & 0xff;
+            }
+            device->write(h, 4);
+            written += 4;
+        }
+        device->write(data, len);
+        written += len;
+        return;
+    }
+
+    memcpy(buffer.data() + used, data, len);
+    used += len;
+}
+
+/*
+ * Puts 32-bit little-endian integer to buffer
+ */
+void EngineWriter::putU32(quint32 v) {
+    char b[4];
+    for ( int i=0; i<4; ++i ) {
+        b[i] = (v >> (8*i)) & 0xff;
+    }
+    put(b, 4);
+}
+
+/*
+ * Puts tagged length prefixed string to buffer
+ */
+void EngineWriter::putString(char tag, QByteArray s) {
+    put(tag);
+    putU32(s.size());
+    put(s.constData(), s.size());
+}
+
+/*
+ * Writes buffer to device (as frame in binary protocol, `more' is set if
+ * message continues)
+ */
+void EngineWriter::flush(bool more) {
+    if ( used == 0 && more ) {
+        return;
+    }
+
+    if ( binary ) {
+        char h[4];
+        quint32 v = used | (more ? MoreFrames : 0);
+        for ( int i=0; i<4; ++i ) {
+            h[i] = (v >> (8*i)) & 0xff;
+        }
+        device->write(h, 4);
+        written += 4;
+    }
+
+    device->write(buffer.constData(), used);
+    written += used;
+    used = 0;
+}
@@ -0,0 +1,85 @@
+/*
+    Copyright (C) 2012 Ivan Radicek
+
+    This file is part of Bayes.
+
+    Bayes is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bayes is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Bayes.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ENGINEWRITER_H
+#define ENGINEWRITER_H
+
+#include <QIODevice>
+#include <QVariantList>
+
+/*
+ * Writes one command at a time straight to device (engine process) in
+ * S-expression or binary protocol (see engine.h). Data goes through fixed
+ * size buffer which is flushed in chunks (frames in binary protocol), so
+ * message of any size is written without building it in memory first.
+ *
+ * Lists must be given number of their items in advance because binary
+ * protocol stores it before items. In binary protocol lists of doubles are
+ * packed, and big ones are passed in shared memory segment if enabled.
+ */
+class EngineWriter {
+
+public:
+    EngineWriter(QIODevice *device, int chunkSize = 64*1024);
+
+    void setBinary(bool binary);
+    bool isBinary() const;
+
+    void setSharedThreshold(qint64 bytes);
+
+    void beginMessage(int count);
+    qint64 endMessage();
+
+    void beginList(int count);
+    void endList();
+
+    void symbol(QString s);
+    void string(QString s);
+    void integer(int i);
+    void real(double d);
+    void boolean(bool b);
+
+    void reals(const QList<double> &l);
+    void strings(const QStringList &l);
+    void values(QVariantList l);
+    int valueCount(QVariantList l);
+
+    QList<QByteArray> takeSegments();
+
+private:
+    void separate();
+    void put(char c);
+    void put(const char *data, int len);
+    void putU32(quint32 v);
+    void putString(char tag, QByteArray s);
+    void flush(bool more);
+
+    QIODevice *device;
+    bool binary;
+    qint64 sharedThreshold; // Bulk arrays this big go to shared memory
+
+    QByteArray buffer; // Fixed size buffer
+    int used;          // Bytes of buffer in use
+    bool needSpace;    // Text item needs separator before it
+    qint64 written;    // Bytes of message written so far
+
+    QList<QByteArray> segments; // Shared memory segments of message
+};
+
+#endif // ENGINEWRITER_H
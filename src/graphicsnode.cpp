@@ -56,9 +56,9 @@ const QColor GraphicsNode::backgroundColor = QColor(220, 220, 220);
 const QColor  GraphicsNode::textColor = QColor(200, 100, 100);
 
 /*
- * Creates new graphical node
+ * Creates new graphical node showing network node `n'
  */
-GraphicsNode::GraphicsNode(QString name) {
+GraphicsNode::GraphicsNode(Node *n) {
 
     // Set-up graphics & internals
     setFlag(ItemIsMovable);
@@ -67,9 +67,7 @@ GraphicsNode::GraphicsNode(QString name) {
     setCacheMode(DeviceCoordinateCache);
     queryMode = false;
 
-    // Set-up node
-    node = new Node();
-    node->setName(name);
+    node = n;
 }
 
 /*
@@ -80,13 +78,11 @@ Node* GraphicsNode::getNode() {
 }
 
 /*
- * Adds edge to list of edges conencted with this node
+ * Adds edge to list of edges conencted with this node (parent is added to
+ * node by editor)
  */
 void GraphicsNode::addEdge(GraphicsEdge* e) {
     edgeList << e;
-    if ( e->destination() == this ) {
-        node->addParent(e->source()->getNode());
-    }
 }
 
 /*
@@ -154,6 +150,10 @@ bool GraphicsNode::hasEdgeWith(GraphicsNode *n) {
  */
 void GraphicsNode::setQueryMode(bool t) {
     queryMode = t;
+
+    // Query values change with every query - cached pixmap would only have to
+    // be redrawn each time
+    setCacheMode(t ? NoCache : DeviceCoordinateCache);
     update();
 }
 
@@ -30,7 +30,7 @@ class GraphicsNode :  public QGraphicsObject {
     Q_OBJECT
 
 public:
-    GraphicsNode(QString name = QString(""));
+    GraphicsNode(Node *n);
 
     Node *getNode();
     qreal getRadius();
@@ -0,0 +1,307 @@
+/*
+    Copyright (C) 2012 Ivan Radicek
+
+    This file is part of Bayes.
+
+    Bayes is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bayes is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Bayes.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "bayes.h"
+
+#include <QHash>
+#include <QList>
+#include <QByteArray>
+
+#include <string.h>
+
+#include "network.h"
+#include "networksnapshot.h"
+#include "netfile.h"
+#include "junctiontree.h"
+#include "compilecache.h"
+#include "monitor.h"
+
+/*
+ * Network behind handle - frozen network, monitor of its compiled tree (with
+ * evidence and watched nodes) and UTF-8 names handed out to caller
+ */
+struct bayes_network {
+    NetworkSnapshot network;
+    Monitor monitor;
+
+    QList<QByteArray> names;
+    QList<QList<QByteArray> > values;
+    QHash<QByteArray, int> ids;
+};
+
+/*
+ * Checks if `node' is valid index of node of network
+ */
+static bool validNode(const bayes_network *net, int node) {
+    return net != NULL && node >= 0 && node < net->names.length();
+}
+
+/*
+ * Gets version of interface library implements
+ */
+int bayes_version(void) {
+    return BAYES_VERSION;
+}
+
+/*
+ * Copies message to caller's `error' buffer (if there is one)
+ */
+static void setError(QString message, char *error, int error_size) {
+    if ( error != NULL && error_size > 0 ) {
+        QByteArray e = message.toUtf8().left(error_size - 1);
+        memcpy(error, e.constData(), e.size());
+        error[e.size()] = '\0';
+    }
+}
+
+/*
+ * Creates handle of network read by NetFile and compiles it
+ */
+static bayes_network *createHandle(const Network &network) {
+    bayes_network *net = new bayes_network;
+    net->network = network.snapshot();
+    net->monitor = Monitor(CompileCache().tree(net->network));
+
+    for ( int i=0; i<net->network.nodeCount(); ++i ) {
+        QByteArray name = net->network.nodeName(i).toUtf8();
+        net->names << name;
+        if ( !net->ids.contains(name) ) {
+            net->ids[name] = i;
+        }
+
+        QList<QByteArray> vals;
+        foreach ( QString v, net->network.values(i) ) {
+            vals << v.toUtf8();
+        }
+        net->values << vals;
+    }
+
+    return net;
+}
+
+/*
+ * Loads network from .net or .netb file and compiles it; returns NULL on
+ * failure (message is written to `error' if it is not NULL)
+ */
+bayes_network *bayes_load(const char *file_name, char *error,
+                          int error_size) {
+    Network network;
+    QString err;
+
+    if ( !NetFile::read(QString::fromUtf8(file_name), &network, err) ) {
+        setError(err, error, error_size);
+        return NULL;
+    }
+
+    return createHandle(network);
+}
+
+/*
+ * Loads network from `size' bytes of .net text and compiles it; returns NULL
+ * on failure (message is written to `error' if it is not NULL)
+ */
+bayes_network *bayes_load_data(const char *data, int size, char *error,
+                               int error_size) {
+    Network network;
+    QString err;
+
+    if ( data == NULL || size < 0 ) {
+        setError("No network data", error, error_size);
+        return NULL;
+    }
+
+    if ( !NetFile::readData(QByteArray(data, size), &network, err) ) {
+        setError(err, error, error_size);
+        return NULL;
+    }
+
+    return createHandle(network);
+}
+
+/*
+ * Creates copy of network (sharing compiled tree) with its own evidence
+ */
+bayes_network *bayes_copy(const bayes_network *net) {
+    if ( net == NULL ) {
+        return NULL;
+    }
+
+    return new bayes_network(*net);
+}
+
+/*
+ * Frees network
+ */
+void bayes_free(bayes_network *net) {
+    delete net;
+}
+
+/*
+ * Gets number of nodes
+ */
+int bayes_node_count(const bayes_network *net) {
+    return net != NULL ? net->names.length() : 0;
+}
+
+/*
+ * Gets index of node with given name
+ */
+int bayes_node_index(const bayes_network *net, const char *name) {
+    if ( net == NULL || name == NULL ) {
+        return BAYES_ERROR_NODE;
+    }
+
+    return net->ids.value(QByteArray(name), BAYES_ERROR_NODE);
+}
+
+/*
+ * Gets name of node (NULL for invalid index)
+ */
+const char *bayes_node_name(const bayes_network *net, int node) {
+    if ( !validNode(net, node) ) {
+        return NULL;
+    }
+
+    return net->names.at(node).constData();
+}
+
+/*
+ * Gets number of values of node
+ */
+int bayes_value_count(const bayes_network *net, int node) {
+    if ( !validNode(net, node) ) {
+        return BAYES_ERROR_NODE;
+    }
+
+    return net->values.at(node).length();
+}
+
+/*
+ * Gets index of node value with given name
+ */
+int bayes_value_index(const bayes_network *net, int node, const char *value) {
+    if ( !validNode(net, node) ) {
+        return BAYES_ERROR_NODE;
+    }
+
+    int i = value != NULL ? net->values.at(node).indexOf(value) : -1;
+
+    return i >= 0 ? i : BAYES_ERROR_VALUE;
+}
+
+/*
+ * Gets name of node value (NULL for invalid indexes)
+ */
+const char *bayes_value_name(const bayes_network *net, int node, int value) {
+    if ( !validNode(net, node) || value < 0 ||
+         value >= net->values.at(node).length() ) {
+        return NULL;
+    }
+
+    return net->values.at(node).at(value).constData();
+}
+
+/*
+ * Sets evidence of node to value with index `value' (-1 removes evidence)
+ */
+int bayes_set_evidence(bayes_network *net, int node, int value) {
+    if ( !validNode(net, node) ) {
+        return BAYES_ERROR_NODE;
+    }
+
+    if ( value < -1 || value >= net->values.at(node).length() ) {
+        return BAYES_ERROR_VALUE;
+    }
+
+    net->monitor.setEvidence(node, value);
+
+    return BAYES_OK;
+}
+
+/*
+ * Removes evidence of all nodes
+ */
+void bayes_clear_evidence(bayes_network *net) {
+    if ( net != NULL ) {
+        net->monitor.tree().clearEvidence();
+    }
+}
+
+/*
+ * Writes probabilities of node values given evidence to `p' (which has room
+ * for `size' numbers); returns number of values
+ */
+int bayes_marginal(bayes_network *net, int node, double *p, int size) {
+    if ( !validNode(net, node) ) {
+        return BAYES_ERROR_NODE;
+    }
+
+    int count = net->values.at(node).length();
+    if ( p == NULL || size < count ) {
+        return BAYES_ERROR_SIZE;
+    }
+
+    QVector<double> m = net->monitor.tree().marginal(node);
+    for ( int i=0; i<count; ++i ) {
+        p[i] = m.at(i);
+    }
+
+    return count;
+}
+
+/*
+ * Starts watching node
+ */
+int bayes_watch(bayes_network *net, int node) {
+    if ( !validNode(net, node) ) {
+        return BAYES_ERROR_NODE;
+    }
+
+    net->monitor.watch(node);
+
+    return BAYES_OK;
+}
+
+/*
+ * Sets smallest change of posterior of watched node bayes_update() reports
+ */
+void bayes_set_threshold(bayes_network *net, double threshold) {
+    if ( net != NULL ) {
+        net->monitor.setThreshold(threshold);
+    }
+}
+
+/*
+ * Recomputes posteriors of watched nodes and writes those which have changed
+ * by more than threshold since they were last reported to `nodes' (it needs
+ * room for all watched nodes); returns their number
+ */
+int bayes_update(bayes_network *net, int *nodes, int size) {
+    if ( net == NULL || nodes == NULL ||
+         size < net->monitor.watched().size() ) {
+        return BAYES_ERROR_SIZE;
+    }
+
+    QVector<int> changed = net->monitor.update();
+    for ( int i=0; i<changed.size(); ++i ) {
+        nodes[i] = changed.at(i);
+    }
+
+    return changed.size();
+}
@@ -0,0 +1,101 @@
+/*
+    Copyright (C) 2012 Ivan Radicek
+
+    This file is part of Bayes.
+
+    Bayes is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bayes is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Bayes.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BAYES_H
+#define BAYES_H
+
+/*
+ * C interface of Bayes inference library. Networks are loaded from .net (or
+ * binary .netb) files or from .net text in memory and queried in process by
+ * exact inference (junction tree). Compiled trees are kept in cache directory
+ * next to settings, so loading network again skips compilation
+ * (BAYES_CACHE_DIR environment variable sets other directory, empty value
+ * turns cache off).
+ *
+ * Nodes and their values are addressed by indexes (nodes in order of file,
+ * values in order of node). Functions returning int report failure with
+ * negative BAYES_ERROR_* codes. Strings are UTF-8 and returned ones are owned
+ * by network handle. Handle must not be used from more threads at once -
+ * bayes_copy() gives cheap copy (with own evidence) for each thread.
+ *
+ * Evidence can be changed incrementally - only inference work the change
+ * invalidates is redone. For monitoring, watched nodes are set with
+ * bayes_watch() and after evidence changes bayes_update() tells which of
+ * them have posterior changed by more than threshold.
+ */
+
+#if defined(_WIN32) && !defined(BAYES_STATIC)
+#  if defined(BAYES_LIBRARY)
+#    define BAYES_API __declspec(dllexport)
+#  else
+#    define BAYES_API __declspec(dllimport)
+#  endif
+#elif defined(__GNUC__)
+#  define BAYES_API __attribute__((visibility("default")))
+#else
+#  define BAYES_API
+#endif
+
+/* Version of interface, increased only by incompatible changes */
+#define BAYES_VERSION 1
+
+#define BAYES_OK 0
+#define BAYES_ERROR_NODE -1
+#define BAYES_ERROR_VALUE -2
+#define BAYES_ERROR_SIZE -3
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct bayes_network bayes_network;
+
+BAYES_API int bayes_version(void);
+
+BAYES_API bayes_network *bayes_load(const char *file_name, char *error,
+                                    int error_size);
+BAYES_API bayes_network *bayes_load_data(const char *data, int size,
+                                         char *error, int error_size);
+BAYES_API bayes_network *bayes_copy(const bayes_network *net);
+BAYES_API void bayes_free(bayes_network *net);
+
+BAYES_API int bayes_node_count(const bayes_network *net);
+BAYES_API int bayes_node_index(const bayes_network *net, const char *name);
+BAYES_API const char *bayes_node_name(const bayes_network *net, int node);
+
+BAYES_API int bayes_value_count(const bayes_network *net, int node);
+BAYES_API int bayes_value_index(const bayes_network *net, int node,
+                                const char *value);
+BAYES_API const char *bayes_value_name(const bayes_network *net, int node,
+                                       int value);
+
+BAYES_API int bayes_set_evidence(bayes_network *net, int node, int value);
+BAYES_API void bayes_clear_evidence(bayes_network *net);
+BAYES_API int bayes_marginal(bayes_network *net, int node, double *p,
+                             int size);
+
+BAYES_API int bayes_watch(bayes_network *net, int node);
+BAYES_API void bayes_set_threshold(bayes_network *net, double threshold);
+BAYES_API int bayes_update(bayes_network *net, int *nodes, int size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BAYES_H */
@@ -0,0 +1,96 @@
+/*
+    Copyright (C) 2012 Ivan Radicek
+
+    This file is part of Bayes.
+
+    Bayes is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bayes is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Bayes.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "compilecache.h"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSettings>
+
+#include <stdlib.h>
+
+/*
+ * Creates cache in default directory
+ */
+CompileCache::CompileCache() {
+    dir = defaultDirectory();
+}
+
+/*
+ * Creates cache in `directory' (empty one turns cache off)
+ */
+CompileCache::CompileCache(QString directory) {
+    dir = directory;
+}
+
+/*
+ * Gets directory of cache (empty if cache is off)
+ */
+QString CompileCache::directory() const {
+    return dir;
+}
+
+/*
+ * Gets default directory of cache
+ */
+QString CompileCache::defaultDirectory() {
+    const char *env = getenv("BAYES_CACHE_DIR");
+    if ( env != NULL ) {
+        return QString::fromLocal8Bit(env);
+    }
+
+    QSettings settings(QSettings::IniFormat, QSettings::UserScope,
+                       "FER", "Bayes-GUI");
+
+    return QFileInfo(settings.fileName()).absolutePath() + "/cache";
+}
+
+/*
+ * Gets tree of network from cache or compiles it (and stores it in cache)
+ */
+JunctionTree CompileCache::tree(const NetworkSnapshot &network) const {
+    if ( dir.isEmpty() ) {
+        return JunctionTree(network);
+    }
+
+    quint64 key = JunctionTree::key(network);
+    QString fileName = QString("%1/%2.jt").arg(dir)
+                       .arg(key, 16, 16, QChar('0'));
+
+    JunctionTree tree;
+    if ( tree.load(fileName, key, network) ) {
+        return tree;
+    }
+
+    tree = JunctionTree(network);
+
+    // File is written under temporary name and renamed, so other processes
+    // never see it half written
+    QString tempName = QString("%1.%2").arg(fileName)
+                       .arg(QCoreApplication::applicationPid());
+    QFile::remove(fileName);
+    if ( QDir().mkpath(dir) && tree.save(tempName, key) ) {
+        QFile::rename(tempName, fileName);
+    }
+    QFile::remove(tempName);
+
+    return tree;
+}
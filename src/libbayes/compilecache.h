@@ -17,16 +17,34 @@
     along with Bayes.  If not, see <http://www.gnu.org/licenses/>.
 */
 
-#include "network.h"
+#ifndef COMPILECACHE_H
+#define COMPILECACHE_H
 
-Network::Network(QObject *parent) : QObject(parent) {
-    netName = tr("Untitled network");
-}
+#include <QString>
 
-QString Network::name() const {
-    return netName;
-}
+#include "junctiontree.h"
 
-void Network::setName(QString name) {
-    netName = name;
-}
+class NetworkSnapshot;
+
+/*
+ * Directory of compiled junction trees named by key of network they were
+ * compiled for, so reopening network loads its tree instead of compiling it.
+ * Default directory is next to settings of Bayes-GUI (BAYES_CACHE_DIR
+ * environment variable overrides it, empty value turns cache off).
+ */
+class CompileCache {
+
+public:
+    CompileCache();
+    CompileCache(QString directory);
+
+    QString directory() const;
+    static QString defaultDirectory();
+
+    JunctionTree tree(const NetworkSnapshot &network) const;
+
+private:
+    QString dir;
+};
+
+#endif // COMPILECACHE_H
@@ -0,0 +1,207 @@
+/*
+    Copyright (C) 2012 Ivan Radicek
+
+    This file is part of Bayes.
+
+    Bayes is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bayes is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Bayes.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "factor.h"
+
+/*
+ * Creates empty factor (over no variables, with one entry)
+ */
+Factor::Factor() {
+    table << 1.0;
+}
+
+/*
+ * Creates factor over `vars' (of sizes `dims') with all entries set to one
+ */
+Factor::Factor(QVector<int> vars, QVector<int> dims) {
+    int size = 1;
+    foreach ( int d, dims ) {
+        size *= d;
+    }
+
+    this->vars = vars;
+    this->dims = dims;
+    table.fill(1.0, size);
+}
+
+/*
+ * Creates factor over `vars' (of sizes `dims') with given entries
+ */
+Factor::Factor(QVector<int> vars, QVector<int> dims, QVector<double> values) {
+    this->vars = vars;
+    this->dims = dims;
+    table = values;
+}
+
+/*
+ * Gets variables of factor
+ */
+QVector<int> Factor::variables() const {
+    return vars;
+}
+
+/*
+ * Gets number of values of each variable
+ */
+QVector<int> Factor::dimensions() const {
+    return dims;
+}
+
+/*
+ * Gets number of entries
+ */
+int Factor::size() const {
+    return table.size();
+}
+
+/*
+ * Gets entry with index `i'
+ */
+double Factor::value(int i) const {
+    return table.at(i);
+}
+
+/*
+ * Gets all entries
+ */
+QVector<double> Factor::values() const {
+    return table;
+}
+
+/*
+ * Gets strides of variables of this factor in factor `f' (0 for variables
+ * `f' does not have)
+ */
+QVector<int> Factor::stridesIn(const Factor &f) const {
+    QVector<int> strides(vars.size(), 0);
+    int stride = 1;
+
+    for ( int i=f.vars.size()-1; i>=0; --i ) {
+        int k = vars.indexOf(f.vars.at(i));
+        if ( k >= 0 ) {
+            strides[k] = stride;
+        }
+        stride *= f.dims.at(i);
+    }
+
+    return strides;
+}
+
+/*
+ * Multiplies factor with factor `f' (its variables have to be subset of
+ * variables of this one)
+ */
+void Factor::multiply(const Factor &f) {
+    QVector<int> strides = stridesIn(f);
+    QVector<int> counter(vars.size(), 0);
+    const double *other = f.table.constData();
+    double *t = table.data();
+    int j = 0;
+
+    for ( int i=0; i<table.size(); ++i ) {
+        t[i] *= other[j];
+
+        // Next assignment (last variable changes fastest)
+        for ( int k=vars.size()-1; k>=0; --k ) {
+            j += strides.at(k);
+            if ( ++counter[k] < dims.at(k) ) {
+                break;
+            }
+            j -= strides.at(k) * dims.at(k);
+            counter[k] = 0;
+        }
+    }
+}
+
+/*
+ * Sets entries where `var' does not have `value' to zero (evidence)
+ */
+void Factor::reduce(int var, int value) {
+    int k = vars.indexOf(var);
+    if ( k < 0 ) {
+        return;
+    }
+
+    int stride = 1;
+    for ( int i=k+1; i<vars.size(); ++i ) {
+        stride *= dims.at(i);
+    }
+
+    double *t = table.data();
+    for ( int i=0; i<table.size(); ++i ) {
+        if ( (i / stride) % dims.at(k) != value ) {
+            t[i] = 0.0;
+        }
+    }
+}
+
+/*
+ * Sums out all variables except `vars' (which have to be subset of
+ * variables of factor); result has variables in order of `vars'
+ */
+Factor Factor::marginal(QVector<int> vars) const {
+    QVector<int> mdims;
+    foreach ( int v, vars ) {
+        mdims << dims.at(this->vars.indexOf(v));
+    }
+
+    Factor m(vars, mdims);
+    m.table.fill(0.0);
+
+    QVector<int> strides = stridesIn(m);
+    QVector<int> counter(this->vars.size(), 0);
+    const double *t = table.constData();
+    double *r = m.table.data();
+    int j = 0;
+
+    for ( int i=0; i<table.size(); ++i ) {
+        r[j] += t[i];
+
+        for ( int k=this->vars.size()-1; k>=0; --k ) {
+            j += strides.at(k);
+            if ( ++counter[k] < dims.at(k) ) {
+                break;
+            }
+            j -= strides.at(k) * dims.at(k);
+            counter[k] = 0;
+        }
+    }
+
+    return m;
+}
+
+/*
+ * Scales entries so that they sum to one; returns previous sum (entries are
+ * left as they are if it is zero)
+ */
+double Factor::normalize() {
+    double sum = 0.0;
+    foreach ( double v, table ) {
+        sum += v;
+    }
+
+    if ( sum > 0.0 ) {
+        double *t = table.data();
+        for ( int i=0; i<table.size(); ++i ) {
+            t[i] /= sum;
+        }
+    }
+
+    return sum;
+}
@@ -0,0 +1,56 @@
+/*
+    Copyright (C) 2012 Ivan Radicek
+
+    This file is part of Bayes.
+
+    Bayes is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bayes is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Bayes.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef FACTOR_H
+#define FACTOR_H
+
+#include <QVector>
+
+/*
+ * Table of non-negative numbers over all assignments of some variables
+ * (nodes). Last variable changes fastest, same as in probability tables of
+ * nodes, so table of node is factor over its parents and node itself.
+ */
+class Factor {
+
+public:
+    Factor();
+    Factor(QVector<int> vars, QVector<int> dims);
+    Factor(QVector<int> vars, QVector<int> dims, QVector<double> values);
+
+    QVector<int> variables() const;
+    QVector<int> dimensions() const;
+    int size() const;
+    double value(int i) const;
+    QVector<double> values() const;
+
+    void multiply(const Factor &f);
+    void reduce(int var, int value);
+    Factor marginal(QVector<int> vars) const;
+    double normalize();
+
+private:
+    QVector<int> stridesIn(const Factor &f) const;
+
+    QVector<int> vars;
+    QVector<int> dims;
+    QVector<double> table;
+};
+
+#endif // FACTOR_H
@@ -0,0 +1,661 @@
+/*
+    Copyright (C) 2012 Ivan Radicek
+
+    This file is part of Bayes.
+
+    Bayes is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bayes is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Bayes.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "junctiontree.h"
+
+#include <QFile>
+#include <QSet>
+
+#include <string.h>
+
+#include "networksnapshot.h"
+#include "node.h"
+
+// Compiled tree files start with magic (8 bytes with terminating zero)
+static const char treeMagic[8] = "BAYESJT";
+
+// Version of compiled tree file format and compilation (files of other
+// versions are not used)
+static const quint32 treeVersion = 1;
+
+// Written as number; reads differently on machine with other byte order
+static const quint32 byteOrderMark = 0x01020304;
+
+// Probabilities of cliques start on page boundary
+static const quint64 pageSize = 4096;
+
+// FNV-1a (64 bit) hash offset
+static const quint64 fnvOffset = 14695981039346656037ULL;
+
+/*
+ * Beginning of compiled tree file. It is followed by (32 bit) cardinalities,
+ * elimination order and clique parents of nodes, CSR arrays of clique nodes
+ * and separator nodes (starts and items), (64 bit) starts of clique
+ * probabilities and (page aligned) probabilities themselves.
+ */
+struct TreeFileHeader {
+    char magic[8];
+    quint32 version;
+    quint32 byteOrder;
+    quint64 key;
+    quint32 nodeCount;
+    quint32 cliqueItems;
+    quint32 separatorItems;
+    quint32 reserved;
+    quint64 values;
+    quint64 fileSize;
+};
+
+/*
+ * Gets offset rounded up to multiple of `to'
+ */
+static quint64 align(quint64 offset, quint64 to) {
+    return (offset + to - 1) / to * to;
+}
+
+/*
+ * Creates empty tree
+ */
+JunctionTree::JunctionTree() {
+    changes = 0;
+}
+
+/*
+ * Compiles tree for network (it has to be valid - acyclic, with tables of
+ * right sizes)
+ */
+JunctionTree::JunctionTree(const NetworkSnapshot &network) {
+    compile(network);
+    reset();
+}
+
+/*
+ * Resets evidence and messages of compiled tree
+ */
+void JunctionTree::reset() {
+    evidences.fill(-1, nodeCount());
+    changes = 0;
+    subtreeChanges.fill(0, nodeCount());
+
+    up.resize(nodeCount());
+    down.resize(nodeCount());
+    upChanges.fill(-1, nodeCount());
+    downChanges.fill(-1, nodeCount());
+}
+
+/*
+ * Eliminates nodes from moral graph and builds cliques with their potentials
+ */
+void JunctionTree::compile(const NetworkSnapshot &network) {
+    int n = network.nodeCount();
+
+    // Moral graph: node is connected with its parents and parents among
+    // themselves
+    QVector<QSet<int> > graph(n);
+    for ( int v=0; v<n; ++v ) {
+        cards << network.cardinality(v);
+
+        QVector<int> family = network.parents(v);
+        family << v;
+        foreach ( int a, family ) {
+            foreach ( int b, family ) {
+                if ( a != b ) {
+                    graph[a] << b;
+                }
+            }
+        }
+    }
+
+    // Elimination - node whose elimination adds fewest edges goes first
+    // (smaller clique wins ties)
+    QVector<QVector<int> > cliques(n);
+    QVector<int> position(n, -1);
+    QVector<bool> eliminated(n, false);
+
+    for ( int step=0; step<n; ++step ) {
+        int best = -1;
+        int bestFill = 0;
+        double bestWeight = 0.0;
+
+        for ( int v=0; v<n; ++v ) {
+            if ( eliminated.at(v) ) {
+                continue;
+            }
+
+            QList<int> nbrs = graph.at(v).toList();
+            int fill = 0;
+            double weight = cards.at(v);
+            for ( int i=0; i<nbrs.size(); ++i ) {
+                weight *= cards.at(nbrs.at(i));
+                for ( int j=i+1; j<nbrs.size(); ++j ) {
+                    if ( !graph.at(nbrs.at(i)).contains(nbrs.at(j)) ) {
+                        ++fill;
+                    }
+                }
+            }
+
+            if ( best < 0 || fill < bestFill ||
+                 (fill == bestFill && weight < bestWeight) ) {
+                best = v;
+                bestFill = fill;
+                bestWeight = weight;
+            }
+        }
+
+        // Clique is node with its neighbours, which become connected
+        QList<int> nbrs = graph.at(best).toList();
+        cliques[best] << best;
+        foreach ( int a, nbrs ) {
+            cliques[best] << a;
+            graph[a].remove(best);
+            foreach ( int b, nbrs ) {
+                if ( a != b ) {
+                    graph[a] << b;
+                }
+            }
+        }
+
+        eliminated[best] = true;
+        position[best] = step;
+        order << best;
+    }
+
+    // Parent of clique is clique of first eliminated node among others
+    parent.fill(-1, n);
+    children.resize(n);
+    separators.resize(n);
+    for ( int v=0; v<n; ++v ) {
+        int p = -1;
+        for ( int i=1; i<cliques.at(v).size(); ++i ) {
+            int u = cliques.at(v).at(i);
+            if ( p < 0 || position.at(u) < position.at(p) ) {
+                p = u;
+            }
+        }
+
+        if ( p >= 0 ) {
+            parent[v] = p;
+            children[p] << v;
+            separators[v] = cliques.at(v).mid(1);
+        }
+    }
+
+    // Each table goes to clique of first eliminated node of its family (it
+    // holds whole family)
+    for ( int v=0; v<n; ++v ) {
+        QVector<int> dims;
+        foreach ( int u, cliques.at(v) ) {
+            dims << cards.at(u);
+        }
+        base << Factor(cliques.at(v), dims);
+    }
+
+    for ( int v=0; v<n; ++v ) {
+        QVector<int> family = network.parents(v);
+        family << v;
+
+        int home = v;
+        QVector<int> dims;
+        foreach ( int u, family ) {
+            if ( position.at(u) < position.at(home) ) {
+                home = u;
+            }
+            dims << cards.at(u);
+        }
+
+        base[home].multiply(Factor(family, dims,
+                                   network.tableList(v).toVector()));
+    }
+}
+
+/*
+ * Gets number of nodes
+ */
+int JunctionTree::nodeCount() const {
+    return cards.size();
+}
+
+/*
+ * Gets number of values of node
+ */
+int JunctionTree::cardinality(int node) const {
+    return cards.at(node);
+}
+
+/*
+ * Gets number of nodes in largest clique
+ */
+int JunctionTree::width() const {
+    int w = 0;
+
+    foreach ( const Factor &f, base ) {
+        w = qMax(w, f.variables().size());
+    }
+
+    return w;
+}
+
+/*
+ * Gets evidence of node (-1 if it has none)
+ */
+int JunctionTree::evidence(int node) const {
+    return evidences.at(node);
+}
+
+/*
+ * Sets evidence of node (-1 removes it); clique of node and its ancestors
+ * count the change
+ */
+void JunctionTree::setEvidence(int node, int value) {
+    if ( evidences.at(node) == value ) {
+        return;
+    }
+
+    evidences[node] = value;
+    ++changes;
+
+    for ( int c=node; c>=0; c=parent.at(c) ) {
+        ++subtreeChanges[c];
+    }
+}
+
+/*
+ * Removes all evidence
+ */
+void JunctionTree::clearEvidence() {
+    for ( int v=0; v<evidences.size(); ++v ) {
+        setEvidence(v, -1);
+    }
+}
+
+/*
+ * Gets potential of clique with its evidence applied
+ */
+Factor JunctionTree::potential(int clique) const {
+    Factor f = base.at(clique);
+
+    if ( evidences.at(clique) >= 0 ) {
+        f.reduce(clique, evidences.at(clique));
+    }
+
+    return f;
+}
+
+/*
+ * Gets message from clique to its parent (normalized to stay in range of
+ * doubles)
+ */
+Factor JunctionTree::upMessage(int clique) {
+    if ( upChanges.at(clique) != subtreeChanges.at(clique) ) {
+        Factor f = potential(clique);
+
+        foreach ( int c, children.at(clique) ) {
+            f.multiply(upMessage(c));
+        }
+
+        up[clique] = f.marginal(separators.at(clique));
+        up[clique].normalize();
+        upChanges[clique] = subtreeChanges.at(clique);
+    }
+
+    return up.at(clique);
+}
+
+/*
+ * Gets message from parent of clique to clique
+ */
+Factor JunctionTree::downMessage(int clique) {
+    int outside = changes - subtreeChanges.at(clique);
+
+    if ( downChanges.at(clique) != outside ) {
+        int p = parent.at(clique);
+        Factor f = potential(p);
+
+        foreach ( int c, children.at(p) ) {
+            if ( c != clique ) {
+                f.multiply(upMessage(c));
+            }
+        }
+
+        if ( parent.at(p) >= 0 ) {
+            f.multiply(downMessage(p));
+        }
+
+        down[clique] = f.marginal(separators.at(clique));
+        down[clique].normalize();
+        downChanges[clique] = outside;
+    }
+
+    return down.at(clique);
+}
+
+/*
+ * Gets probabilities of node values given evidence (uniform when evidence is
+ * impossible)
+ */
+QVector<double> JunctionTree::marginal(int node) {
+    Factor f = potential(node);
+
+    foreach ( int c, children.at(node) ) {
+        f.multiply(upMessage(c));
+    }
+
+    if ( parent.at(node) >= 0 ) {
+        f.multiply(downMessage(node));
+    }
+
+    Factor m = f.marginal(QVector<int>() << node);
+    if ( m.normalize() > 0.0 ) {
+        return m.values();
+    }
+
+    return QVector<double>(cards.at(node), 1.0 / cards.at(node));
+}
+
+// COMPILED FILES //////////////////////////////////////////////////////////////
+
+/*
+ * Gets hash of network cardinalities, parents and tables (names and meta
+ * data do not change compiled tree)
+ */
+quint64 JunctionTree::key(const NetworkSnapshot &network) {
+    quint64 h = Node::hashBytes(fnvOffset, &treeVersion, sizeof(treeVersion));
+    int n = network.nodeCount();
+    h = Node::hashBytes(h, &n, sizeof(n));
+
+    for ( int v=0; v<n; ++v ) {
+        int card = network.cardinality(v);
+        QVector<int> parents = network.parents(v);
+        int count = parents.size();
+
+        h = Node::hashBytes(h, &card, sizeof(card));
+        h = Node::hashBytes(h, &count, sizeof(count));
+        h = Node::hashBytes(h, parents.constData(), count * sizeof(int));
+
+        QVector<double> table = network.tableList(v).toVector();
+        for ( int i=0; i<table.size(); i+=(1 << 20) ) {
+            int size = qMin(1 << 20, table.size() - i);
+            h = Node::hashBytes(h, table.constData() + i,
+                                size * sizeof(double));
+        }
+    }
+
+    return h;
+}
+
+/*
+ * Writes compiled tree to file (evidence is not saved); returns false if it
+ * cannot be written
+ */
+bool JunctionTree::save(QString fileName, quint64 key) const {
+    int n = nodeCount();
+
+    QVector<qint32> ints;
+    QVector<qint32> cliqueStart, cliqueItems, separatorStart, separatorItems;
+    QVector<quint64> valueStart;
+    quint64 values = 0;
+
+    for ( int v=0; v<n; ++v ) {
+        cliqueStart << cliqueItems.size();
+        cliqueItems << base.at(v).variables();
+        separatorStart << separatorItems.size();
+        separatorItems << separators.at(v);
+        valueStart << values;
+        values += base.at(v).size();
+    }
+    cliqueStart << cliqueItems.size();
+    separatorStart << separatorItems.size();
+    valueStart << values;
+
+    ints << cards << order << parent << cliqueStart << cliqueItems
+         << separatorStart << separatorItems;
+
+    TreeFileHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, treeMagic, sizeof(treeMagic));
+    h.version = treeVersion;
+    h.byteOrder = byteOrderMark;
+    h.key = key;
+    h.nodeCount = n;
+    h.cliqueItems = cliqueItems.size();
+    h.separatorItems = separatorItems.size();
+    h.values = values;
+
+    quint64 starts = align(sizeof(h) + ints.size() * sizeof(qint32), 8);
+    quint64 tables = align(starts + valueStart.size() * sizeof(quint64),
+                           pageSize);
+    h.fileSize = tables + values * sizeof(double);
+
+    QFile file(fileName);
+    if ( !file.open(QIODevice::WriteOnly | QIODevice::Truncate) ) {
+        return false;
+    }
+
+    file.write((const char*) &h, sizeof(h));
+    file.write((const char*) ints.constData(), ints.size() * sizeof(qint32));
+    file.write(QByteArray(starts - file.pos(), '\0'));
+    file.write((const char*) valueStart.constData(),
+               valueStart.size() * sizeof(quint64));
+    file.write(QByteArray(tables - file.pos(), '\0'));
+
+    for ( int v=0; v<n; ++v ) {
+        QVector<double> p = base.at(v).values();
+        file.write((const char*) p.constData(), p.size() * sizeof(double));
+    }
+    file.close();
+
+    return file.error() == QFile::NoError;
+}
+
+/*
+ * Reads tree of `network' saved with save() (file is mapped and checked, it
+ * is used only if it was written for network with same key and its structure
+ * fits `network'); evidence is cleared. Returns false (leaving tree as it
+ * was) if file cannot be used.
+ */
+bool JunctionTree::load(QString fileName, quint64 key,
+                        const NetworkSnapshot &network) {
+    QFile file(fileName);
+    if ( !file.open(QIODevice::ReadOnly) ||
+         (quint64) file.size() < sizeof(TreeFileHeader) ) {
+        return false;
+    }
+
+    const uchar *data = file.map(0, file.size());
+    if ( data == NULL ) {
+        return false;
+    }
+
+    const TreeFileHeader *h = (const TreeFileHeader*) data;
+    quint64 n = h->nodeCount;
+    quint64 intCount = 5 * n + 2 + h->cliqueItems + h->separatorItems;
+    quint64 starts = align(sizeof(*h) + intCount * sizeof(qint32), 8);
+    quint64 tables = align(starts + (n + 1) * sizeof(quint64), pageSize);
+
+    bool ok = memcmp(h->magic, treeMagic, sizeof(treeMagic)) == 0 &&
+              h->version == treeVersion && h->byteOrder == byteOrderMark &&
+              h->key == key && h->fileSize == (quint64) file.size() &&
+              tables <= h->fileSize &&
+              h->values <= (h->fileSize - tables) / sizeof(double);
+
+    // Arrays in order they are written
+    const qint32 *ints = (const qint32*) (data + sizeof(*h));
+    const qint32 *fileCards = ints;
+    const qint32 *fileOrder = fileCards + n;
+    const qint32 *fileParent = fileOrder + n;
+    const qint32 *cliqueStart = fileParent + n;
+    const qint32 *cliqueItems = cliqueStart + n + 1;
+    const qint32 *separatorStart = cliqueItems + h->cliqueItems;
+    const qint32 *separatorItems = separatorStart + n + 1;
+    const quint64 *valueStart = (const quint64*) (data + starts);
+    const double *values = (const double*) (data + tables);
+
+    ok = ok && cliqueStart[0] == 0 && separatorStart[0] == 0 &&
+         valueStart[0] == 0 && (quint64) cliqueStart[n] == h->cliqueItems &&
+         (quint64) separatorStart[n] == h->separatorItems &&
+         valueStart[n] == h->values;
+
+    // Rows must be in range and clique probabilities must fit its nodes
+    for ( quint64 v=0; v<n && ok; ++v ) {
+        ok = fileCards[v] > 0 && fileParent[v] >= -1 &&
+             fileParent[v] < (qint64) n &&
+             cliqueStart[v] <= cliqueStart[v+1] &&
+             separatorStart[v] <= separatorStart[v+1] &&
+             valueStart[v] <= valueStart[v+1];
+
+        quint64 size = 1;
+        for ( qint32 i=cliqueStart[v]; i<cliqueStart[v+1] && ok; ++i ) {
+            ok = cliqueItems[i] >= 0 && cliqueItems[i] < (qint64) n;
+            size = ok ? qMin(size * fileCards[cliqueItems[i]],
+                             h->values + 1) : 0;
+        }
+        for ( qint32 i=separatorStart[v]; i<separatorStart[v+1] && ok; ++i ) {
+            ok = separatorItems[i] >= 0 && separatorItems[i] < (qint64) n;
+        }
+
+        ok = ok && size == valueStart[v+1] - valueStart[v];
+    }
+
+    if ( !ok ) {
+        return false;
+    }
+
+    // Arrays are copied out of mapping
+    JunctionTree t;
+    t.cards = QVector<int>(n);
+    t.order = QVector<int>(n);
+    t.parent = QVector<int>(n);
+    memcpy(t.cards.data(), fileCards, n * sizeof(qint32));
+    memcpy(t.order.data(), fileOrder, n * sizeof(qint32));
+    memcpy(t.parent.data(), fileParent, n * sizeof(qint32));
+
+    t.children = QVector<QVector<int> >(n);
+    t.separators = QVector<QVector<int> >(n);
+
+    for ( quint64 v=0; v<n; ++v ) {
+        for ( qint32 i=separatorStart[v]; i<separatorStart[v+1]; ++i ) {
+            t.separators[v] << separatorItems[i];
+        }
+
+        QVector<int> vars, dims;
+        for ( qint32 i=cliqueStart[v]; i<cliqueStart[v+1]; ++i ) {
+            vars << cliqueItems[i];
+            dims << t.cards.at(cliqueItems[i]);
+        }
+
+        QVector<double> p(valueStart[v+1] - valueStart[v]);
+        memcpy(p.data(), values + valueStart[v], p.size() * sizeof(double));
+        t.base << Factor(vars, dims, p);
+    }
+
+    if ( !t.matches(network) ) {
+        return false;
+    }
+
+    for ( quint64 v=0; v<n; ++v ) {
+        if ( t.parent.at(v) >= 0 ) {
+            t.children[t.parent.at(v)] << v;
+        }
+    }
+
+    *this = t;
+    reset();
+
+    return true;
+}
+
+/*
+ * Checks that loaded structure is junction tree of `network': nodes have
+ * its cardinalities, elimination order holds every node once, parents of
+ * cliques form forest, separators are in both clique and its parent and
+ * family of every node is in clique its table goes to
+ */
+bool JunctionTree::matches(const NetworkSnapshot &network) const {
+    int n = nodeCount();
+    if ( network.nodeCount() != n ) {
+        return false;
+    }
+
+    QVector<int> position(n, -1);
+    for ( int i=0; i<n; ++i ) {
+        int v = order.at(i);
+        if ( v < 0 || v >= n || position.at(v) >= 0 ) {
+            return false;
+        }
+        position[v] = i;
+    }
+
+    for ( int v=0; v<n; ++v ) {
+        QVector<int> clique = base.at(v).variables();
+        if ( cards.at(v) != network.cardinality(v) || !clique.contains(v) ||
+             clique.toList().toSet().size() != clique.size() ) {
+            return false;
+        }
+
+        // Separator is empty for root clique
+        int p = parent.at(v);
+        if ( p == v || (p < 0 && !separators.at(v).isEmpty()) ) {
+            return false;
+        }
+        foreach ( int u, separators.at(v) ) {
+            if ( !clique.contains(u) ||
+                 !base.at(p).variables().contains(u) ) {
+                return false;
+            }
+        }
+    }
+
+    // Walk from each clique to its root stops at clique seen on same walk
+    // only if there is cycle
+    QVector<int> walk(n, -1);
+    for ( int v=0; v<n; ++v ) {
+        int u = v;
+        while ( u >= 0 && walk.at(u) < 0 ) {
+            walk[u] = v;
+            u = parent.at(u);
+        }
+        if ( u >= 0 && walk.at(u) == v ) {
+            return false;
+        }
+    }
+
+    for ( int v=0; v<n; ++v ) {
+        QVector<int> family = network.parents(v);
+        family << v;
+
+        int home = v;
+        foreach ( int u, family ) {
+            if ( u < 0 || u >= n ) {
+                return false;
+            }
+            if ( position.at(u) < position.at(home) ) {
+                home = u;
+            }
+        }
+
+        QVector<int> clique = base.at(home).variables();
+        foreach ( int u, family ) {
+            if ( !clique.contains(u) ) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
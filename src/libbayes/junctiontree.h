@@ -0,0 +1,99 @@
+/*
+    Copyright (C) 2012 Ivan Radicek
+
+    This file is part of Bayes.
+
+    Bayes is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bayes is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Bayes.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef JUNCTIONTREE_H
+#define JUNCTIONTREE_H
+
+#include <QString>
+#include <QVector>
+
+#include "factor.h"
+
+class NetworkSnapshot;
+
+/*
+ * Exact inference by Shafer-Shenoy propagation on junction tree. Network is
+ * compiled once: nodes are eliminated from moral graph (min-fill order) and
+ * clique formed by eliminating node `v' becomes clique `v'; its parent is
+ * clique of first eliminated node among its other nodes. Tables of nodes are
+ * multiplied into cliques and evidence of node `v' is applied to clique `v'.
+ *
+ * Messages are computed only when some marginal needs them and are kept
+ * until evidence they depend on changes: message to parent depends on
+ * evidence in subtree of clique, message from parent on evidence outside of
+ * it. Changing evidence of one node therefore costs only recomputation of
+ * messages on paths from its clique to cliques whose marginals are asked
+ * for.
+ *
+ * Copies share compiled structure (implicitly shared arrays), so each thread
+ * can cheaply have its own tree with own evidence. Compiled structure can be
+ * saved to file and loaded instead of compiling network again (see
+ * CompileCache); file is identified by key - hash of everything compilation
+ * depends on.
+ */
+class JunctionTree {
+
+public:
+    JunctionTree();
+    JunctionTree(const NetworkSnapshot &network);
+
+    int nodeCount() const;
+    int cardinality(int node) const;
+    int width() const;
+
+    int evidence(int node) const;
+    void setEvidence(int node, int value);
+    void clearEvidence();
+
+    QVector<double> marginal(int node);
+
+    static quint64 key(const NetworkSnapshot &network);
+    bool save(QString fileName, quint64 key) const;
+    bool load(QString fileName, quint64 key, const NetworkSnapshot &network);
+
+private:
+    void compile(const NetworkSnapshot &network);
+    bool matches(const NetworkSnapshot &network) const;
+    void reset();
+    Factor potential(int clique) const;
+    Factor upMessage(int clique);
+    Factor downMessage(int clique);
+
+    // Compiled structure (cliques are indexed by node they belong to)
+    QVector<int> cards;
+    QVector<int> order;
+    QVector<int> parent;
+    QVector<QVector<int> > children;
+    QVector<QVector<int> > separators;
+    QVector<Factor> base;
+
+    // Evidence and number of its changes (all and in subtree of clique)
+    QVector<int> evidences;
+    int changes;
+    QVector<int> subtreeChanges;
+
+    // Messages to parent (up) and from parent (down) with numbers of
+    // evidence changes they were computed for (-1 if they were not)
+    QVector<Factor> up;
+    QVector<Factor> down;
+    QVector<int> upChanges;
+    QVector<int> downChanges;
+};
+
+#endif // JUNCTIONTREE_H
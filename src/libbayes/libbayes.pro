@@ -0,0 +1,39 @@
+# Bayes network model, file reading and native inference with C interface
+# (build with CONFIG+=staticlib for static library)
+
+QT = core
+
+TARGET = bayes
+TEMPLATE = lib
+VERSION = 1.0.0
+
+DEFINES += BAYES_LIBRARY
+staticlib:DEFINES += BAYES_STATIC
+
+SOURCES += \
+    bayes.cpp \
+    network.cpp \
+    networksnapshot.cpp \
+    rowlayout.cpp \
+    node.cpp \
+    netfile.cpp \
+    netbfile.cpp \
+    savefile.cpp \
+    factor.cpp \
+    junctiontree.cpp \
+    compilecache.cpp \
+    monitor.cpp
+
+HEADERS += \
+    bayes.h \
+    network.h \
+    networksnapshot.h \
+    rowlayout.h \
+    node.h \
+    netfile.h \
+    netbfile.h \
+    savefile.h \
+    factor.h \
+    junctiontree.h \
+    compilecache.h \
+    monitor.h
@@ -0,0 +1,116 @@
+/*
+    Copyright (C) 2012 Ivan Radicek
+
+    This file is part of Bayes.
+
+    Bayes is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bayes is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Bayes.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "monitor.h"
+
+/*
+ * Creates monitor without network
+ */
+Monitor::Monitor() {
+    limit = 0.0;
+}
+
+/*
+ * Creates monitor of network compiled to `tree' (monitor has own copy)
+ */
+Monitor::Monitor(const JunctionTree &tree, double threshold) {
+    jt = tree;
+    limit = threshold;
+}
+
+/*
+ * Gets tree monitor works with
+ */
+JunctionTree& Monitor::tree() {
+    return jt;
+}
+
+/*
+ * Gets smallest change of posterior which is reported
+ */
+double Monitor::threshold() const {
+    return limit;
+}
+
+/*
+ * Sets smallest change of posterior which is reported
+ */
+void Monitor::setThreshold(double threshold) {
+    limit = threshold;
+}
+
+/*
+ * Starts watching node (its posterior is reported by next update)
+ */
+void Monitor::watch(int node) {
+    if ( !nodes.contains(node) ) {
+        nodes << node;
+    }
+}
+
+/*
+ * Gets watched nodes
+ */
+QVector<int> Monitor::watched() const {
+    return nodes;
+}
+
+/*
+ * Changes evidence of node (-1 removes it)
+ */
+void Monitor::setEvidence(int node, int value) {
+    jt.setEvidence(node, value);
+}
+
+/*
+ * Recomputes posteriors of watched nodes; returns those whose posterior has
+ * changed enough to be reported
+ */
+QVector<int> Monitor::update() {
+    QVector<int> changed;
+
+    foreach ( int n, nodes ) {
+        QVector<double> p = jt.marginal(n);
+
+        if ( reported.contains(n) ) {
+            const QVector<double> &last = reported[n];
+            double diff = 0.0;
+
+            for ( int i=0; i<p.size(); ++i ) {
+                diff = qMax(diff, qAbs(p.at(i) - last.at(i)));
+            }
+
+            if ( diff <= limit ) {
+                continue;
+            }
+        }
+
+        reported[n] = p;
+        changed << n;
+    }
+
+    return changed;
+}
+
+/*
+ * Gets last reported posterior of watched node
+ */
+QVector<double> Monitor::posterior(int node) const {
+    return reported.value(node);
+}
@@ -0,0 +1,60 @@
+/*
+    Copyright (C) 2012 Ivan Radicek
+
+    This file is part of Bayes.
+
+    Bayes is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bayes is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Bayes.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MONITOR_H
+#define MONITOR_H
+
+#include <QHash>
+#include <QVector>
+
+#include "junctiontree.h"
+
+/*
+ * Watching posteriors of few nodes while evidence keeps changing. Update
+ * recomputes only messages changed evidence has invalidated and reports
+ * watched nodes whose posterior moved by more than threshold (in any value)
+ * since it was last reported; first update reports all of them.
+ */
+class Monitor {
+
+public:
+    Monitor();
+    Monitor(const JunctionTree &tree, double threshold = 0.0);
+
+    JunctionTree& tree();
+
+    double threshold() const;
+    void setThreshold(double threshold);
+
+    void watch(int node);
+    QVector<int> watched() const;
+
+    void setEvidence(int node, int value);
+    QVector<int> update();
+    QVector<double> posterior(int node) const;
+
+private:
+    JunctionTree jt;
+    double limit;
+
+    QVector<int> nodes;
+    QHash<int, QVector<double> > reported;
+};
+
+#endif // MONITOR_H
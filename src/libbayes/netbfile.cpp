@@ -0,0 +1,690 @@
+/*
+    Copyright (C) 2012 Ivan Radicek
+
+    This file is part of Bayes.
+
+    Bayes is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bayes is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Bayes.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "netbfile.h"
+
+#include <QHash>
+
+#include <limits.h>
+#include <string.h>
+
+#include "netfile.h"
+#include "network.h"
+#include "savefile.h"
+
+// File starts with magic (8 bytes with terminating zero)
+static const char magic[8] = "BAYESNB";
+
+// Version of format this code reads and writes
+static const quint32 formatVersion = 1;
+
+// Written as number; reads differently on machine with other byte order
+static const quint32 byteOrderMark = 0x01020304;
+
+// Page size tables are aligned to
+static const quint64 pageSize = 4096;
+
+/*
+ * Text in strings section
+ */
+struct NetbString {
+    quint32 offset;
+    quint32 length;
+};
+
+/*
+ * Beginning of file
+ */
+struct NetbHeader {
+    char magic[8];
+    quint32 version;
+    quint32 byteOrder;
+    quint32 nodeCount;
+    quint32 valueCount;
+    quint32 parentCount;
+    quint32 metaCount;
+    NetbString name;
+
+    // Offsets of sections (size of strings section is given, others follow
+    // from counts)
+    quint64 nodes;
+    quint64 valueStart;
+    quint64 valueNames;
+    quint64 parentStart;
+    quint64 parentIds;
+    quint64 metaStart;
+    quint64 metaEntries;
+    quint64 strings;
+    quint64 stringsSize;
+    quint64 tables;
+    quint64 fileSize;
+};
+
+/*
+ * Entry of nodes section
+ */
+struct NetbNode {
+    NetbString name;
+    quint64 table;
+    quint64 tableSize;
+};
+
+/*
+ * Entry of meta section
+ */
+struct NetbMeta {
+    enum Type {
+        Null,
+        Bool,
+        Number,
+        String
+    };
+
+    NetbString key;
+    quint32 type;
+    quint32 reserved;
+    double number;
+    NetbString string;
+};
+
+/*
+ * Gets offset rounded up to multiple of `to'
+ */
+static quint64 align(quint64 offset, quint64 to) {
+    return (offset + to - 1) / to * to;
+}
+
+/*
+ * Creates closed file
+ */
+NetbFile::NetbFile() {
+    data = NULL;
+    size = 0;
+}
+
+/*
+ * Unmaps file
+ */
+NetbFile::~NetbFile() {
+    close();
+}
+
+/*
+ * Maps file to memory and checks it; on failure `error' describes problem
+ */
+bool NetbFile::open(QString fileName, QString &error) {
+    close();
+
+    file.setFileName(fileName);
+    if ( !file.open(QIODevice::ReadOnly) ) {
+        error = "Cannot open file " + fileName;
+        return false;
+    }
+
+    size = file.size();
+    data = size > 0 ? file.map(0, size) : NULL;
+    if ( data == NULL ) {
+        error = "Cannot map file " + fileName;
+        close();
+        return false;
+    }
+
+    if ( !check(error) ) {
+        error = fileName + ": " + error;
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+/*
+ * Unmaps and closes file (tables given by table() are no longer valid)
+ */
+void NetbFile::close() {
+    if ( data != NULL ) {
+        file.unmap((uchar*) data);
+    }
+    file.close();
+
+    data = NULL;
+    size = 0;
+}
+
+/*
+ * Checks if file is open
+ */
+bool NetbFile::isOpen() const {
+    return data != NULL;
+}
+
+/*
+ * Gets header of open file
+ */
+const NetbHeader* NetbFile::header() const {
+    return (const NetbHeader*) data;
+}
+
+/*
+ * Gets entry of node in nodes section
+ */
+const NetbNode& NetbFile::node(int id) const {
+    return ((const NetbNode*) (data + header()->nodes))[id];
+}
+
+/*
+ * Checks if `bytes' starting at `offset' are in file and offset is aligned
+ * for numbers
+ */
+bool NetbFile::fits(quint64 offset, quint64 bytes) const {
+    return offset % 8 == 0 && offset <= (quint64) size &&
+           bytes <= (quint64) size - offset;
+}
+
+/*
+ * Checks that sections are in file, their items refer to existing ones and
+ * network is valid (tables of right size, no cycles)
+ */
+bool NetbFile::check(QString &error) const {
+    const NetbHeader *h = header();
+
+    if ( (quint64) size < sizeof(NetbHeader) ||
+         memcmp(h->magic, magic, sizeof(magic)) != 0 ) {
+        error = "Not a binary network file";
+        return false;
+    }
+    if ( h->byteOrder != byteOrderMark ) {
+        error = "File written on machine with different byte order";
+        return false;
+    }
+    if ( h->version != formatVersion ) {
+        error = QString("Unsupported file version %1").arg(h->version);
+        return false;
+    }
+
+    quint64 n = h->nodeCount;
+    if ( h->fileSize != (quint64) size || n > INT_MAX ||
+         !fits(h->nodes, n * sizeof(NetbNode)) ||
+         !fits(h->valueStart, (n + 1) * sizeof(quint32)) ||
+         !fits(h->valueNames, h->valueCount * sizeof(NetbString)) ||
+         !fits(h->parentStart, (n + 1) * sizeof(quint32)) ||
+         !fits(h->parentIds, h->parentCount * sizeof(quint32)) ||
+         !fits(h->metaStart, (n + 1) * sizeof(quint32)) ||
+         !fits(h->metaEntries, h->metaCount * sizeof(NetbMeta)) ||
+         !fits(h->strings, h->stringsSize) || !fits(h->tables, 0) ) {
+        error = "File is truncated or damaged";
+        return false;
+    }
+
+    // Rows of CSR arrays
+    const quint32 *starts[3] = {
+        (const quint32*) (data + h->valueStart),
+        (const quint32*) (data + h->parentStart),
+        (const quint32*) (data + h->metaStart)
+    };
+    const quint32 counts[3] = {h->valueCount, h->parentCount, h->metaCount};
+
+    for ( int a=0; a<3; ++a ) {
+        bool ok = starts[a][0] == 0 && starts[a][n] == counts[a];
+        for ( quint64 i=0; i<n && ok; ++i ) {
+            ok = starts[a][i] <= starts[a][i+1];
+        }
+
+        if ( !ok ) {
+            error = "Invalid node data";
+            return false;
+        }
+    }
+
+    // Names
+    QVector<NetbString> names;
+    names << h->name;
+    for ( quint64 i=0; i<n; ++i ) {
+        names << node(i).name;
+    }
+    for ( quint32 i=0; i<h->valueCount; ++i ) {
+        names << ((const NetbString*) (data + h->valueNames))[i];
+    }
+    for ( quint32 i=0; i<h->metaCount; ++i ) {
+        const NetbMeta &m = ((const NetbMeta*) (data + h->metaEntries))[i];
+        names << m.key;
+        if ( m.type == NetbMeta::String ) {
+            names << m.string;
+        }
+    }
+
+    foreach ( const NetbString &s, names ) {
+        if ( (quint64) s.offset + s.length > h->stringsSize ) {
+            error = "Invalid string";
+            return false;
+        }
+    }
+
+    // Parents and tables (table has entry for every combination of values
+    // of node and its parents)
+    const quint32 *parentIds = (const quint32*) (data + h->parentIds);
+    QVector<int> waiting(n, 0);
+
+    for ( quint64 i=0; i<n; ++i ) {
+        quint64 entries = starts[0][i+1] - starts[0][i];
+
+        for ( quint32 j=starts[1][i]; j<starts[1][i+1]; ++j ) {
+            if ( parentIds[j] >= n ) {
+                error = "Invalid parent";
+                return false;
+            }
+            entries *= starts[0][parentIds[j]+1] - starts[0][parentIds[j]];
+            entries = qMin(entries, (quint64) INT_MAX + 1);
+            ++waiting[i];
+        }
+
+        const NetbNode &entry = node(i);
+        if ( entries < 2 || entry.tableSize != entries ||
+             entry.table < h->tables ||
+             !fits(entry.table, entry.tableSize * sizeof(double)) ) {
+            error = "Invalid table of node " + nodeName(i);
+            return false;
+        }
+    }
+
+    // Nodes without unordered parents are ordered until none is left
+    QVector<QVector<int> > children(n);
+    for ( quint64 i=0; i<n; ++i ) {
+        for ( quint32 j=starts[1][i]; j<starts[1][i+1]; ++j ) {
+            children[parentIds[j]] << i;
+        }
+    }
+
+    QList<int> ready;
+    for ( quint64 i=0; i<n; ++i ) {
+        if ( waiting.at(i) == 0 ) {
+            ready << i;
+        }
+    }
+
+    quint64 ordered = 0;
+    while ( !ready.isEmpty() ) {
+        int i = ready.takeFirst();
+        ++ordered;
+
+        foreach ( int c, children.at(i) ) {
+            if ( --waiting[c] == 0 ) {
+                ready << c;
+            }
+        }
+    }
+
+    if ( ordered < n ) {
+        error = "Network has cycle";
+        return false;
+    }
+
+    return true;
+}
+
+/*
+ * Gets string from strings section
+ */
+static QString text(const uchar *data, quint64 strings, NetbString s) {
+    return QString::fromUtf8((const char*) data + strings + s.offset,
+                             s.length);
+}
+
+/*
+ * Gets name of network
+ */
+QString NetbFile::name() const {
+    return text(data, header()->strings, header()->name);
+}
+
+/*
+ * Gets number of nodes
+ */
+int NetbFile::nodeCount() const {
+    return header()->nodeCount;
+}
+
+/*
+ * Gets name of node
+ */
+QString NetbFile::nodeName(int id) const {
+    return text(data, header()->strings, node(id).name);
+}
+
+/*
+ * Gets names of node values
+ */
+QStringList NetbFile::values(int id) const {
+    const NetbHeader *h = header();
+    const quint32 *start = (const quint32*) (data + h->valueStart);
+    const NetbString *names = (const NetbString*) (data + h->valueNames);
+
+    QStringList l;
+    for ( quint32 i=start[id]; i<start[id+1]; ++i ) {
+        l << text(data, h->strings, names[i]);
+    }
+
+    return l;
+}
+
+/*
+ * Gets ids of node parents
+ */
+QVector<int> NetbFile::parents(int id) const {
+    const NetbHeader *h = header();
+    const quint32 *start = (const quint32*) (data + h->parentStart);
+    const quint32 *ids = (const quint32*) (data + h->parentIds);
+
+    QVector<int> p;
+    for ( quint32 i=start[id]; i<start[id+1]; ++i ) {
+        p << ids[i];
+    }
+
+    return p;
+}
+
+/*
+ * Gets node meta data
+ */
+QVariantHash NetbFile::meta(int id) const {
+    const NetbHeader *h = header();
+    const quint32 *start = (const quint32*) (data + h->metaStart);
+    const NetbMeta *entries = (const NetbMeta*) (data + h->metaEntries);
+
+    QVariantHash meta;
+    for ( quint32 i=start[id]; i<start[id+1]; ++i ) {
+        const NetbMeta &m = entries[i];
+        QString key = text(data, h->strings, m.key);
+
+        switch ( m.type ) {
+            case NetbMeta::Bool:
+                meta[key] = m.number != 0.0;
+                break;
+
+            case NetbMeta::Number:
+                meta[key] = m.number;
+                break;
+
+            case NetbMeta::String:
+                meta[key] = text(data, h->strings, m.string);
+                break;
+
+            default:
+                meta[key] = QVariant();
+                break;
+        }
+    }
+
+    return meta;
+}
+
+/*
+ * Gets number of entries in node probability table
+ */
+int NetbFile::tableSize(int id) const {
+    return node(id).tableSize;
+}
+
+/*
+ * Gets node probability table (in mapped file, valid until it is closed)
+ */
+const double* NetbFile::table(int id) const {
+    return (const double*) (data + node(id).table);
+}
+
+/*
+ * Adds nodes of open file to `network'
+ */
+void NetbFile::read(Network *network) const {
+    int first = network->nodeCount();
+    QList<NodeData> data;
+
+    for ( int id=0; id<nodeCount(); ++id ) {
+        NodeData d;
+        d.name = nodeName(id);
+        d.values = values(id);
+        d.meta = meta(id);
+
+        foreach ( int p, parents(id) ) {
+            d.parents << first + p;
+        }
+
+        d.table.resize(tableSize(id));
+        memcpy(d.table.data(), table(id), tableSize(id) * sizeof(double));
+
+        data << d;
+    }
+
+    network->setName(name());
+    network->addNodes(data);
+}
+
+/*
+ * Checks if file starts as binary network file
+ */
+bool NetbFile::matches(QString fileName) {
+    QFile f(fileName);
+
+    return f.open(QIODevice::ReadOnly) &&
+           f.read(sizeof(magic)) == QByteArray(magic, sizeof(magic));
+}
+
+/*
+ * Reads network from file, adding its nodes to `network'; on failure network
+ * is left as it was and `error' describes problem
+ */
+bool NetbFile::read(QString fileName, Network *network, QString &error) {
+    NetbFile f;
+
+    if ( !f.open(fileName, error) ) {
+        return false;
+    }
+
+    f.read(network);
+
+    return true;
+}
+
+// WRITING /////////////////////////////////////////////////////////////////////
+
+/*
+ * Strings section being built (equal strings are stored once)
+ */
+class NetbStrings {
+
+public:
+    NetbString add(QString s);
+
+    QByteArray text;
+
+private:
+    QHash<QString, NetbString> refs;
+};
+
+/*
+ * Gets reference to string (it is added unless it is there already)
+ */
+NetbString NetbStrings::add(QString s) {
+    if ( !refs.contains(s) ) {
+        QByteArray utf8 = s.toUtf8();
+        NetbString r = {(quint32) text.size(), (quint32) utf8.size()};
+        refs[s] = r;
+        text += utf8;
+    }
+
+    return refs.value(s);
+}
+
+/*
+ * Appends raw bytes of items to section
+ */
+template <typename T>
+static void append(QByteArray &section, const QVector<T> &items) {
+    section.append((const char*) items.constData(), items.size() * sizeof(T));
+}
+
+/*
+ * Writes zeros up to `offset'
+ */
+static void pad(QFile &file, quint64 offset) {
+    quint64 n = offset - file.pos();
+    if ( n > 0 ) {
+        file.write(QByteArray(n, '\0'));
+    }
+}
+
+/*
+ * Writes network to file; tables are written straight from network. Network
+ * is checked first and file is replaced only when it is written whole; on
+ * failure `error' describes problem.
+ */
+bool NetbFile::write(QString fileName, const Network *network,
+                     QString &error) {
+    // Invalid network is not saved (and file it would replace is kept)
+    if ( !NetFile::check(network, error) ) {
+        return false;
+    }
+
+    int n = network->nodeCount();
+    NetbStrings strings;
+    NetbHeader h;
+    memset(&h, 0, sizeof(h));
+
+    memcpy(h.magic, magic, sizeof(magic));
+    h.version = formatVersion;
+    h.byteOrder = byteOrderMark;
+    h.nodeCount = n;
+    h.name = strings.add(network->name());
+
+    QVector<NetbNode> nodes(n);
+    QVector<quint32> valueStart, parentStart, metaStart;
+    QVector<NetbString> valueNames;
+    QVector<quint32> parentIds;
+    QVector<NetbMeta> metaEntries;
+
+    for ( int id=0; id<n; ++id ) {
+        nodes[id].name = strings.add(network->nodeName(id));
+        nodes[id].tableSize = network->tableSize(id);
+
+        valueStart << valueNames.size();
+        foreach ( QString v, network->values(id) ) {
+            valueNames << strings.add(v);
+        }
+
+        parentStart << parentIds.size();
+        foreach ( int p, network->parents(id) ) {
+            parentIds << p;
+        }
+
+        metaStart << metaEntries.size();
+        QVariantHash meta = network->meta(id);
+        QStringList keys = meta.keys();
+        keys.sort();
+        foreach ( QString key, keys ) {
+            QVariant v = meta[key];
+            NetbMeta m;
+            memset(&m, 0, sizeof(m));
+            m.key = strings.add(key);
+
+            if ( v.isNull() ) {
+                m.type = NetbMeta::Null;
+            } else if ( v.type() == QVariant::Bool ) {
+                m.type = NetbMeta::Bool;
+                m.number = v.toBool() ? 1.0 : 0.0;
+            } else if ( v.type() == QVariant::Double ||
+                        v.type() == QVariant::Int ||
+                        v.type() == QVariant::LongLong ) {
+                m.type = NetbMeta::Number;
+                m.number = v.toDouble();
+            } else {
+                m.type = NetbMeta::String;
+                m.string = strings.add(v.toString());
+            }
+            metaEntries << m;
+        }
+    }
+    valueStart << valueNames.size();
+    parentStart << parentIds.size();
+    metaStart << metaEntries.size();
+
+    h.valueCount = valueNames.size();
+    h.parentCount = parentIds.size();
+    h.metaCount = metaEntries.size();
+
+    // Layout of sections
+    quint64 offset = sizeof(NetbHeader);
+    QList<QByteArray> sections;
+    QList<quint64*> offsets;
+    offsets << &h.nodes << &h.valueStart << &h.valueNames << &h.parentStart
+            << &h.parentIds << &h.metaStart << &h.metaEntries << &h.strings;
+
+    for ( int i=0; i<offsets.size(); ++i ) {
+        sections << QByteArray();
+    }
+    append(sections[1], valueStart);
+    append(sections[2], valueNames);
+    append(sections[3], parentStart);
+    append(sections[4], parentIds);
+    append(sections[5], metaStart);
+    append(sections[6], metaEntries);
+    sections[7] = strings.text;
+    h.stringsSize = strings.text.size();
+
+    // Nodes section needs offsets of tables, it is filled last
+    sections[0].resize(n * sizeof(NetbNode));
+
+    for ( int i=0; i<offsets.size(); ++i ) {
+        offset = align(offset, 8);
+        *offsets[i] = offset;
+        offset += sections.at(i).size();
+    }
+
+    h.tables = offset = align(offset, pageSize);
+    for ( int id=0; id<n; ++id ) {
+        quint64 bytes = nodes.at(id).tableSize * sizeof(double);
+        offset = align(offset, bytes >= pageSize ? pageSize : 8);
+        nodes[id].table = offset;
+        offset += bytes;
+    }
+    h.fileSize = offset;
+
+    sections[0] = QByteArray();
+    append(sections[0], nodes);
+
+    // Writing
+    SaveFile file(fileName);
+    if ( !file.open(error) ) {
+        return false;
+    }
+
+    file.write((const char*) &h, sizeof(h));
+    for ( int i=0; i<sections.size(); ++i ) {
+        pad(file, *offsets[i]);
+        file.write(sections.at(i));
+    }
+
+    for ( int id=0; id<n; ++id ) {
+        pad(file, nodes.at(id).table);
+        file.write((const char*) network->table(id),
+                   nodes.at(id).tableSize * sizeof(double));
+    }
+    pad(file, h.fileSize);
+
+    return file.commit(error);
+}
@@ -0,0 +1,91 @@
+/*
+    Copyright (C) 2012 Ivan Radicek
+
+    This file is part of Bayes.
+
+    Bayes is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bayes is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Bayes.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef NETBFILE_H
+#define NETBFILE_H
+
+#include <QFile>
+#include <QStringList>
+#include <QVariantHash>
+#include <QVector>
+
+class Network;
+struct NetbHeader;
+struct NetbNode;
+
+/*
+ * Binary network file (.netb), made to be mapped to memory: probability
+ * tables are used in place and nothing is parsed. Numbers are in byte order
+ * of machine which wrote file (header records it) and sections follow each
+ * other in this order:
+ *
+ *   header   magic "BAYESNB", format version, byte order mark, counts of
+ *            items and offsets of sections
+ *   nodes    name and table (offset in file, number of entries) of each node
+ *   values   start of values of each node (node count + 1 entries, values of
+ *            node i span [start[i], start[i+1]) of value names) and names
+ *   parents  CSR adjacency like values - starts and parent ids
+ *   meta     meta data entries (key, type, number or string) like values
+ *   strings  UTF-8 text of all names (shared by equal ones); names are given
+ *            by offset and length in it
+ *   tables   probability tables (doubles); section starts on page boundary
+ *            and so does every table of at least page size
+ *
+ * Opening file checks structure of network (sizes, parents and cycles) but
+ * not values of probabilities, so it takes time of network size, not size of
+ * its tables.
+ */
+class NetbFile {
+
+public:
+    NetbFile();
+    ~NetbFile();
+
+    bool open(QString fileName, QString &error);
+    void close();
+    bool isOpen() const;
+
+    QString name() const;
+    int nodeCount() const;
+    QString nodeName(int id) const;
+    QStringList values(int id) const;
+    QVector<int> parents(int id) const;
+    QVariantHash meta(int id) const;
+    int tableSize(int id) const;
+    const double* table(int id) const;
+
+    void read(Network *network) const;
+
+    static bool matches(QString fileName);
+    static bool read(QString fileName, Network *network, QString &error);
+    static bool write(QString fileName, const Network *network,
+                      QString &error);
+
+private:
+    bool check(QString &error) const;
+    bool fits(quint64 offset, quint64 bytes) const;
+    const NetbHeader* header() const;
+    const NetbNode& node(int id) const;
+
+    QFile file;
+    const uchar *data;
+    qint64 size;
+};
+
+#endif // NETBFILE_H
@@ -0,0 +1,882 @@
+/*
+    Copyright (C) 2012 Ivan Radicek
+
+    This file is part of Bayes.
+
+    Bayes is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bayes is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Bayes.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "netfile.h"
+
+#include <QFile>
+#include <QHash>
+#include <QStringList>
+#include <QThread>
+#include <QVariantHash>
+
+#include <ctype.h>
+
+#include "netbfile.h"
+#include "network.h"
+#include "savefile.h"
+
+// Allowed difference of table row sum from one
+static const double sumError = 0.0001;
+
+// Files with at least this many probabilities are parsed by several threads
+static const int parallelNumbers = 1 << 16;
+
+/*
+ * Piece of file text (strings include their quotes)
+ */
+struct Token {
+    const char *text;
+    int length;
+};
+
+/*
+ * Node as it is written in file; its probabilities are range of all
+ * probabilities in file until they are parsed
+ */
+struct FileNode {
+    QString name;
+    QStringList values;
+    QStringList parents;
+    int tableStart;
+    int tableSize;
+    QVector<double> table;
+    QVariantHash meta;
+};
+
+// TOKENIZER ///////////////////////////////////////////////////////////////////
+
+/*
+ * Splits file text to tokens one at a time (lists are not built, reader
+ * follows them as they come)
+ */
+class Tokenizer {
+
+public:
+    enum Type {
+        Open,
+        Close,
+        Atom,
+        String,
+        End,
+        Invalid
+    };
+
+    Tokenizer(const char *data, qint64 size);
+
+    Type next();
+    Type type() const;
+    Token token() const;
+    QString text() const;
+    bool isSymbol(const char *name) const;
+    int line() const;
+
+private:
+    const char *pos;
+    const char *end;
+    Type current;
+    Token tok;
+    int lines;
+};
+
+/*
+ * Creates tokenizer of text
+ */
+Tokenizer::Tokenizer(const char *data, qint64 size) {
+    pos = data;
+    end = data + size;
+    current = End;
+    tok.text = data;
+    tok.length = 0;
+    lines = 1;
+}
+
+/*
+ * Reads next token; returns its type
+ */
+Tokenizer::Type Tokenizer::next() {
+
+    // Whitespace and comments
+    while ( pos < end ) {
+        if ( *pos == ';' ) {
+            while ( pos < end && *pos != '\n' ) {
+                ++pos;
+            }
+        } else if ( isspace((unsigned char) *pos) ) {
+            lines += *pos == '\n';
+            ++pos;
+        } else {
+            break;
+        }
+    }
+
+    tok.text = pos;
+    tok.length = 0;
+
+    if ( pos == end ) {
+        return current = End;
+    }
+
+    if ( *pos == '(' || *pos == ')' ) {
+        current = *pos == '(' ? Open : Close;
+        tok.length = 1;
+        ++pos;
+        return current;
+    }
+
+    if ( *pos == '"' ) {
+        for ( ++pos; pos < end && *pos != '"'; ++pos ) {
+            if ( *pos == '\\' && pos + 1 < end ) {
+                ++pos;
+            }
+            lines += *pos == '\n';
+        }
+
+        if ( pos == end ) {
+            return current = Invalid;
+        }
+
+        ++pos;
+        tok.length = pos - tok.text;
+        return current = String;
+    }
+
+    while ( pos < end && !isspace((unsigned char) *pos) && *pos != '(' &&
+            *pos != ')' && *pos != '"' && *pos != ';' ) {
+        ++pos;
+    }
+    tok.length = pos - tok.text;
+
+    return current = Atom;
+}
+
+/*
+ * Gets type of last token
+ */
+Tokenizer::Type Tokenizer::type() const {
+    return current;
+}
+
+/*
+ * Gets text of last token as it is in file
+ */
+Token Tokenizer::token() const {
+    return tok;
+}
+
+/*
+ * Gets text of last atom or string (strings are unescaped)
+ */
+QString Tokenizer::text() const {
+    if ( current == Atom ) {
+        return QString::fromUtf8(tok.text, tok.length);
+    }
+
+    if ( current != String ) {
+        return QString();
+    }
+
+    QByteArray r;
+    for ( int i=1; i<tok.length-1; ++i ) {
+        if ( tok.text[i] == '\\' && i+1 < tok.length-1 ) {
+            ++i;
+        }
+        r += tok.text[i];
+    }
+
+    return QString::fromUtf8(r);
+}
+
+/*
+ * Checks if last token is symbol named `name' (in any case)
+ */
+bool Tokenizer::isSymbol(const char *name) const {
+    return current == Atom && qstrlen(name) == (uint) tok.length &&
+           qstrnicmp(tok.text, name, tok.length) == 0;
+}
+
+/*
+ * Gets line of last token
+ */
+int Tokenizer::line() const {
+    return lines;
+}
+
+// READING /////////////////////////////////////////////////////////////////////
+
+/*
+ * Parses Lisp number (exponent markers and ratios are allowed)
+ */
+static bool number(QByteArray s, double &d) {
+    bool ok;
+
+    int slash = s.indexOf('/');
+    if ( slash > 0 ) {
+        double denominator = s.mid(slash + 1).toDouble(&ok);
+        if ( !ok || denominator == 0.0 ) {
+            return false;
+        }
+        d = s.left(slash).toDouble(&ok) / denominator;
+        return ok;
+    }
+
+    s = s.toLower();
+    s.replace('d', 'e').replace('f', 'e').replace('s', 'e').replace('l', 'e');
+    d = s.toDouble(&ok);
+
+    return ok;
+}
+
+/*
+ * Skips value tokenizer is at (atom or whole list)
+ */
+static bool skipValue(Tokenizer &t) {
+    int depth = 0;
+
+    do {
+        if ( t.type() == Tokenizer::Open ) {
+            ++depth;
+        } else if ( t.type() == Tokenizer::Close ) {
+            --depth;
+        } else if ( t.type() != Tokenizer::Atom &&
+                    t.type() != Tokenizer::String ) {
+            return false;
+        }
+    } while ( depth > 0 && t.next() != Tokenizer::End );
+
+    return depth == 0;
+}
+
+/*
+ * Reads list of atoms tokenizer is at (NIL is empty list)
+ */
+static bool readAtoms(Tokenizer &t, QStringList &atoms) {
+    if ( t.isSymbol("nil") ) {
+        return true;
+    }
+
+    if ( t.type() != Tokenizer::Open ) {
+        return false;
+    }
+
+    while ( t.next() == Tokenizer::Atom || t.type() == Tokenizer::String ) {
+        atoms << t.text();
+    }
+
+    return t.type() == Tokenizer::Close;
+}
+
+/*
+ * Reads list of probabilities tokenizer is at; they are only collected in
+ * `numbers' to be parsed later
+ */
+static bool readTable(Tokenizer &t, QVector<Token> &numbers) {
+    if ( t.isSymbol("nil") ) {
+        return true;
+    }
+
+    if ( t.type() != Tokenizer::Open ) {
+        return false;
+    }
+
+    while ( t.next() == Tokenizer::Atom ) {
+        numbers << t.token();
+    }
+
+    return t.type() == Tokenizer::Close;
+}
+
+/*
+ * Reads property list of node meta data tokenizer is at; keys are kept
+ * without colon (":X" is "x"), T is read as true and NIL as null value
+ */
+static bool readMeta(Tokenizer &t, QVariantHash &meta) {
+    if ( t.isSymbol("nil") ) {
+        return true;
+    }
+
+    if ( t.type() != Tokenizer::Open ) {
+        return false;
+    }
+
+    while ( t.next() == Tokenizer::Atom || t.type() == Tokenizer::String ) {
+        QString key = t.text().toLower();
+        if ( key.startsWith(':') ) {
+            key = key.mid(1);
+        }
+
+        double d;
+        Tokenizer::Type type = t.next();
+        Token value = t.token();
+
+        if ( type == Tokenizer::Atom && t.isSymbol("t") ) {
+            meta[key] = true;
+        } else if ( type == Tokenizer::Atom && t.isSymbol("nil") ) {
+            meta[key] = QVariant();
+        } else if ( type == Tokenizer::Atom &&
+                    number(QByteArray(value.text, value.length), d) ) {
+            meta[key] = d;
+        } else if ( type == Tokenizer::Atom || type == Tokenizer::String ) {
+            meta[key] = t.text();
+        } else if ( !skipValue(t) ) {
+            return false;
+        }
+    }
+
+    return t.type() == Tokenizer::Close;
+}
+
+/*
+ * Reads options of NETWORK expression (up to its end)
+ */
+static bool readNetwork(Tokenizer &t, QString &name) {
+    while ( t.next() == Tokenizer::Atom ) {
+        bool isName = t.isSymbol(":name");
+        t.next();
+
+        if ( isName && (t.type() == Tokenizer::Atom ||
+                        t.type() == Tokenizer::String) ) {
+            name = t.text();
+        } else if ( isName || !skipValue(t) ) {
+            return false;
+        }
+    }
+
+    return t.type() == Tokenizer::Close;
+}
+
+/*
+ * Reads options of NODE expression (up to its end); probabilities are
+ * collected in `numbers'
+ */
+static bool readNode(Tokenizer &t, FileNode &node, QVector<Token> &numbers) {
+    node.tableStart = numbers.size();
+    node.tableSize = 0;
+
+    while ( t.next() == Tokenizer::Atom ) {
+        QByteArray key = QByteArray(t.token().text, t.token().length);
+        key = key.toLower();
+        t.next();
+
+        bool ok;
+        if ( key == ":name" ) {
+            node.name = t.text();
+            ok = t.type() == Tokenizer::Atom || t.type() == Tokenizer::String;
+
+        } else if ( key == ":vals" ) {
+            ok = readAtoms(t, node.values);
+
+        } else if ( key == ":parents" ) {
+            ok = readAtoms(t, node.parents);
+
+        } else if ( key == ":table" ) {
+            node.tableStart = numbers.size();
+            ok = readTable(t, numbers);
+            node.tableSize = numbers.size() - node.tableStart;
+
+        } else if ( key == ":meta" ) {
+            ok = readMeta(t, node.meta);
+
+        } else {
+            ok = skipValue(t);
+        }
+
+        if ( !ok ) {
+            return false;
+        }
+    }
+
+    return t.type() == Tokenizer::Close;
+}
+
+/*
+ * Parses range of collected probabilities in its own thread
+ */
+class NumberParser : public QThread {
+
+public:
+    NumberParser(const Token *tokens, double *numbers, int count);
+
+    void parse();
+    int invalid() const;
+
+protected:
+    void run();
+
+private:
+    const Token *tokens;
+    double *numbers;
+    int count;
+    int firstInvalid;
+};
+
+/*
+ * Creates parser of `count' tokens writing numbers to `numbers'
+ */
+NumberParser::NumberParser(const Token *tokens, double *numbers, int count) {
+    this->tokens = tokens;
+    this->numbers = numbers;
+    this->count = count;
+    firstInvalid = -1;
+}
+
+/*
+ * Parses numbers (in calling thread)
+ */
+void NumberParser::parse() {
+    for ( int i=0; i<count; ++i ) {
+        QByteArray s = QByteArray::fromRawData(tokens[i].text,
+                                               tokens[i].length);
+        if ( !number(s, numbers[i]) ) {
+            firstInvalid = i;
+            return;
+        }
+    }
+}
+
+/*
+ * Gets index (in range) of first token which is not number (-1 if there is
+ * none)
+ */
+int NumberParser::invalid() const {
+    return firstInvalid;
+}
+
+/*
+ * Parses numbers in parser thread
+ */
+void NumberParser::run() {
+    parse();
+}
+
+/*
+ * Parses all collected probabilities (split between threads when there is
+ * enough of them); returns index of first invalid one or -1
+ */
+static int parseNumbers(const QVector<Token> &tokens,
+                        QVector<double> &numbers) {
+    numbers.resize(tokens.size());
+    if ( tokens.isEmpty() ) {
+        return -1;
+    }
+
+    int threads = 1;
+    if ( tokens.size() >= parallelNumbers ) {
+        threads = qMax(1, QThread::idealThreadCount());
+    }
+    int chunk = (tokens.size() + threads - 1) / threads;
+
+    QList<NumberParser*> parsers;
+    for ( int from=0; from<tokens.size(); from+=chunk ) {
+        parsers << new NumberParser(tokens.constData() + from,
+                                    numbers.data() + from,
+                                    qMin(chunk, tokens.size() - from));
+    }
+
+    // Last range is parsed by this thread
+    for ( int i=0; i<parsers.size()-1; ++i ) {
+        parsers.at(i)->start();
+    }
+    parsers.last()->parse();
+
+    int invalid = -1;
+    for ( int i=0; i<parsers.size(); ++i ) {
+        parsers.at(i)->wait();
+        if ( invalid < 0 && parsers.at(i)->invalid() >= 0 ) {
+            invalid = i * chunk + parsers.at(i)->invalid();
+        }
+    }
+    qDeleteAll(parsers);
+
+    return invalid;
+}
+
+/*
+ * Checks nodes of network; `ids' maps node names to their indexes
+ */
+static bool check(const QList<FileNode> &nodes, QHash<QString, int> &ids,
+                  QString &error) {
+    for ( int i=0; i<nodes.length(); ++i ) {
+        const FileNode &n = nodes.at(i);
+
+        if ( ids.contains(n.name) ) {
+            error = "Duplicate node name: " + n.name;
+            return false;
+        }
+        ids[n.name] = i;
+
+        if ( n.values.length() < 2 ) {
+            error = "Less than two values in node " + n.name;
+            return false;
+        }
+
+        if ( n.values.toSet().size() != n.values.length() ) {
+            error = "Duplicate values in node " + n.name;
+            return false;
+        }
+    }
+
+    // Number of parents not yet ordered, by node
+    QVector<int> waiting(nodes.length(), 0);
+    QVector<QVector<int> > children(nodes.length());
+
+    for ( int i=0; i<nodes.length(); ++i ) {
+        const FileNode &n = nodes.at(i);
+        int size = n.values.length();
+
+        foreach ( QString p, n.parents ) {
+            if ( !ids.contains(p) ) {
+                error = "Parent node " + p + " does not exist";
+                return false;
+            }
+            size *= nodes.at(ids[p]).values.length();
+            children[ids[p]] << i;
+            ++waiting[i];
+        }
+
+        if ( n.table.size() != size ) {
+            error = "Invalid table size for node " + n.name;
+            return false;
+        }
+
+        int step = n.values.length();
+        for ( int r=0; r<size; r+=step ) {
+            double sum = 0.0;
+            for ( int j=r; j<r+step; ++j ) {
+                sum += n.table.at(j);
+            }
+
+            if ( qAbs(sum - 1.0) > sumError ) {
+                error = QString("Invalid table sum for rows from %1 to %2 "
+                                "(%3) in node %4")
+                        .arg(r + 1).arg(r + step).arg(sum).arg(n.name);
+                return false;
+            }
+        }
+    }
+
+    // Nodes without unordered parents are ordered until none is left
+    QList<int> ready;
+    for ( int i=0; i<nodes.length(); ++i ) {
+        if ( waiting.at(i) == 0 ) {
+            ready << i;
+        }
+    }
+
+    int ordered = 0;
+    while ( !ready.isEmpty() ) {
+        int i = ready.takeFirst();
+        ++ordered;
+
+        foreach ( int c, children.at(i) ) {
+            if ( --waiting[c] == 0 ) {
+                ready << c;
+            }
+        }
+    }
+
+    if ( ordered < nodes.length() ) {
+        error = "Network has cycle";
+        return false;
+    }
+
+    return true;
+}
+
+/*
+ * Checks network the same way files are checked when they are read (so only
+ * networks which can be read back are written)
+ */
+bool NetFile::check(const Network *network, QString &error) {
+    QList<FileNode> nodes;
+
+    for ( int id=0; id<network->nodeCount(); ++id ) {
+        FileNode n;
+        n.name = network->nodeName(id);
+        n.values = network->values(id);
+        foreach ( int p, network->parents(id) ) {
+            n.parents << network->nodeName(p);
+        }
+        n.tableStart = 0;
+        n.tableSize = network->tableSize(id);
+        n.table = QVector<double>(n.tableSize);
+        qCopy(network->table(id), network->table(id) + n.tableSize,
+              n.table.begin());
+        nodes << n;
+    }
+
+    QHash<QString, int> ids;
+    return ::check(nodes, ids, error);
+}
+
+/*
+ * Reads network from .net text of `size' bytes (`source' names it in error
+ * messages)
+ */
+static bool parse(const char *text, qint64 size, QString source,
+                  Network *network, QString &error) {
+    QString name;
+    QList<FileNode> nodes;
+    QVector<Token> numbers;
+
+    Tokenizer t(text, size);
+    bool ok = t.next() == Tokenizer::Open;
+
+    while ( ok && t.next() == Tokenizer::Open ) {
+        t.next();
+
+        if ( t.isSymbol("network") ) {
+            ok = readNetwork(t, name);
+
+        } else if ( t.isSymbol("node") ) {
+            FileNode n;
+            ok = readNode(t, n, numbers);
+            nodes << n;
+
+        } else {
+            error = "Unknown command " + t.text();
+            return false;
+        }
+    }
+
+    if ( !ok || t.type() != Tokenizer::Close ) {
+        error = QString("Invalid network %1 (line %2)")
+                .arg(source).arg(t.line());
+        return false;
+    }
+
+    // Probabilities
+    QVector<double> probabilities;
+    int invalid = parseNumbers(numbers, probabilities);
+
+    for ( int i=0; i<nodes.length(); ++i ) {
+        FileNode &n = nodes[i];
+
+        if ( n.name.isEmpty() ) {
+            error = "Node without name";
+            return false;
+        }
+
+        if ( invalid >= n.tableStart &&
+             invalid < n.tableStart + n.tableSize ) {
+            error = QString("Invalid probability %1 in node %2")
+                    .arg(QString::fromUtf8(numbers.at(invalid).text,
+                                           numbers.at(invalid).length))
+                    .arg(n.name);
+            return false;
+        }
+
+        n.table = probabilities.mid(n.tableStart, n.tableSize);
+    }
+
+    QHash<QString, int> ids;
+    if ( !check(nodes, ids, error) ) {
+        return false;
+    }
+
+    // Parents can come after their children in file
+    int first = network->nodeCount();
+    QList<NodeData> data;
+    foreach ( const FileNode &n, nodes ) {
+        NodeData d;
+        d.name = n.name;
+        d.values = n.values;
+        d.table = n.table;
+        d.meta = n.meta;
+        foreach ( QString p, n.parents ) {
+            d.parents << first + ids[p];
+        }
+        data << d;
+    }
+
+    network->setName(name);
+    network->addNodes(data);
+
+    return true;
+}
+
+/*
+ * Reads network from file, adding its nodes to `network'; on failure network
+ * is left as it was and `error' describes problem
+ */
+bool NetFile::read(QString fileName, Network *network, QString &error) {
+    if ( NetbFile::matches(fileName) ) {
+        return NetbFile::read(fileName, network, error);
+    }
+
+    QFile file(fileName);
+    if ( !file.open(QIODevice::ReadOnly) ) {
+        error = "Cannot open file " + fileName;
+        return false;
+    }
+
+    // File is mapped to memory when possible (tokens point to its text until
+    // numbers are parsed)
+    QByteArray data;
+    qint64 size = file.size();
+    const char *text = size > 0 ? (const char*) file.map(0, size) : NULL;
+    if ( text == NULL ) {
+        data = file.readAll();
+        text = data.constData();
+        size = data.size();
+    }
+
+    return parse(text, size, "file " + fileName, network, error);
+}
+
+/*
+ * Reads network from .net text in memory (network engine prints is passed
+ * this way, without temporary file)
+ */
+bool NetFile::readData(QByteArray data, Network *network, QString &error) {
+    return parse(data.constData(), data.size(), "data", network, error);
+}
+
+// WRITING /////////////////////////////////////////////////////////////////////
+
+/*
+ * Gets string quoted for file
+ */
+static QByteArray quote(QString s) {
+    QByteArray r = "\"";
+
+    foreach ( char c, s.toUtf8() ) {
+        if ( c == '"' || c == '\\' ) {
+            r += '\\';
+        }
+        r += c;
+    }
+
+    return r + "\"";
+}
+
+/*
+ * Gets number as it is written in file (shortest of two forms which reads
+ * back as the same number)
+ */
+static QByteArray formatNumber(double d) {
+    QByteArray s = QByteArray::number(d, 'g', 15);
+
+    if ( s.toDouble() != d ) {
+        s = QByteArray::number(d, 'g', 17);
+    }
+
+    return s;
+}
+
+/*
+ * Gets list of items (NIL if there are none)
+ */
+static QByteArray list(const QList<QByteArray> &items) {
+    if ( items.isEmpty() ) {
+        return "NIL";
+    }
+
+    QByteArray r = "(";
+    for ( int i=0; i<items.size(); ++i ) {
+        if ( i > 0 ) {
+            r += ' ';
+        }
+        r += items.at(i);
+    }
+
+    return r + ")";
+}
+
+/*
+ * Gets meta data value as it is written in file
+ */
+static QByteArray metaValue(QVariant v) {
+    if ( v.isNull() ) {
+        return "NIL";
+    }
+
+    switch ( v.type() ) {
+        case QVariant::Bool:
+            return v.toBool() ? "T" : "NIL";
+
+        case QVariant::Int:
+        case QVariant::LongLong:
+        case QVariant::Double:
+            return formatNumber(v.toDouble());
+
+        default:
+            return quote(v.toString());
+    }
+}
+
+/*
+ * Writes network to file in format engine writes it (nodes are written one
+ * by one as they are formatted) or in binary format if file name ends with
+ * .netb. Network is checked first and file is replaced only when it is
+ * written whole; on failure `error' describes problem.
+ */
+bool NetFile::write(QString fileName, const Network *network,
+                    QString &error) {
+    if ( fileName.endsWith(".netb", Qt::CaseInsensitive) ) {
+        return NetbFile::write(fileName, network, error);
+    }
+
+    // Invalid network is not saved (and file it would replace is kept)
+    if ( !check(network, error) ) {
+        return false;
+    }
+
+    SaveFile file(fileName);
+    if ( !file.open(error) ) {
+        return false;
+    }
+
+    file.write("((NETWORK :NAME " + quote(network->name()) + ")");
+
+    for ( int id=0; id<network->nodeCount(); ++id ) {
+        QList<QByteArray> values;
+        foreach ( QString v, network->values(id) ) {
+            values << quote(v);
+        }
+
+        QList<QByteArray> parents;
+        foreach ( int p, network->parents(id) ) {
+            parents << quote(network->nodeName(p));
+        }
+
+        QList<QByteArray> table;
+        const double *t = network->table(id);
+        for ( int i=0; i<network->tableSize(id); ++i ) {
+            table << formatNumber(t[i]);
+        }
+
+        QList<QByteArray> meta;
+        QVariantHash m = network->meta(id);
+        QStringList keys = m.keys();
+        keys.sort();
+        foreach ( QString key, keys ) {
+            meta << ":" + key.toUpper().toUtf8() << metaValue(m[key]);
+        }
+
+        file.write("\n (NODE :NAME " + quote(network->nodeName(id)) +
+                   " :VALS " + list(values) +
+                   " :PARENTS " + list(parents) +
+                   "\n  :TABLE " + list(table) +
+                   " :META " + list(meta) + ")");
+    }
+
+    file.write(")\n");
+
+    return file.commit(error);
+}
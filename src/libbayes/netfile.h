@@ -0,0 +1,48 @@
+/*
+    Copyright (C) 2012 Ivan Radicek
+
+    This file is part of Bayes.
+
+    Bayes is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bayes is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Bayes.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef NETFILE_H
+#define NETFILE_H
+
+#include <QString>
+#include <QByteArray>
+
+class Network;
+
+/*
+ * Reading and writing of networks in .net files (S-expression format engine
+ * reads and writes). File is read in one pass without building expression
+ * tree; probabilities of huge tables are parsed in parallel. Network is
+ * checked the same way engine checks it - node names and values are unique,
+ * parents exist and there are no cycles, tables have right sizes and their
+ * rows sum to one. Binary files (see NetbFile) are read as well and files
+ * named *.netb are written in binary format. Text can also be read from
+ * memory (readData()).
+ */
+class NetFile {
+
+public:
+    static bool read(QString fileName, Network *network, QString &error);
+    static bool readData(QByteArray data, Network *network, QString &error);
+    static bool write(QString fileName, const Network *network,
+                      QString &error);
+    static bool check(const Network *network, QString &error);
+};
+
+#endif // NETFILE_H
@@ -0,0 +1,606 @@
+/*
+    Copyright (C) 2012 Ivan Radicek
+
+    This file is part of Bayes.
+
+    Bayes is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bayes is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Bayes.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "network.h"
+
+#include "node.h"
+
+// FNV-1a (64 bit) hash offset
+static const quint64 fnvOffset = 14695981039346656037ULL;
+
+// Number of kinds of node changes (Node::Change flags)
+static const int changeKinds = 5;
+
+/*
+ * Replaces items of `row' in `arena' with `items'
+ */
+template <typename T>
+static void setRow(QVector<T> &arena, RowLayout &rows, int row,
+                   const QVector<T> &items) {
+    int count = rows.count(row);
+    int from = rows.resizeRow(row, items.size());
+    rows.moveRow(arena, row, from, count);
+
+    qCopy(items.constBegin(), items.constEnd(),
+          arena.begin() + rows.start(row));
+}
+
+/*
+ * Inserts item to `row' in `arena' at position `index' within row (-1 or
+ * index past row appends it); `from' is start of row before it was resized
+ */
+template <typename T>
+static void insertInRow(QVector<T> &arena, const RowLayout &rows, int row,
+                        int from, int index, const T &item) {
+    int count = rows.count(row) - 1;
+    if ( index < 0 || index > count ) {
+        index = count;
+    }
+
+    rows.moveRow(arena, row, from, count);
+
+    int start = rows.start(row);
+    for ( int i=count; i>index; --i ) {
+        arena[start + i] = arena.at(start + i - 1);
+    }
+    arena[start + index] = item;
+}
+
+/*
+ * Removes item at position `index' within `row' from `arena' (row has
+ * already been shrunk by one item)
+ */
+template <typename T>
+static void removeFromRow(QVector<T> &arena, const RowLayout &rows, int row,
+                          int index) {
+    int start = rows.start(row);
+    for ( int i=index; i<rows.count(row); ++i ) {
+        arena[start + i] = arena.at(start + i + 1);
+    }
+}
+
+/*
+ * Packs `arena' placed by `rows' if too much of it is unused
+ */
+template <typename T>
+static void packRows(RowLayout &rows, QVector<T> &arena) {
+    if ( rows.isSparse() ) {
+        RowLayout packed = rows.packed();
+        arena = rows.pack(arena, packed);
+        rows = packed;
+    }
+}
+
+/*
+ * Packs two arenas sharing `rows' if too much of them is unused
+ */
+template <typename T, typename U>
+static void packRows(RowLayout &rows, QVector<T> &arena1,
+                     QVector<U> &arena2) {
+    if ( rows.isSparse() ) {
+        RowLayout packed = rows.packed();
+        arena1 = rows.pack(arena1, packed);
+        arena2 = rows.pack(arena2, packed);
+        rows = packed;
+    }
+}
+
+/*
+ * Finds position of `item' within `row' of `arena' (-1 if it is not there)
+ */
+template <typename T>
+static int indexInRow(const QVector<T> &arena, const RowLayout &rows,
+                      int row, const T &item) {
+    for ( int i=0; i<rows.count(row); ++i ) {
+        if ( arena.at(rows.start(row) + i) == item ) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+/*
+ * Creates empty network
+ */
+Network::Network(QObject *parent) : QObject(parent) {
+    netName = tr("Untitled network");
+    ver = 0;
+    rev = 0;
+}
+
+/*
+ * Gets network name
+ */
+QString Network::name() const {
+    return netName;
+}
+
+/*
+ * Sets network name
+ */
+void Network::setName(QString name) {
+    netName = name;
+}
+
+// NODES ///////////////////////////////////////////////////////////////////////
+
+/*
+ * Adds node without values, parents and table; returns its view (owned by
+ * network)
+ */
+Node* Network::addNode(QString name) {
+    int id = names.size();
+
+    names << name;
+    nameIndex.insert(name, id);
+    evidences << -1;
+    metas << QVariantHash();
+
+    valueRows.appendRow(0);
+    parentRows.appendRow(0);
+    childRows.appendRow(0);
+    tableRows.appendRow(0);
+
+    // New node counts as changed in every way
+    ++rev;
+    changeRevs << QVector<quint64>(changeKinds, rev);
+    hashes << 0;
+    hashValid << false;
+
+    Node *n = new Node(this, id);
+    views << n;
+
+    return n;
+}
+
+/*
+ * Adds whole nodes at once - rows of every node are appended to arrays as
+ * it is added and children rows are rebuilt once, so time is linear in size
+ * of network
+ */
+void Network::addNodes(const QList<NodeData> &nodes) {
+    int first = nodeCount();
+
+    // Rows of new node are the last ones, so they grow in place
+    foreach ( const NodeData &d, nodes ) {
+        int id = addNode(d.name)->id();
+
+        metas[id] = d.meta;
+
+        setRow(valueNames, valueRows, id, d.values.toVector());
+        queryProbs.resize(valueRows.size());
+        setRow(parentIds, parentRows, id, d.parents);
+        setRow(tables, tableRows, id, d.table);
+
+        changed(id, Node::ValuesChange | Node::ParentsChange |
+                    Node::TableChange);
+    }
+
+    // New children are appended to rows of their parents
+    QVector<QVector<int> > added(nodeCount());
+    for ( int i=0; i<nodes.size(); ++i ) {
+        foreach ( int p, nodes.at(i).parents ) {
+            added[p] << first + i;
+        }
+    }
+
+    RowLayout rows;
+    QVector<int> ids;
+    for ( int id=0; id<nodeCount(); ++id ) {
+        QVector<int> row = childRows.row(childIds, id) + added.at(id);
+        rows.appendRow(row.size());
+        ids << row;
+    }
+
+    childRows = rows;
+    childIds = ids;
+}
+
+/*
+ * Gets view of node with id `id'
+ */
+Node* Network::node(int id) const {
+    return views.at(id);
+}
+
+/*
+ * Gets number of nodes
+ */
+int Network::nodeCount() const {
+    return names.size();
+}
+
+/*
+ * Gets id of node with given name (first created one if there are more of
+ * them, -1 if there is none)
+ */
+int Network::nodeId(QString name) const {
+    int id = -1;
+
+    foreach ( int i, nameIndex.values(name) ) {
+        if ( id < 0 || i < id ) {
+            id = i;
+        }
+    }
+
+    return id;
+}
+
+/*
+ * Gets node name
+ */
+QString Network::nodeName(int id) const {
+    return names.at(id);
+}
+
+/*
+ * Sets node name (if non-empty)
+ */
+void Network::setNodeName(int id, QString name) {
+    if ( name.length() > 0 ) {
+        nameIndex.remove(names.at(id), id);
+        nameIndex.insert(name, id);
+        names[id] = name;
+        changed(id, Node::NameChange);
+    }
+}
+
+// VALUES //////////////////////////////////////////////////////////////////////
+
+/*
+ * Gets number of node values
+ */
+int Network::cardinality(int id) const {
+    return valueRows.count(id);
+}
+
+/*
+ * Gets names of node values
+ */
+QStringList Network::values(int id) const {
+    return valueRows.row(valueNames, id).toList();
+}
+
+/*
+ * Sets names of node values (query results of values kept by index)
+ */
+void Network::setValues(int id, QStringList values) {
+    int count = cardinality(id);
+    int from = valueRows.resizeRow(id, values.length());
+    valueRows.moveRow(valueNames, id, from, count);
+    valueRows.moveRow(queryProbs, id, from, count);
+
+    qCopy(values.constBegin(), values.constEnd(),
+          valueNames.begin() + valueRows.start(id));
+    packRows(valueRows, valueNames, queryProbs);
+
+    changed(id, Node::ValuesChange);
+}
+
+/*
+ * Inserts value at `index' (-1 appends it); evidence and table are reset
+ */
+void Network::insertValue(int id, int index, QString value) {
+    evidences[id] = -1;
+
+    int from = valueRows.resizeRow(id, cardinality(id) + 1);
+    insertInRow(valueNames, valueRows, id, from, index, value);
+    insertInRow(queryProbs, valueRows, id, from, index, 0.0);
+    packRows(valueRows, valueNames, queryProbs);
+
+    clearTable(id, 0);
+    changed(id, Node::ValuesChange);
+}
+
+/*
+ * Removes value at `index'; evidence and table are reset
+ */
+void Network::removeValue(int id, int index) {
+    evidences[id] = -1;
+
+    if ( index >= 0 && index < cardinality(id) ) {
+        valueRows.resizeRow(id, cardinality(id) - 1);
+        removeFromRow(valueNames, valueRows, id, index);
+        removeFromRow(queryProbs, valueRows, id, index);
+    }
+
+    clearTable(id, 0);
+    changed(id, Node::ValuesChange);
+}
+
+/*
+ * Renames value at `index'
+ */
+void Network::renameValue(int id, int index, QString value) {
+    valueNames[valueRows.start(id) + index] = value;
+    changed(id, Node::ValuesChange);
+}
+
+// STRUCTURE ///////////////////////////////////////////////////////////////////
+
+/*
+ * Gets ids of node parents (in order they index probability table)
+ */
+QVector<int> Network::parents(int id) const {
+    return parentRows.row(parentIds, id);
+}
+
+/*
+ * Gets ids of node children
+ */
+QVector<int> Network::children(int id) const {
+    return childRows.row(childIds, id);
+}
+
+/*
+ * Adds `parent' as last parent of node; table is reset
+ */
+void Network::addParent(int id, int parent) {
+    int from = parentRows.resizeRow(id, parentRows.count(id) + 1);
+    insertInRow(parentIds, parentRows, id, from, -1, parent);
+    packRows(parentRows, parentIds);
+
+    from = childRows.resizeRow(parent, childRows.count(parent) + 1);
+    insertInRow(childIds, childRows, parent, from, -1, id);
+    packRows(childRows, childIds);
+
+    clearTable(id, 0);
+    changed(id, Node::ParentsChange);
+}
+
+/*
+ * Removes `parent' from parents of node; table is reset
+ */
+void Network::removeParent(int id, int parent) {
+    int index = indexInRow(parentIds, parentRows, id, parent);
+    if ( index >= 0 ) {
+        parentRows.resizeRow(id, parentRows.count(id) - 1);
+        removeFromRow(parentIds, parentRows, id, index);
+    }
+
+    index = indexInRow(childIds, childRows, parent, id);
+    if ( index >= 0 ) {
+        childRows.resizeRow(parent, childRows.count(parent) - 1);
+        removeFromRow(childIds, childRows, parent, index);
+    }
+
+    clearTable(id, 0);
+    changed(id, Node::ParentsChange);
+}
+
+// PROBABILITY TABLES //////////////////////////////////////////////////////////
+
+/*
+ * Gets number of entries in node probability table
+ */
+int Network::tableSize(int id) const {
+    return tableRows.count(id);
+}
+
+/*
+ * Gets entries of node probability table (valid until tables change)
+ */
+const double* Network::table(int id) const {
+    return tables.constData() + tableRows.start(id);
+}
+
+/*
+ * Gets copy of node probability table
+ */
+QList<double> Network::tableList(int id) const {
+    return tableRows.row(tables, id).toList();
+}
+
+/*
+ * Sets whole node probability table
+ */
+void Network::setTable(int id, QList<double> table) {
+    setRow(tables, tableRows, id, table.toVector());
+    packRows(tableRows, tables);
+    changed(id, Node::TableChange);
+}
+
+/*
+ * Sets entry `i' of node probability table (table grows if needed)
+ */
+void Network::setProbability(int id, int i, double p) {
+    if ( i >= tableSize(id) ) {
+        int count = tableSize(id);
+        int from = tableRows.resizeRow(id, i + 1);
+        tableRows.moveRow(tables, id, from, count);
+        packRows(tableRows, tables);
+    }
+
+    tables[tableRows.start(id) + i] = p;
+    changed(id, Node::TableChange);
+}
+
+/*
+ * Resets node probability table to `size' zero entries
+ */
+void Network::clearTable(int id, int size) {
+    setRow(tables, tableRows, id, QVector<double>(size, 0.0));
+    packRows(tableRows, tables);
+    changed(id, Node::TableChange);
+}
+
+// EVIDENCE AND QUERY RESULTS //////////////////////////////////////////////////
+
+/*
+ * Gets index of value set as evidence (-1 if none)
+ */
+int Network::evidence(int id) const {
+    return evidences.at(id);
+}
+
+/*
+ * Sets index of value set as evidence (-1 for none)
+ */
+void Network::setEvidence(int id, int value) {
+    evidences[id] = value;
+}
+
+/*
+ * Gets probability of value from query
+ */
+double Network::queryP(int id, int value) const {
+    if ( value < 0 || value >= cardinality(id) ) {
+        return 0.0;
+    }
+
+    return queryProbs.at(valueRows.start(id) + value);
+}
+
+/*
+ * Sets probability of value from query
+ */
+void Network::setQueryP(int id, int value, double p) {
+    if ( value < 0 || value >= cardinality(id) ) {
+        return;
+    }
+
+    queryProbs[valueRows.start(id) + value] = p;
+}
+
+/*
+ * Sets probabilities of all values from query (missing ones are zero)
+ */
+void Network::setQueryValues(int id, QList<double> p) {
+    int from = valueRows.start(id);
+
+    for ( int i=0; i<cardinality(id); ++i ) {
+        queryProbs[from + i] = i < p.length() ? p.at(i) : 0.0;
+    }
+}
+
+// META DATA ///////////////////////////////////////////////////////////////////
+
+/*
+ * Gets node meta data
+ */
+QVariantHash Network::meta(int id) const {
+    return metas.at(id);
+}
+
+/*
+ * Sets node meta data item
+ */
+void Network::setMeta(int id, QString key, QVariant value) {
+    metas[id][key] = value;
+    changed(id, Node::MetaChange);
+}
+
+// VERSIONS ////////////////////////////////////////////////////////////////////
+
+/*
+ * Gets version of network - it grows with every change influencing inference
+ * (evidence and meta data excluded)
+ */
+quint64 Network::version() const {
+    return ver;
+}
+
+/*
+ * Gets revision of network - it grows with every change of nodes (evidence
+ * and query results excluded)
+ */
+quint64 Network::revision() const {
+    return rev;
+}
+
+/*
+ * Gets what has changed in node since network was at `revision'
+ * (combination of Node::Change flags; node added later has changed in every
+ * way)
+ */
+int Network::changesSince(int id, quint64 revision) const {
+    int what = 0;
+
+    for ( int k=0; k<changeKinds; ++k ) {
+        if ( changeRevs.at(id * changeKinds + k) > revision ) {
+            what |= 1 << k;
+        }
+    }
+
+    return what;
+}
+
+/*
+ * Takes snapshot of current network contents (arrays are shared until
+ * network changes them)
+ */
+NetworkSnapshot Network::snapshot() const {
+    NetworkSnapshot s;
+
+    s.ver = ver;
+    s.netName = netName;
+    s.names = names;
+    s.evidences = evidences;
+    s.valueRows = valueRows;
+    s.valueNames = valueNames;
+    s.parentRows = parentRows;
+    s.parentIds = parentIds;
+    s.tableRows = tableRows;
+    s.tables = tables;
+
+    return s;
+}
+
+// HASHING /////////////////////////////////////////////////////////////////////
+
+/*
+ * Gets hash of node name, values and probability table (parents are
+ * referenced by name so they are hashed on the network level)
+ */
+quint64 Network::nodeHash(int id) const {
+    if ( !hashValid.at(id) ) {
+        quint64 h = Node::hashString(fnvOffset, names.at(id));
+
+        for ( int i=0; i<cardinality(id); ++i ) {
+            h = Node::hashString(h, valueNames.at(valueRows.start(id) + i));
+        }
+
+        h = Node::hashBytes(h, table(id), tableSize(id) * sizeof(double));
+
+        hashes[id] = h;
+        hashValid[id] = true;
+    }
+
+    return hashes.at(id);
+}
+
+/*
+ * Called whenever node contents change - stamps changed parts of node with
+ * new revision (meta data does not influence inference so hash and version
+ * stay the same)
+ */
+void Network::changed(int id, int what) {
+    ++rev;
+    for ( int k=0; k<changeKinds; ++k ) {
+        if ( what & (1 << k) ) {
+            changeRevs[id * changeKinds + k] = rev;
+        }
+    }
+
+    if ( what != Node::MetaChange ) {
+        hashValid[id] = false;
+        ++ver;
+    }
+}
@@ -0,0 +1,159 @@
+/*
+    Copyright (C) 2012 Ivan Radicek
+
+    This file is part of Bayes.
+
+    Bayes is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bayes is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Bayes.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef NETWORK_H
+#define NETWORK_H
+
+#include <QObject>
+#include <QList>
+#include <QVector>
+#include <QStringList>
+#include <QVariantHash>
+#include <QMultiHash>
+
+#include "networksnapshot.h"
+#include "rowlayout.h"
+
+class Node;
+
+/*
+ * Contents of node added by Network::addNodes() (parents are ids of nodes in
+ * network, including ones added together with node)
+ */
+struct NodeData {
+    QString name;
+    QStringList values;
+    QVector<int> parents;
+    QVector<double> table;
+    QVariantHash meta;
+};
+
+/*
+ * Bayes network model, independent of editor scene. Nodes are identified by
+ * ids (0, 1, ... in order of creation) and their data is kept in compact
+ * arrays indexed by id: variable sized data (value names, probability tables,
+ * query results, parents and children) is stored in one array per kind and
+ * placed in it by RowLayout, so editing one node does not move data of other
+ * nodes. Node objects are only views of this data (GraphicsNode is view of
+ * Node).
+ */
+class Network : public QObject {
+    Q_OBJECT
+
+public:
+    Network(QObject *parent = 0);
+    QString name() const;
+    void setName(QString name);
+
+    // Nodes
+    Node* addNode(QString name);
+    void addNodes(const QList<NodeData> &nodes);
+    Node* node(int id) const;
+    int nodeCount() const;
+    int nodeId(QString name) const;
+
+    QString nodeName(int id) const;
+    void setNodeName(int id, QString name);
+
+    // Values
+    int cardinality(int id) const;
+    QStringList values(int id) const;
+    void setValues(int id, QStringList values);
+    void insertValue(int id, int index, QString value);
+    void removeValue(int id, int index);
+    void renameValue(int id, int index, QString value);
+
+    // Structure
+    QVector<int> parents(int id) const;
+    QVector<int> children(int id) const;
+    void addParent(int id, int parent);
+    void removeParent(int id, int parent);
+
+    // Probability tables
+    int tableSize(int id) const;
+    const double* table(int id) const;
+    QList<double> tableList(int id) const;
+    void setTable(int id, QList<double> table);
+    void setProbability(int id, int i, double p);
+    void clearTable(int id, int size);
+
+    // Evidence and query results
+    int evidence(int id) const;
+    void setEvidence(int id, int value);
+    double queryP(int id, int value) const;
+    void setQueryP(int id, int value, double p);
+    void setQueryValues(int id, QList<double> p);
+
+    // Meta data
+    QVariantHash meta(int id) const;
+    void setMeta(int id, QString key, QVariant value);
+
+    // Versions
+    quint64 version() const;
+    quint64 revision() const;
+    int changesSince(int id, quint64 revision) const;
+    NetworkSnapshot snapshot() const;
+
+    // Hashing
+    quint64 nodeHash(int id) const;
+
+signals:
+
+public slots:
+
+private:
+    void changed(int id, int what);
+
+    QString netName;
+    quint64 ver;
+    quint64 rev;
+
+    // Node views by id
+    QVector<Node*> views;
+
+    // Fixed size node data
+    QVector<QString> names;
+    QMultiHash<QString, int> nameIndex;
+    QVector<int> evidences;
+    QVector<QVariantHash> metas;
+
+    // Value names and query probabilities (both one item per value)
+    RowLayout valueRows;
+    QVector<QString> valueNames;
+    QVector<double> queryProbs;
+
+    // Parents and children adjacency
+    RowLayout parentRows;
+    QVector<int> parentIds;
+    RowLayout childRows;
+    QVector<int> childIds;
+
+    // Probability tables
+    RowLayout tableRows;
+    QVector<double> tables;
+
+    // Revisions of last changes of nodes (one per kind of change and node)
+    QVector<quint64> changeRevs;
+
+    // Hash of node contents (recalculated when node changes)
+    mutable QVector<quint64> hashes;
+    mutable QVector<bool> hashValid;
+};
+
+#endif // NETWORK_H
@@ -0,0 +1,90 @@
+/*
+    Copyright (C) 2012 Ivan Radicek
+
+    This file is part of Bayes.
+
+    Bayes is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bayes is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Bayes.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "networksnapshot.h"
+
+/*
+ * Creates empty snapshot
+ */
+NetworkSnapshot::NetworkSnapshot() {
+    ver = 0;
+}
+
+/*
+ * Gets version of network snapshot was taken at
+ */
+quint64 NetworkSnapshot::version() const {
+    return ver;
+}
+
+/*
+ * Gets network name
+ */
+QString NetworkSnapshot::name() const {
+    return netName;
+}
+
+/*
+ * Gets number of nodes
+ */
+int NetworkSnapshot::nodeCount() const {
+    return names.size();
+}
+
+/*
+ * Gets node name
+ */
+QString NetworkSnapshot::nodeName(int id) const {
+    return names.at(id);
+}
+
+/*
+ * Gets number of node values
+ */
+int NetworkSnapshot::cardinality(int id) const {
+    return valueRows.count(id);
+}
+
+/*
+ * Gets names of node values
+ */
+QStringList NetworkSnapshot::values(int id) const {
+    return valueRows.row(valueNames, id).toList();
+}
+
+/*
+ * Gets ids of node parents
+ */
+QVector<int> NetworkSnapshot::parents(int id) const {
+    return parentRows.row(parentIds, id);
+}
+
+/*
+ * Gets node probability table
+ */
+QList<double> NetworkSnapshot::tableList(int id) const {
+    return tableRows.row(tables, id).toList();
+}
+
+/*
+ * Gets node evidence (-1 if there is none)
+ */
+int NetworkSnapshot::evidence(int id) const {
+    return evidences.at(id);
+}
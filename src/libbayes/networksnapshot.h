@@ -0,0 +1,68 @@
+/*
+    Copyright (C) 2012 Ivan Radicek
+
+    This file is part of Bayes.
+
+    Bayes is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bayes is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Bayes.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef NETWORKSNAPSHOT_H
+#define NETWORKSNAPSHOT_H
+
+#include <QVector>
+#include <QStringList>
+
+#include "rowlayout.h"
+
+/*
+ * Frozen contents of network at one version (see Network::snapshot()). Arrays
+ * are implicitly shared with network and other snapshots - they are copied
+ * only when network changes them, so taking snapshot is cheap.
+ */
+class NetworkSnapshot {
+
+public:
+    NetworkSnapshot();
+
+    quint64 version() const;
+    QString name() const;
+
+    int nodeCount() const;
+    QString nodeName(int id) const;
+    int cardinality(int id) const;
+    QStringList values(int id) const;
+    QVector<int> parents(int id) const;
+    QList<double> tableList(int id) const;
+    int evidence(int id) const;
+
+private:
+    friend class Network;
+
+    quint64 ver;
+    QString netName;
+
+    QVector<QString> names;
+    QVector<int> evidences;
+
+    RowLayout valueRows;
+    QVector<QString> valueNames;
+
+    RowLayout parentRows;
+    QVector<int> parentIds;
+
+    RowLayout tableRows;
+    QVector<double> tables;
+};
+
+#endif // NETWORKSNAPSHOT_H
@@ -0,0 +1,275 @@
+/*
+    Copyright (C) 2012 Ivan Radicek
+
+    This file is part of Bayes.
+
+    Bayes is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bayes is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Bayes.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "node.h"
+
+#include "network.h"
+
+// FNV-1a (64 bit) hash prime
+static const quint64 fnvPrime = 1099511628211ULL;
+
+/*
+ * Creates view of node `id' of `network' (nodes are created by
+ * Network::addNode())
+ */
+Node::Node(Network *network, int id) : QObject(network) {
+    net = network;
+    nid = id;
+}
+
+/*
+ * Gets network node belongs to
+ */
+Network* Node::network() const {
+    return net;
+}
+
+/*
+ * Gets id of node in its network
+ */
+int Node::id() const {
+    return nid;
+}
+
+/*
+ * Sets node name (if non-empty)
+ */
+void Node::setName(QString newName) {
+    net->setNodeName(nid, newName);
+}
+
+/*
+ * Gets node name
+ */
+QString Node::name() const {
+    return net->nodeName(nid);
+}
+
+/*
+ * Set list of node values
+ */
+void Node::setValueList(QStringList newVals) {
+    net->setValues(nid, newVals);
+}
+
+/*
+ * Get list of node values
+ */
+QStringList Node::valueList() const {
+    return net->values(nid);
+}
+
+/*
+ * Adds new value to node
+ */
+void Node::addValue(QString value, int index) {
+    net->insertValue(nid, index, value);
+    emit valueChanged();
+}
+
+/*
+ * Removes values from node values
+ */
+void Node::removeValue(int index) {
+    net->removeValue(nid, index);
+    emit valueChanged();
+}
+
+/*
+ * Removes value from node
+ */
+void Node::renameValue(int index, QString newName) {
+    net->renameValue(nid, index, newName);
+}
+
+/*
+ * Gets entry from probability table
+ */
+double Node::probaility(int i) {
+    if ( net->tableSize(nid) > i ) {
+        return net->table(nid)[i];
+    } else {
+        return 0.0;
+    }
+}
+
+/*
+ * Sets entry in probability table
+ */
+void Node::setProbability(int i, double p) {
+    net->setProbability(nid, i, p);
+}
+
+/*
+ * Set whole probability table
+ */
+void Node::setTable(QList<double> const t) {
+    net->setTable(nid, t);
+}
+
+/*
+ * Gets whole probability table
+ */
+QList<double> Node::getTable() const {
+    return net->tableList(nid);
+}
+
+/*
+ * Refresh empty probaility table of size n
+ */
+void Node::refreshTable(int n) {
+    net->clearTable(nid, n);
+}
+
+/*
+ * Get evidence value
+ */
+int Node::getEvidence() {
+    return net->evidence(nid);
+}
+
+/*
+ * Set evidence value
+ */
+void Node::setEvidence(int e) {
+    net->setEvidence(nid, e);
+}
+
+/*
+ *  Set probability of value - result of query
+ */
+void Node::setQueryP(QString value, double np) {
+    setQueryP(valueList().indexOf(value), np);
+}
+
+/*
+ * Sets probability of value with index `i' from query
+ */
+void Node::setQueryP(int i, double np) {
+    net->setQueryP(nid, i, np);
+}
+
+/*
+ * Gets probability of value from query
+ */
+double Node::getQueryP(int i) {
+    return net->queryP(nid, i);
+}
+
+/*
+ * Add parent to node
+ */
+void Node::addParent(Node *n) {
+    net->addParent(nid, n->id());
+}
+
+/*
+ * Remove parent from node
+ */
+void Node::removeParent(Node *n) {
+    net->removeParent(nid, n->id());
+}
+
+/*
+ * Get list of parents
+ */
+QList<Node*> Node::getParents() const {
+    QList<Node*> l;
+
+    foreach ( int p, net->parents(nid) ) {
+        l << net->node(p);
+    }
+
+    return l;
+}
+
+/*
+ * Sets meta data
+ */
+void Node::setMeta(QString key, QVariant value) {
+    net->setMeta(nid, key, value);
+}
+
+/*
+ * Gets meta data
+ */
+QVariantHash Node::getMeta() const {
+    return net->meta(nid);
+}
+
+/*
+ * Gets what has changed since network was at `revision' (combination of
+ * Change flags)
+ */
+int Node::changesSince(quint64 revision) const {
+    return net->changesSince(nid, revision);
+}
+
+/*
+ * Sets probabilities of all values at once - result of query
+ */
+void Node::setQueryValues(QList<double> values) {
+    net->setQueryValues(nid, values);
+}
+
+/*
+ * Gets probabilities of all values from query
+ */
+QList<double> Node::queryValues() const {
+    QList<double> l;
+
+    for ( int i=0; i<net->cardinality(nid); ++i ) {
+        l << net->queryP(nid, i);
+    }
+
+    return l;
+}
+
+/*
+ * Gets hash of node name, values and probability table (parents are
+ * referenced by name so they are hashed on the network level)
+ */
+quint64 Node::hash() const {
+    return net->nodeHash(nid);
+}
+
+/*
+ * Continues FNV-1a hash `h' with bytes of data
+ */
+quint64 Node::hashBytes(quint64 h, const void *data, int len) {
+    const unsigned char *b = (const unsigned char*)data;
+
+    for ( int i=0; i<len; ++i ) {
+        h ^= b[i];
+        h *= fnvPrime;
+    }
+
+    return h;
+}
+
+/*
+ * Continues FNV-1a hash `h' with string (length is included so that
+ * concatenated strings can not collide)
+ */
+quint64 Node::hashString(quint64 h, QString s) {
+    int len = s.length();
+    h = hashBytes(h, &len, sizeof(len));
+
+    return hashBytes(h, s.constData(), len * sizeof(QChar));
+}
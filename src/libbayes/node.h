@@ -25,11 +25,28 @@
 #include <QStringList>
 #include <QVariantHash>
 
+class Network;
+
+/*
+ * View of one node of network - node data itself is kept by Network
+ */
 class Node : public QObject {
     Q_OBJECT
 
 public:
-    Node(QObject *parent = 0);
+    // Kinds of node changes (see Network::changesSince())
+    enum Change {
+        NameChange = 1,
+        ValuesChange = 2,
+        ParentsChange = 4,
+        TableChange = 8,
+        MetaChange = 16
+    };
+
+    Node(Network *network, int id);
+
+    Network* network() const;
+    int id() const;
 
     void setName(QString newName);
     QString name() const;
@@ -52,6 +69,7 @@ public:
     void setEvidence(int e);
 
     void setQueryP(QString value, double p);
+    void setQueryP(int i, double p);
     double getQueryP(int i);
 
     void addParent(Node *n);
@@ -61,20 +79,24 @@ public:
     void setMeta(QString key, QVariant value);
     QVariantHash getMeta() const;
 
+    void setQueryValues(QList<double> values);
+    QList<double> queryValues() const;
+
+    quint64 hash() const;
+
+    int changesSince(quint64 revision) const;
+
+    static quint64 hashBytes(quint64 h, const void *data, int len);
+    static quint64 hashString(quint64 h, QString s);
+
 signals:
     void valueChanged();
 
 public slots:
 
 private:
-    QString nName;
-    QList<QString> values;
-    QList<Node*> parents;
-    QList<double> table;
-    QVariantHash meta;
-
-    int evidence;
-    QList<double> p;
+    Network *net;
+    int nid;
 };
 
 #endif // NODE_H
@@ -0,0 +1,124 @@
+/*
+    Copyright (C) 2012 Ivan Radicek
+
+    This file is part of Bayes.
+
+    Bayes is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bayes is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Bayes.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "rowlayout.h"
+
+// Unused room tolerated before arrays are packed
+static const int minUnused = 256;
+
+/*
+ * Creates layout without rows
+ */
+RowLayout::RowLayout() {
+    end = 0;
+    unused = 0;
+}
+
+/*
+ * Gets number of rows
+ */
+int RowLayout::rowCount() const {
+    return starts.size();
+}
+
+/*
+ * Gets index of first item of row
+ */
+int RowLayout::start(int row) const {
+    return starts.at(row);
+}
+
+/*
+ * Gets number of items in row
+ */
+int RowLayout::count(int row) const {
+    return counts.at(row);
+}
+
+/*
+ * Gets size of arrays placed by layout (items and room of all rows)
+ */
+int RowLayout::size() const {
+    return end;
+}
+
+/*
+ * Appends row of `count' items at end of arrays (without room to grow - it
+ * is the last row, so it can grow in place until other row is appended)
+ */
+void RowLayout::appendRow(int count) {
+    starts << end;
+    counts << count;
+    rooms << count;
+    end += count;
+}
+
+/*
+ * Changes number of items in row; returns previous start of row. Row which
+ * does not fit its room any more is moved to end of arrays with room for
+ * twice as many items, so row growing item by item moves only a logarithmic
+ * number of times.
+ */
+int RowLayout::resizeRow(int row, int count) {
+    int from = starts.at(row);
+
+    if ( count > rooms.at(row) ) {
+        if ( from + rooms.at(row) == end ) {
+            // Last row grows in place
+            end = from + count;
+            rooms[row] = count;
+
+        } else {
+            unused += rooms.at(row);
+            starts[row] = end;
+            rooms[row] = qMax(2 * count, 4);
+            end += rooms.at(row);
+        }
+    }
+
+    counts[row] = count;
+
+    return from;
+}
+
+/*
+ * Checks if so much of arrays is unused that they should be packed
+ */
+bool RowLayout::isSparse() const {
+    return unused > minUnused && unused > end / 2;
+}
+
+/*
+ * Gets layout of the same rows placed one after another (rows keep their
+ * room)
+ */
+RowLayout RowLayout::packed() const {
+    RowLayout l;
+
+    l.counts = counts;
+    l.rooms = rooms;
+    l.starts.reserve(rowCount());
+
+    for ( int r=0; r<rowCount(); ++r ) {
+        l.starts << l.end;
+        l.end += rooms.at(r);
+    }
+
+    return l;
+}
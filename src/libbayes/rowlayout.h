@@ -0,0 +1,118 @@
+/*
+    Copyright (C) 2012 Ivan Radicek
+
+    This file is part of Bayes.
+
+    Bayes is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bayes is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Bayes.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ROWLAYOUT_H
+#define ROWLAYOUT_H
+
+#include <QVector>
+
+/*
+ * Placement of variable sized rows (one per node) in array of one kind of
+ * node data: row `i' holds count(i) items from start(i) and has room for some
+ * more, so changing one row does not move items of other rows. Row which
+ * outgrows its room is moved to end of array and leaves its old room unused;
+ * array is packed (see packed() and pack()) when too much of it is unused.
+ * Layout only tracks placement - items are kept by owner of layout, which
+ * applies every change of layout to its arrays.
+ */
+class RowLayout {
+
+public:
+    RowLayout();
+
+    int rowCount() const;
+    int start(int row) const;
+    int count(int row) const;
+    int size() const;
+
+    void appendRow(int count);
+    int resizeRow(int row, int count);
+
+    bool isSparse() const;
+    RowLayout packed() const;
+
+    template <typename T>
+    QVector<T> row(const QVector<T> &items, int row) const;
+
+    template <typename T>
+    void moveRow(QVector<T> &items, int row, int from, int count) const;
+
+    template <typename T>
+    QVector<T> pack(const QVector<T> &items, const RowLayout &to) const;
+
+private:
+    QVector<int> starts;
+    QVector<int> counts;
+    QVector<int> rooms;
+
+    int end;    // Size of arrays
+    int unused; // Room left behind by moved rows
+};
+
+/*
+ * Gets copy of items of `row'
+ */
+template <typename T>
+QVector<T> RowLayout::row(const QVector<T> &items, int row) const {
+    return items.mid(starts.at(row), counts.at(row));
+}
+
+/*
+ * Applies resizeRow() to `items' - `from' and `count' are start and count of
+ * row before it was resized (items added to row are reset)
+ */
+template <typename T>
+void RowLayout::moveRow(QVector<T> &items, int row, int from,
+                        int count) const {
+    if ( items.size() < end ) {
+        items.resize(end);
+    }
+
+    int to = starts.at(row);
+    int kept = qMin(count, counts.at(row));
+
+    if ( to != from ) {
+        for ( int i=0; i<kept; ++i ) {
+            items[to + i] = items.at(from + i);
+        }
+    }
+
+    for ( int i=kept; i<counts.at(row); ++i ) {
+        items[to + i] = T();
+    }
+}
+
+/*
+ * Gets `items' placed by layout `to' (packed() of this layout)
+ */
+template <typename T>
+QVector<T> RowLayout::pack(const QVector<T> &items,
+                           const RowLayout &to) const {
+    QVector<T> packed(to.size());
+
+    for ( int r=0; r<rowCount(); ++r ) {
+        for ( int i=0; i<counts.at(r); ++i ) {
+            packed[to.start(r) + i] = items.at(starts.at(r) + i);
+        }
+    }
+
+    return packed;
+}
+
+#endif // ROWLAYOUT_H
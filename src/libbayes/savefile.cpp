@@ -0,0 +1,90 @@
+/*
+    Copyright (C) 2012 Ivan Radicek
+
+    This file is part of Bayes.
+
+    Bayes is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bayes is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Bayes.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "savefile.h"
+
+#include <stdio.h>
+
+#ifdef Q_OS_UNIX
+#include <unistd.h>
+#endif
+
+/*
+ * Creates file to be saved as `fileName'
+ */
+SaveFile::SaveFile(QString fileName) :
+        QTemporaryFile(fileName + ".XXXXXX") {
+    target = fileName;
+    setAutoRemove(true);
+}
+
+/*
+ * Creates temporary file for writing; on failure `error' describes problem
+ */
+bool SaveFile::open(QString &error) {
+    if ( !QTemporaryFile::open() ) {
+        error = "Cannot open file " + target;
+        return false;
+    }
+
+    return true;
+}
+
+/*
+ * Flushes written contents to disk and renames temporary file to target
+ * (target keeps its permissions); on failure `error' describes problem and
+ * target is left as it was
+ */
+bool SaveFile::commit(QString &error) {
+    bool ok = flush();
+
+#ifdef Q_OS_UNIX
+    ok = ok && fsync(handle()) == 0;
+#endif
+
+    QString temp = fileName();
+    close();
+
+    if ( !ok || QFile::error() != QFile::NoError ) {
+        error = "Cannot write file " + target;
+        return false;
+    }
+
+    // Temporary file is private - new file gets usual permissions
+    if ( QFile::exists(target) ) {
+        setPermissions(QFile::permissions(target));
+    } else {
+        setPermissions(QFile::ReadOwner | QFile::WriteOwner |
+                       QFile::ReadGroup | QFile::ReadOther);
+    }
+
+#ifndef Q_OS_UNIX
+    // Renaming does not replace existing file outside of POSIX
+    QFile::remove(target);
+#endif
+
+    if ( ::rename(QFile::encodeName(temp).constData(),
+                  QFile::encodeName(target).constData()) != 0 ) {
+        error = "Cannot replace file " + target;
+        return false;
+    }
+
+    setAutoRemove(false);
+    return true;
+}
@@ -17,30 +17,27 @@
     along with Bayes.  If not, see <http://www.gnu.org/licenses/>.
 */
 
-#ifndef NETWORK_H
-#define NETWORK_H
+#ifndef SAVEFILE_H
+#define SAVEFILE_H
 
-#include <QObject>
-#include <QList>
+#include <QTemporaryFile>
 
-class Node;
-
-class Network : public QObject {
-    Q_OBJECT
+/*
+ * File which is written under temporary name next to its target and renamed
+ * over target only when it is complete (Qt 4 has no QSaveFile), so failed
+ * save leaves previous file as it was. Temporary file is removed unless it
+ * was committed.
+ */
+class SaveFile : public QTemporaryFile {
 
 public:
-    Network(QObject *parent = 0);
-    QString name() const;
-    void setName(QString name);
+    SaveFile(QString fileName);
 
-signals:
-
-public slots:
+    bool open(QString &error);
+    bool commit(QString &error);
 
 private:
-    QString netName;
-
-    QList<Node*> nodes;
+    QString target;
 };
 
-#endif // NETWORK_H
+#endif // SAVEFILE_H
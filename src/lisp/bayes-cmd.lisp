@@ -4,56 +4,578 @@
 
 (load "bayes.lisp")
 
+;;; Shared memory segments are mapped with POSIX calls, daemon listens on
+;;; local socket
+(require :sb-posix)
+(require :sb-bsd-sockets)
+
 ;;; Current network
 (defparameter *network* nil)
 
-;;; Outputs a command
+;;; Networks of GUI sessions (editor tabs) by session id; *network* belongs
+;;; to session selected last
+(defparameter *networks* (make-hash-table))
+(defparameter *session* 0)
+
+;;; Commands read while query was running (executed after query is done)
+(defparameter *pending-commands* nil)
+
+;;; How often (in internal time units) input is checked for cancel command
+(defparameter *cancel-poll-interval*
+  (round internal-time-units-per-second 20))
+
+;;; Time when input was last checked for cancel command
+(defparameter *last-cancel-poll* 0)
+
+;;; Id of request being executed. GUI sends commands as (id command args..)
+;;; and every output made while executing command starts with its id.
+(defparameter *request-id* 0)
+
+;;; Outputs of query thread and main thread must not mix
+#+sb-thread (defparameter *output-lock* (sb-thread:make-mutex :name "output"))
+
+;;; Queries are run one by one in query thread while main thread reads other
+;;; commands. Cancelled requests are stopped at first safe point (or skipped
+;;; if they have not been started yet). Both threads of client change the
+;;; same query-state, so it is only ever shared, never copied or rebound to
+;;; other one.
+#+sb-thread
+(progn
+  (defstruct query-state
+    (lock (sb-thread:make-mutex :name "queries"))
+    (ready (sb-thread:make-waitqueue))
+    (queue nil)     ; Jobs (id network options option-values) and :stop
+    (running nil)   ; Id of running request
+    (cancelled nil) ; Ids of cancelled requests
+    (thread nil))
+  (defparameter *queries* (make-query-state)))
+
+;;; Variables query depends on (options and output); query thread runs every
+;;; query with values they had when it was queued
+(defparameter *query-options*
+  '(*diff-small-value* *diff-check-period* *gibbs-warm-burn-in*
+    *sample-pool-size* *sample-reuse-min-ess* *auto-accuracy*
+    *auto-memory-budget* *auto-exact-width* *shared-memory-threshold*
+    *protocol* *binary-output*))
+
+;;; Protocol used to talk to GUI - :sexp or :binary. Binary messages are
+;;; sent in frames: 4-byte little-endian header (payload length, bit 31 set
+;;; when more frames of message follow) and payload which is one value tagged
+;;; with character: L (u32 count, values), S (u32 length, UTF-8 string),
+;;; Y (symbol, like S), I (int32), D (double), V (u32 count, packed doubles),
+;;; M (packed doubles in shared memory, see below), T (true), N (nil).
+(defparameter *protocol* :sexp)
+
+;;; Binary streams used in binary protocol
+(defparameter *binary-input* nil)
+(defparameter *binary-output* nil)
+
+;;; File descriptors client talks through (socket of daemon client)
+(defparameter *input-fd* 0)
+(defparameter *output-fd* 1)
+
+;;; Longest payload of one frame
+(defparameter *max-frame-length* #x7fffffff)
+
+;;; Vectors of doubles at least this big (in bytes) are passed through shared
+;;; memory segment (tag M, u32 name length, name, u32 count) instead of pipe;
+;;; 0 means never. GUI enables it with shared-memory-threshold option.
+(defparameter *shared-memory-threshold* 0)
+
+;;; Number of segments created so far (makes names unique, daemon clients
+;;; create them concurrently)
+(defparameter *shared-segment-count* (list 0))
+
+;;; Shared memory ;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+
+;;; shm_open and shm_unlink live in librt with older C libraries
+(ignore-errors (sb-alien:load-shared-object "librt.so.1"))
+
+(defun valid-segment-name-p (name)
+  "Checks if name is plain name of shared memory segment - slash followed by
+letters, digits, dots, underscores and dashes (without ..)"
+  (and (stringp name)
+       (> (length name) 1)
+       (char= (char name 0) #\/)
+       (not (search ".." name))
+       (every #'(lambda (c)
+		  (or (char<= #\a c #\z) (char<= #\A c #\Z)
+		      (char<= #\0 c #\9) (find c "._-")))
+	      (subseq name 1))))
+
+(defun shm-open (name flags mode)
+  "Opens POSIX shared memory segment; returns its file descriptor"
+  (let ((fd (sb-alien:alien-funcall
+	     (sb-alien:extern-alien "shm_open"
+				    (function sb-alien:int sb-alien:c-string
+					      sb-alien:int sb-alien:unsigned-int))
+	     name flags mode)))
+    (when (< fd 0)
+      (error (format nil "Cannot open shared memory segment ~A" name)))
+    fd))
+
+(defun shm-unlink (name)
+  "Removes name of POSIX shared memory segment"
+  (sb-alien:alien-funcall
+   (sb-alien:extern-alien "shm_unlink"
+			  (function sb-alien:int sb-alien:c-string))
+   name))
+
+(defun write-shared-doubles (vector)
+  "Creates shared memory segment holding doubles of vector (native byte
+order); returns name of segment"
+  (let* ((name (format nil "/bayes-engine-~D-~D" (sb-posix:getpid)
+		       (sb-ext:atomic-incf (car *shared-segment-count*))))
+	 (size (* 8 (length vector)))
+	 (fd (shm-open name (logior sb-posix:o-rdwr sb-posix:o-creat
+				    sb-posix:o-excl)
+		       #o600)))
+    (unwind-protect
+	 (progn
+	   (sb-posix:ftruncate fd size)
+	   (when (> size 0)
+	     (let ((sap (sb-posix:mmap nil size
+				       (logior sb-posix:prot-read
+					       sb-posix:prot-write)
+				       sb-posix:map-shared fd 0)))
+	       (unwind-protect
+		    (dotimes (i (length vector))
+		      (setf (sb-sys:sap-ref-double sap (* 8 i))
+			    (aref vector i)))
+		 (sb-posix:munmap sap size)))))
+      (sb-posix:close fd))
+    name))
+
+(defun read-shared-doubles (name count)
+  "Copies count doubles from shared memory segment to vector and removes
+segment; name has to be plain segment name"
+  (unless (valid-segment-name-p name)
+    (error (format nil "Invalid shared memory segment name ~S" name)))
+  (let* ((size (* 8 count))
+	 (vector (make-array count :element-type 'double-float))
+	 (fd (shm-open name sb-posix:o-rdonly 0)))
+    (unwind-protect
+	 (progn
+	   (shm-unlink name)
+	   (when (< (sb-posix:stat-size (sb-posix:fstat fd)) size)
+	     (error (format nil "Shared memory segment ~A is too small"
+			    name)))
+	   (when (> size 0)
+	     (let ((sap (sb-posix:mmap nil size sb-posix:prot-read
+				       sb-posix:map-shared fd 0)))
+	       (unwind-protect
+		    (dotimes (i count)
+		      (setf (aref vector i)
+			    (sb-sys:sap-ref-double sap (* 8 i))))
+		 (sb-posix:munmap sap size)))))
+      (sb-posix:close fd))
+    vector))
+
+;;; Binary protocol encoding ;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+
+(defun put-u32 (n buffer)
+  "Appends 32-bit little-endian integer to byte buffer"
+  (dotimes (i 4)
+    (vector-push-extend (ldb (byte 8 (* i 8)) n) buffer)))
+
+(defun put-string (tag string buffer)
+  "Appends tagged length prefixed UTF-8 string to byte buffer"
+  (let ((octets (sb-ext:string-to-octets string :external-format :utf-8)))
+    (vector-push-extend (char-code tag) buffer)
+    (put-u32 (length octets) buffer)
+    (loop for octet across octets
+       do (vector-push-extend octet buffer))))
+
+(defun encode-value (value buffer)
+  "Appends binary encoding of value to byte buffer"
+  (cond ((eq value t) (vector-push-extend (char-code #\T) buffer))
+	((null value) (vector-push-extend (char-code #\N) buffer))
+	((listp value)
+	 (vector-push-extend (char-code #\L) buffer)
+	 (put-u32 (length value) buffer)
+	 (dolist (item value)
+	   (encode-value item buffer)))
+	((and (typep value '(array double-float (*)))
+	      (> *shared-memory-threshold* 0)
+	      (>= (* 8 (length value)) *shared-memory-threshold*))
+	 (put-string #\M (write-shared-doubles value) buffer)
+	 (put-u32 (length value) buffer))
+	((typep value '(array double-float (*)))
+	 (vector-push-extend (char-code #\V) buffer)
+	 (put-u32 (length value) buffer)
+	 (loop for d across value
+	    do (put-u32 (sb-kernel:double-float-low-bits d) buffer)
+	    do (put-u32 (ldb (byte 32 0) (sb-kernel:double-float-high-bits d))
+			buffer)))
+	((stringp value) (put-string #\S value buffer))
+	((keywordp value)
+	 (put-string #\Y (concatenate 'string ":" (symbol-name value)) buffer))
+	((symbolp value) (put-string #\Y (symbol-name value) buffer))
+	((typep value '(signed-byte 32))
+	 (vector-push-extend (char-code #\I) buffer)
+	 (put-u32 (ldb (byte 32 0) value) buffer))
+	((realp value)
+	 (let ((d (coerce value 'double-float)))
+	   (vector-push-extend (char-code #\D) buffer)
+	   (put-u32 (sb-kernel:double-float-low-bits d) buffer)
+	   (put-u32 (ldb (byte 32 0) (sb-kernel:double-float-high-bits d))
+		    buffer)))
+	(t (put-string #\S (princ-to-string value) buffer))))
+
+(defun write-binary-message (message stream)
+  "Writes value to stream as binary message split in frames"
+  (let ((payload (make-array 256 :element-type '(unsigned-byte 8)
+			     :adjustable t :fill-pointer 0))
+	(header (make-array 4 :element-type '(unsigned-byte 8)
+			    :adjustable t :fill-pointer 0))
+	(pos 0))
+    (encode-value message payload)
+    (loop
+       (let* ((n (min (- (length payload) pos) *max-frame-length*))
+	      (more (< (+ pos n) (length payload))))
+	 (setf (fill-pointer header) 0)
+	 (put-u32 (if more (logior n #x80000000) n) header)
+	 (write-sequence header stream)
+	 (write-sequence payload stream :start pos :end (+ pos n))
+	 (incf pos n)
+	 (unless more (return))))
+    (finish-output stream)))
+
+(defun get-u32 (octets pos)
+  "Reads 32-bit little-endian integer from byte vector"
+  (logior (aref octets pos)
+	  (ash (aref octets (+ pos 1)) 8)
+	  (ash (aref octets (+ pos 2)) 16)
+	  (ash (aref octets (+ pos 3)) 24)))
+
+(defun signed-32 (n)
+  "Interprets unsigned 32-bit integer as signed one"
+  (if (logbitp 31 n) (- n #x100000000) n))
+
+(defun decode-value (octets pos)
+  "Decodes value from byte vector starting at position; returns value and
+position after it"
+  (let ((tag (code-char (aref octets pos))))
+    (incf pos)
+    (case tag
+      (#\L (let ((count (get-u32 octets pos))
+		 (items nil))
+	     (incf pos 4)
+	     (dotimes (i count)
+	       (multiple-value-bind (item next) (decode-value octets pos)
+		 (push item items)
+		 (setf pos next)))
+	     (values (nreverse items) pos)))
+      ((#\S #\Y)
+       (let* ((n (get-u32 octets pos))
+	      (string (sb-ext:octets-to-string octets :external-format :utf-8
+					       :start (+ pos 4)
+					       :end (+ pos 4 n))))
+	 (values (if (char= tag #\S)
+		     string
+		     ;; Symbols are read as reader would read them
+		     (if (and (> (length string) 0)
+			      (char= (char string 0) #\:))
+			 (intern (string-upcase (subseq string 1)) :keyword)
+			 (intern (string-upcase string))))
+		 (+ pos 4 n))))
+      (#\I (values (signed-32 (get-u32 octets pos)) (+ pos 4)))
+      (#\D (values (sb-kernel:make-double-float
+		    (signed-32 (get-u32 octets (+ pos 4)))
+		    (get-u32 octets pos))
+		   (+ pos 8)))
+      (#\V (let* ((count (get-u32 octets pos))
+		  (vector (make-array count :element-type 'double-float)))
+	     (incf pos 4)
+	     (dotimes (i count)
+	       (setf (aref vector i)
+		     (sb-kernel:make-double-float
+		      (signed-32 (get-u32 octets (+ pos 4)))
+		      (get-u32 octets pos)))
+	       (incf pos 8))
+	     (values vector pos)))
+      (#\M (let* ((n (get-u32 octets pos))
+		  (name (sb-ext:octets-to-string octets :external-format :utf-8
+						 :start (+ pos 4)
+						 :end (+ pos 4 n))))
+	     (incf pos (+ 4 n))
+	     (values (read-shared-doubles name (get-u32 octets pos))
+		     (+ pos 4))))
+      (#\T (values t pos))
+      (#\N (values nil pos))
+      (t (error (format nil "Unknown value tag ~S" tag))))))
+
+(defun unlink-shared-segments (octets)
+  "Removes shared memory segments GUI named in byte vector of message which
+could not be decoded (segments read before decoding failed are already gone)"
+  (loop for pos from 0 below (- (length octets) 5)
+     do (when (char= (code-char (aref octets pos)) #\M)
+	  (let ((n (get-u32 octets (+ pos 1))))
+	    (when (<= (+ pos 5 n) (length octets))
+	      (let ((name (ignore-errors
+			    (sb-ext:octets-to-string
+			     octets :external-format :utf-8
+			     :start (+ pos 5) :end (+ pos 5 n)))))
+		(when (and (valid-segment-name-p name)
+			   (eql (search "/bayes-gui-" name) 0))
+		  (shm-unlink name))))))))
+
+(defun read-binary-message (stream)
+  "Reads all frames of binary message from stream and decodes it; returns
+NIL on end of input"
+  (let ((payload (make-array 0 :element-type '(unsigned-byte 8)
+			     :adjustable t :fill-pointer 0))
+	(header (make-array 4 :element-type '(unsigned-byte 8))))
+    (loop
+       (when (< (read-sequence header stream) 4)
+	 (return-from read-binary-message nil))
+       (let* ((h (get-u32 header 0))
+	      (n (ldb (byte 31 0) h))
+	      (start (fill-pointer payload)))
+	 (setf payload (adjust-array payload (+ start n)
+				     :fill-pointer (+ start n)))
+	 (when (< (read-sequence payload stream :start start) (+ start n))
+	   (return-from read-binary-message nil))
+	 (unless (logbitp 31 h) (return))))
+    (handler-bind ((error #'(lambda (condition)
+			      (declare (ignore condition))
+			      (unlink-shared-segments payload))))
+      (values (decode-value payload 0)))))
+
+;;; Executes body while no other thread outputs
+(defmacro with-output-lock (&body body)
+  #+sb-thread `(sb-thread:with-recursive-lock (*output-lock*) ,@body)
+  #-sb-thread `(progn ,@body))
+
+;;; Outputs a command (tagged with id of current request)
 (defun output (cmd &rest options)
   (do () ((not (and (listp options) (= (length options) 1)
 		    (listp (first options)))))
     (setf options (first options)))
-  (format t "~&~S~%" (append (list cmd) options)))
+  (let ((message (append (list *request-id* cmd) options)))
+    (with-output-lock
+      (if (eq *protocol* :binary)
+	  (write-binary-message message *binary-output*)
+	  (progn
+	    (format t "~&~S~%" message)
+	    (finish-output))))))
+
+;;; Splits command read from input to request id and command itself
+(defun split-request (input)
+  (if (integerp (first input))
+      (values (first input) (rest input))
+      (values 0 input)))
+
+;;; Reads next command; end of input is treated as quit command
+(defun read-command ()
+  (if (eq *protocol* :binary)
+      (or (read-binary-message *binary-input*) '(quit))
+      (read *standard-input* nil '(quit))))
+
+;;; Switches to binary protocol; acknowledgement is last text GUI receives
+(defun set-protocol (name)
+  (cond ((equal name "binary")
+	 (format t "~&~S" (list *request-id* "PROTOCOL" "binary"))
+	 (finish-output)
+	 ;; Drop whitespace following the command
+	 (input-waiting-p)
+	 (setf *binary-input*
+	       (sb-sys:make-fd-stream *input-fd* :input t :buffering :full
+				      :element-type '(unsigned-byte 8))
+	       *binary-output*
+	       (sb-sys:make-fd-stream *output-fd* :output t :buffering :full
+				      :element-type '(unsigned-byte 8))
+	       *protocol* :binary))
+	((equal name "sexp") nil)
+	(t (error (format nil "Unknown protocol ~A" name)))))
 
 ;;; Outputs "friendly" error
 (defun output-error (err)
     ;(output "ERROR" (simple-condition-format-control err)))
   (output "ERROR" err))
 
+;;; Executes body reporting errors (and cancelled query) to GUI
+(defmacro with-command-errors (&body body)
+  `(handler-case (progn ,@body)
+     (query-cancelled ()
+       (output "QUERY-CANCELLED")
+       (output "INFO" "Query cancelled."))
+     (simple-condition (condt)
+       (output-error
+	(apply #'format nil (append
+			     (list (simple-condition-format-control condt))
+			     (simple-condition-format-arguments condt)))))
+     (error (condition) (output-error "Unexpected error"))))
+
 ;;; Loads network on which inference is done
 (defun load-network (options)
   (setf *network* (apply #'read-bayes-network options))
-  (output "INFO" "Network loaded."))
-
-;;; Loads network from file
-(defun load-network-from-file (file-name &optional output-cmds)
-  (with-open-file (file file-name :if-does-not-exist :error)
-    (funcall #'load-network (read file))
-    (when output-cmds
-      (output "NETWORK-NAME" (slot-value *network* 'name))
-      (dolist (node-l (slot-value *network* 'nodes))
-	(let* ((name (car node-l))
-	       (node (cdr node-l)))
-	  (output "NODE-NAME" name)
-	  (output "NODE-VALS" (cons name (slot-value node 'vals)))
-	  (let ((metaval (meta node)))
-	    (when metaval (loop for (key value) on metaval by #'cddr
-			     do (output "NODE-META" name key value))))))
-      (dolist (node-l (slot-value *network* 'nodes))
-	(let* ((name (car node-l))
-	       (node (cdr node-l)))
-	  (dolist (parent (slot-value node 'parents))
-	    (output "NODE-PARENT" name parent))
-	  (output "NODE-TABLE" (cons name (slot-value node 'table))))))
-    (output "INFO" (format nil "Network ~S loaded." file-name))
-    (output "LOAD-FILE-DONE")))
-
-;;; Saves network to a file
-(defun save-file (file-name)
-  (with-open-file (file file-name :direction :output :if-does-not-exist :create
-			:if-exists :supersede)
-    (print (print-bayes-network *network*) file))
-  (output "INFO" (format nil "Network ~S saved." file-name))
-  (output "FILE-SAVE-DONE"))
+  (output "INFO" "Network loaded.")
+  (output "NETWORK-DONE"))
+
+;;; Applies changes to network on which inference is done
+(defun update-network (changes)
+  (setf *network* (apply #'update-bayes-network *network* changes))
+  (output "INFO" "Network updated.")
+  (output "NETWORK-DONE"))
+
+;;; Makes network of session current (current one is kept for its session)
+(defun select-network (session)
+  (when *network*
+    (setf (gethash *session* *networks*) *network*))
+  (setf *session* session
+	*network* (gethash session *networks*)))
+
+;;; Forgets network of session which is closed
+(defun forget-network (session)
+  (remhash session *networks*)
+  (when (eql session *session*)
+    (setf *network* nil)))
+
+;;; Checks (without blocking) if there is command waiting on input
+(defun input-waiting-p ()
+  (when (eq *protocol* :binary)
+    (return-from input-waiting-p (listen *binary-input*)))
+  (loop
+     (unless (listen) (return nil))
+     (let ((c (peek-char nil *standard-input* nil nil)))
+       (cond ((null c) (return nil))
+	     ((member c '(#\Space #\Tab #\Newline #\Return)) (read-char))
+	     (t (return t))))))
+
+;;; Called from inference safe points when queries are run in main thread -
+;;; reads commands which arrived in the meantime; cancel command for running
+;;; request stops the query, others are kept for later
+(defun poll-cancel ()
+  (let ((now (get-internal-real-time)))
+    (when (>= (- now *last-cancel-poll*) *cancel-poll-interval*)
+      (setf *last-cancel-poll* now)
+      (loop while (input-waiting-p)
+	 do (let ((input (read-command)))
+	      (multiple-value-bind (id command) (split-request input)
+		(declare (ignore id))
+		(if (and (eql (first command) 'cancel)
+			 (member (second command) (list nil *request-id*)))
+		    (error 'query-cancelled)
+		    (setf *pending-commands*
+			  (append-items *pending-commands* input)))))))))
+
+#+sb-thread
+(progn
+  (defun request-cancelled-p (id)
+    "Checks if request was cancelled"
+    (sb-thread:with-mutex ((query-state-lock *queries*))
+      (member id (query-state-cancelled *queries*))))
+
+  (defun poll-cancel-flag ()
+    "Called from inference safe points in query thread - stops query if its
+request was cancelled"
+    (let ((now (get-internal-real-time)))
+      (when (>= (- now *last-cancel-poll*) *cancel-poll-interval*)
+	(setf *last-cancel-poll* now)
+	(when (request-cancelled-p *request-id*)
+	  (error 'query-cancelled)))))
+
+  (defun cancel-request (id)
+    "Cancels queued or running query request (all of them if id is NIL)"
+    (let ((state *queries*))
+      (sb-thread:with-mutex ((query-state-lock state))
+	(let ((ids (append (when (query-state-running state)
+			     (list (query-state-running state)))
+			   (loop for job in (query-state-queue state)
+			      unless (eq job :stop) collect (first job)))))
+	  (dolist (i ids)
+	    (when (or (null id) (eql i id))
+	      (pushnew i (query-state-cancelled state))))))))
+
+  (defun stop-query-thread ()
+    "Cancels all queries and waits until query thread stops"
+    (cancel-request nil)
+    (let ((state *queries*)
+	  (thread nil))
+      (sb-thread:with-mutex ((query-state-lock state))
+	(setf thread (query-state-thread state))
+	(when thread
+	  (setf (query-state-queue state)
+		(append-items (query-state-queue state) :stop))
+	  (sb-thread:condition-notify (query-state-ready state))))
+      (when thread
+	(sb-thread:join-thread thread :default nil))))
+
+  (defun queue-query (options)
+    "Queues query to be run in query thread on current network with current
+values of options"
+    (let ((state *queries*))
+      (sb-thread:with-mutex ((query-state-lock state))
+	(setf (query-state-queue state)
+	      (append-items (query-state-queue state)
+			    (list *request-id* *network* options
+				  (mapcar #'symbol-value *query-options*))))
+	(unless (query-state-thread state)
+	  (setf (query-state-thread state)
+		(sb-thread:make-thread
+		 (client-function #'(lambda () (query-worker state)))
+		 :name "query")))
+	(sb-thread:condition-notify (query-state-ready state)))))
+
+  (defun query-worker (state)
+    "Runs queued queries of client, each one with options it was queued with"
+    (loop
+       (let ((job nil))
+	 (sb-thread:with-mutex ((query-state-lock state))
+	   (loop until (query-state-queue state)
+	      do (sb-thread:condition-wait (query-state-ready state)
+					   (query-state-lock state)))
+	   (setf job (pop (query-state-queue state)))
+	   (when (eq job :stop)
+	     (setf (query-state-thread state) nil)
+	     (return))
+	   (setf (query-state-running state) (first job)))
+	 (destructuring-bind (id network options values) job
+	   (progv *query-options* values
+	     (let ((*request-id* id)
+		   (*network* network)
+		   (*cancel-check* #'poll-cancel-flag)
+		   (*last-cancel-poll* 0))
+	       (with-command-errors
+		 (when (request-cancelled-p id)
+		   (error 'query-cancelled))
+		 (query options))))
+	   (sb-thread:with-mutex ((query-state-lock state))
+	     (setf (query-state-running state) nil)
+	     (setf (query-state-cancelled state)
+		   (remove id (query-state-cancelled state)))))))))
+
+;;; Converts evidence given by node and value index to names
+(defun resolve-evidence (evidence)
+  (mapcar #'(lambda (e)
+	      (if (integerp (first e))
+		  (let* ((name (node-name-at *network* (first e)))
+			 (vals (vals (get-node *network* name))))
+		    (unless (and (integerp (second e))
+				 (< -1 (second e) (length vals)))
+		      (error (format nil "Value index ~A out of range in node ~A"
+				     (second e) name)))
+		    (list name (nth (second e) vals)))
+		  e))
+	  evidence))
+
+;;; Packs marginals of query result in one vector - values of every node in
+;;; order in which client sent nodes
+(defun pack-result (result)
+  (let ((marginals (make-hash-table :test #'equal))
+	(packed (make-array 0 :element-type 'double-float
+			    :adjustable t :fill-pointer 0)))
+    (dolist (node result)
+      (setf (gethash (first node) marginals) (second node)))
+    (loop for name across (slot-value *network* 'order)
+       do (let ((node-vals (gethash name marginals)))
+	    (dolist (val (vals (get-node *network* name)))
+	      (vector-push-extend
+	       (coerce (or (second (assoc val node-vals :test #'equal)) 0)
+		       'double-float)
+	       packed))))
+    packed))
 
 ;;; Does inference on network
 (defun query (options)
@@ -62,21 +584,26 @@
 	 (algorithm-method (second algorithm))
 	 (param-required (third algorithm))
 	 (param (when param-required (second options)))
-	 (evidence (if param-required (cddr options) (cdr options)))
+	 (evidence (resolve-evidence
+		    (if param-required (cddr options) (cdr options))))
 	 (all-params (append (if param-required (list *network* param)
 				 (list *network*))
 			     evidence)))
-    (multiple-value-bind (result time iterations)
+    (multiple-value-bind (result time iterations chosen)
 	(apply algorithm-method all-params)
-      (dolist (node result)
-	(dolist (val (second node))
-	  (output "SETVAL" (first node) (first val) (second val))))
+      (let ((packed (pack-result result)))
+	(output "QUERY-RESULT" (if (eq *protocol* :binary)
+				   packed
+				   (coerce packed 'list))))
+      (when chosen
+	(output "CHOSEN-ALGORITHM" chosen))
       (output "QUERY-DONE")
       (output "INFO"
-	      (if iterations
-		  (format nil "Query done in ~Fs (~D iterations)."
-			  time iterations)
-		  (format nil "Query done in ~Fs." time))))))
+	      (format nil "~@[~A: ~]~A" chosen
+		      (if iterations
+			  (format nil "Query done in ~Fs (~D iterations)."
+				  time iterations)
+			  (format nil "Query done in ~Fs." time)))))))
 	  
 
 (defun list-algorithms ()
@@ -88,38 +615,362 @@
 	 (setf *diff-small-value* value))
 	((equal name "diff-check-period")
 	 (setf *diff-check-period* value))
+	((equal name "gibbs-warm-burn-in")
+	 (setf *gibbs-warm-burn-in* value))
+	((equal name "sample-pool-size")
+	 (setf *sample-pool-size* value))
+	((equal name "sample-reuse-min-ess")
+	 (setf *sample-reuse-min-ess* value))
+	((equal name "auto-accuracy")
+	 (setf *auto-accuracy* value))
+	((equal name "auto-memory-budget")
+	 (setf *auto-memory-budget* value))
+	((equal name "auto-exact-width")
+	 (setf *auto-exact-width* value))
+	((equal name "shared-memory-threshold")
+	 (setf *shared-memory-threshold* value))
+	((equal name "libbayes-path")
+	 (setf *libbayes-path* value))
 	(t (output-error (format nil "Unknown option ~A" name)))))
 
-(defun main ()
-  ;; Greet
+;;; Monitoring ;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+
+;;; Native library monitoring is done by (libbayes, loaded by first
+;;; monitor-start); GUI can point to it with libbayes-path option
+(defparameter *libbayes-path* "libbayes.so")
+(defparameter *libbayes-loaded* nil)
+
+;;; Copy of network monitored by client in native library (NIL when client
+;;; does not monitor). Evidence changes recompute only posteriors they
+;;; affect and only posteriors which changed by more than threshold are sent.
+(defparameter *monitor* nil)
+
+(defmacro libbayes (name result-type &rest args)
+  "Calls function of native library; args are alternating types and values"
+  `(sb-alien:alien-funcall
+    (sb-alien:extern-alien ,name (function ,result-type
+					   ,@(loop for (type nil) on args
+						by #'cddr collect type)))
+    ,@(loop for (nil value) on args by #'cddr collect value)))
+
+(defun load-libbayes ()
+  "Loads native library unless it is loaded already"
+  (unless *libbayes-loaded*
+    (sb-alien:load-shared-object *libbayes-path*)
+    (setf *libbayes-loaded* t)))
+
+(defun monitor-node (name)
+  "Returns index of monitored node"
+  (let ((node (libbayes "bayes_node_index" sb-alien:int
+			sb-alien:system-area-pointer *monitor*
+			sb-alien:c-string name)))
+    (when (< node 0)
+      (error (format nil "Unknown node ~A" name)))
+    node))
+
+(defun monitor-value (node name value)
+  "Returns index of value of monitored node (-1 for NIL)"
+  (if (null value)
+      -1
+      (let ((index (libbayes "bayes_value_index" sb-alien:int
+			     sb-alien:system-area-pointer *monitor*
+			     sb-alien:int node
+			     sb-alien:c-string value)))
+	(when (< index 0)
+	  (error (format nil "Unknown value ~A of node ~A" value name)))
+	index)))
+
+(defun output-monitor-update ()
+  "Outputs posteriors of watched nodes which changed enough since they were
+sent last"
+  (let* ((size (libbayes "bayes_node_count" sb-alien:int
+			 sb-alien:system-area-pointer *monitor*))
+	 (nodes (sb-alien:make-alien sb-alien:int (max size 1)))
+	 (p nil))
+    (unwind-protect
+	 (let ((count (libbayes "bayes_update" sb-alien:int
+				sb-alien:system-area-pointer *monitor*
+				(* sb-alien:int) nodes
+				sb-alien:int (max size 1))))
+	   (dotimes (i count)
+	     (let* ((node (sb-alien:deref nodes i))
+		    (n (libbayes "bayes_value_count" sb-alien:int
+				 sb-alien:system-area-pointer *monitor*
+				 sb-alien:int node)))
+	       (setf p (sb-alien:make-alien sb-alien:double n))
+	       (libbayes "bayes_marginal" sb-alien:int
+			 sb-alien:system-area-pointer *monitor*
+			 sb-alien:int node
+			 (* sb-alien:double) p
+			 sb-alien:int n)
+	       (apply #'output "MONITOR-POSTERIOR"
+		      (libbayes "bayes_node_name" sb-alien:c-string
+				sb-alien:system-area-pointer *monitor*
+				sb-alien:int node)
+		      (loop for v below n collect (sb-alien:deref p v)))
+	       (sb-alien:free-alien p)
+	       (setf p nil))))
+      (when p
+	(sb-alien:free-alien p))
+      (sb-alien:free-alien nodes)))
+  (output "MONITOR-DONE"))
+
+(defun free-monitor ()
+  "Frees network monitored by client"
+  (when *monitor*
+    (libbayes "bayes_free" sb-alien:void
+	      sb-alien:system-area-pointer *monitor*)
+    (setf *monitor* nil)))
+
+(defun monitor-start (threshold &rest names)
+  "Starts monitoring nodes (all of them if none is given) of current network;
+posteriors are sent right away and then after evidence changes"
+  (unless *network*
+    (error "No network to monitor"))
+  (load-libbayes)
+  (free-monitor)
+  ;; Network is handed to native library as .net text in memory
+  (let ((data (sb-ext:string-to-octets
+	       (prin1-to-string (print-bayes-network *network*))
+	       :external-format :utf-8))
+	(message (sb-alien:make-alien sb-alien:char 256)))
+    (unwind-protect
+	 (let ((net (sb-sys:with-pinned-objects (data)
+		      (libbayes "bayes_load_data" sb-alien:system-area-pointer
+				sb-alien:system-area-pointer
+				(sb-sys:vector-sap data)
+				sb-alien:int (length data)
+				(* sb-alien:char) message
+				sb-alien:int 256))))
+	   (when (zerop (sb-sys:sap-int net))
+	     (error (format nil "Cannot monitor network: ~A"
+			    (sb-alien:cast message sb-alien:c-string))))
+	   (setf *monitor* net))
+      (sb-alien:free-alien message)))
+  (libbayes "bayes_set_threshold" sb-alien:void
+	    sb-alien:system-area-pointer *monitor*
+	    sb-alien:double (coerce (or threshold 0) 'double-float))
+  (if names
+      (dolist (name names)
+	(libbayes "bayes_watch" sb-alien:int
+		  sb-alien:system-area-pointer *monitor*
+		  sb-alien:int (monitor-node name)))
+      (dotimes (node (libbayes "bayes_node_count" sb-alien:int
+			       sb-alien:system-area-pointer *monitor*))
+	(libbayes "bayes_watch" sb-alien:int
+		  sb-alien:system-area-pointer *monitor*
+		  sb-alien:int node)))
+  (output-monitor-update))
+
+(defun monitor-evidence (&rest changes)
+  "Applies evidence changes given as (node value) lists (value NIL removes
+evidence of node) and sends posteriors they changed"
+  (unless *monitor*
+    (error "Monitoring is not started"))
+  (dolist (change changes)
+    (let ((node (monitor-node (first change))))
+      (libbayes "bayes_set_evidence" sb-alien:int
+		sb-alien:system-area-pointer *monitor*
+		sb-alien:int node
+		sb-alien:int (monitor-value node (first change)
+					    (second change)))))
+  (output-monitor-update))
+
+(defun monitor-stop ()
+  "Stops monitoring"
+  (free-monitor)
+  (output "INFO" "Monitoring stopped."))
+
+;;; Runs query - in query thread if there is one, otherwise right away
+;;; (cancel commands are then read by poll-cancel)
+(defun run-query (options)
+  #+sb-thread (queue-query options)
+  #-sb-thread (let ((*cancel-check* #'poll-cancel))
+		(query options)))
+
+;;; Executes one command; returns NIL when engine should quit
+(defun execute-command (input)
+  (let ((cmd (first input))
+	(options (rest input)))
+    (cond ((eql cmd 'quit) (return-from execute-command nil))
+	  ((eql cmd 'load-network) (load-network options))
+	  ((eql cmd 'update-network) (update-network options))
+	  ((eql cmd 'select-network) (select-network (first options)))
+	  ((eql cmd 'forget-network) (forget-network (first options)))
+	  ((eql cmd 'query) (run-query options))
+	  ((eql cmd 'cancel)
+	   ;; Without query thread nothing is running when cancel is read here
+	   #+sb-thread (cancel-request (first options)))
+	  ((eql cmd 'algorithms) (list-algorithms))
+	  ((eql cmd 'set-protocol) (set-protocol (first options)))
+	  ((eql cmd 'set-option) (set-option (first options)
+					     (second options)))
+	  ((eql cmd 'monitor-start) (apply #'monitor-start options))
+	  ((eql cmd 'monitor-evidence) (apply #'monitor-evidence options))
+	  ((eql cmd 'monitor-stop) (monitor-stop))
+	  (t (error (format nil "Unknown command: ~A" cmd))))
+    t))
+
+;;; Daemon ;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+
+;;; Variables holding state of one client. Engine run as daemon gives every
+;;; client connecting to its socket own values (networks read from files are
+;;; shared though).
+(defparameter *client-specials*
+  '(*network* *networks* *session* *pending-commands* *request-id*
+    *protocol* *binary-input* *binary-output* *input-fd* *output-fd*
+    *standard-input* *standard-output* *shared-memory-threshold*
+    *diff-small-value* *diff-check-period* *gibbs-warm-burn-in*
+    *sample-pool-size* *sample-reuse-min-ess* *auto-accuracy*
+    *auto-memory-budget* *auto-exact-width* *monitor*
+    #+sb-thread *output-lock* #+sb-thread *queries*))
+
+(defun client-function (function)
+  "Returns function calling function with values client variables have in
+current thread (new threads do not see bindings of thread creating them).
+Values are copied, so only objects shared by reference (like query-state)
+are seen by both threads afterwards."
+  (let ((values (mapcar #'symbol-value *client-specials*)))
+    #'(lambda ()
+	(progv *client-specials* values
+	  (funcall function)))))
+
+(defun serve ()
+  "Greets client and executes its commands until it quits"
   (output "INFO" "Bayes engine v0.1 up and running!")
 
-  ;; Main loop
   (block main-loop
     (loop
-       (handler-case
-	   (progn
-	     (clear-output)
-	     (let* ((input (read))
-		    (cmd (first input))
-		    (options (rest input)))
-	       (cond ((eql cmd 'quit) (return-from main-loop))
-		     ((eql cmd 'load-network) (load-network options))
-		     ((eql cmd 'load-file) (apply #'load-network-from-file
-						  options))
-		     ((eql cmd 'save-file) (save-file (first options)))
-		     ((eql cmd 'query) (query options))
-		     ((eql cmd 'algorithms) (list-algorithms))
-		     ((eql cmd 'set-option) (set-option (first options)
-							(second options)))
-		     (t (error (format nil "Unknown command: ~A" cmd))))))
-	 (simple-condition (condt)
-	   (output-error
-	    (apply #'format nil (append 
-				 (list (simple-condition-format-control condt))
-				 (simple-condition-format-arguments condt)))))
-	 (error (condition) (output-error "Unexpected error"))))))
-  
+       (let ((*request-id* 0))
+	 (with-command-errors
+	   (let ((input (if *pending-commands*
+			    (pop *pending-commands*)
+			    (read-command))))
+	     (multiple-value-bind (id command) (split-request input)
+	       (setf *request-id* id)
+	       (unless (execute-command command)
+		 (return-from main-loop))))))))
+
+  ;; Query thread must not outlive client
+  #+sb-thread (stop-query-thread)
+  (free-monitor))
+
+(defun peer-uid (fd)
+  "Returns user id of process on other end of local socket (NIL if it is not
+known)"
+  ;; struct ucred (pid, uid, gid) of SO_PEERCRED (17) at SOL_SOCKET (1)
+  #+linux
+  (sb-alien:with-alien ((cred (array (sb-alien:unsigned 32) 3))
+			(len sb-alien:unsigned-int 12))
+    (when (zerop (sb-alien:alien-funcall
+		  (sb-alien:extern-alien
+		   "getsockopt"
+		   (function sb-alien:int sb-alien:int sb-alien:int
+			     sb-alien:int (* (array (sb-alien:unsigned 32) 3))
+			     (* sb-alien:unsigned-int)))
+		  fd 1 17 (sb-alien:addr cred) (sb-alien:addr len)))
+      (sb-alien:deref cred 1)))
+  #-linux
+  (sb-alien:with-alien ((uid sb-alien:unsigned-int)
+			(gid sb-alien:unsigned-int))
+    (when (zerop (sb-alien:alien-funcall
+		  (sb-alien:extern-alien
+		   "getpeereid"
+		   (function sb-alien:int sb-alien:int
+			     (* sb-alien:unsigned-int)
+			     (* sb-alien:unsigned-int)))
+		  fd (sb-alien:addr uid) (sb-alien:addr gid)))
+      uid)))
+
+(defun serve-client (socket)
+  "Serves client connected to daemon socket with fresh state; clients of
+other users are refused (they could read and write files as daemon user)"
+  (let ((fd (sb-bsd-sockets:socket-file-descriptor socket)))
+    (unless (eql (peer-uid fd) (sb-posix:getuid))
+      (format t "Refused client of other user~%")
+      (finish-output)
+      (sb-bsd-sockets:socket-close socket)
+      (return-from serve-client))
+    (progv *client-specials* (mapcar #'symbol-value *client-specials*)
+      (setf *network* nil
+	    *networks* (make-hash-table)
+	    *session* 0
+	    *pending-commands* nil
+	    *protocol* :sexp
+	    *binary-input* nil
+	    *binary-output* nil
+	    *input-fd* fd
+	    *output-fd* fd
+	    *standard-input* (sb-sys:make-fd-stream fd :input t
+						     :buffering :full
+						     :external-format :utf-8)
+	    *standard-output* (sb-sys:make-fd-stream fd :output t
+						      :buffering :full
+						      :external-format :utf-8)
+	    *shared-memory-threshold* 0
+	    *monitor* nil)
+      #+sb-thread
+      (setf *output-lock* (sb-thread:make-mutex :name "output")
+	    *queries* (make-query-state))
+      (unwind-protect (serve)
+	(sb-bsd-sockets:socket-close socket)))))
+
+(defun default-daemon-path ()
+  "Returns socket path in per-user runtime directory, or in new private
+directory if there is none; second value is that new directory"
+  (let ((runtime (sb-ext:posix-getenv "XDG_RUNTIME_DIR")))
+    (if (and runtime (> (length runtime) 0))
+	(values (concatenate 'string runtime "/bayes-engine") nil)
+	(let ((dir (sb-posix:mkdtemp "/tmp/bayes-engine-XXXXXX")))
+	  (values (concatenate 'string dir "/socket") dir)))))
+
+(defun file-exists-p (path)
+  "Checks if there is anything (even dangling link) at path"
+  (handler-case (progn (sb-posix:lstat path) t)
+    (sb-posix:syscall-error () nil)))
+
+(defun run-daemon (&optional path)
+  "Serves every client of same user connecting to local socket at path, or
+at default-daemon-path if it is not given (each client in own thread if
+threads are supported). Existing file at path is never replaced."
+  (multiple-value-bind (path dir) (if path
+				      (values path nil)
+				      (default-daemon-path))
+    (when (file-exists-p path)
+      (format *error-output* "~A already exists (remove it if no daemon ~
+uses it)~%" path)
+      (sb-ext:exit :code 1))
+    (let ((server (make-instance 'sb-bsd-sockets:local-socket :type :stream))
+	  (umask (sb-posix:umask #o077)))
+      (unwind-protect
+	   (sb-bsd-sockets:socket-bind server path)
+	(sb-posix:umask umask))
+      (sb-bsd-sockets:socket-listen server 16)
+      (format t "Bayes engine daemon listening on ~A~%" path)
+      (finish-output)
+      (unwind-protect
+	   (loop
+	      (let ((client (sb-bsd-sockets:socket-accept server)))
+		#+sb-thread (sb-thread:make-thread
+			     #'(lambda () (serve-client client)) :name "client")
+		#-sb-thread (serve-client client)))
+	(sb-bsd-sockets:socket-close server)
+	(sb-posix:unlink path)
+	(when dir
+	  (sb-posix:rmdir dir))))))
+
+(defun main ()
+  ;; Numbers GUI sends are doubles and are printed back as such
+  (setf *read-default-float-format* 'double-float)
+
+  ;; Engine serves GUI on standard input and output, or any number of GUI
+  ;; and other clients of same user as daemon (bayes-cmd --daemon
+  ;; [socket-path])
+  (let ((args sb-ext:*posix-argv*))
+    (if (equal (second args) "--daemon")
+	(run-daemon (third args))
+	(serve))))
+
 ;;; Make sure everything is on display
 (clear-output)
 
@@ -54,7 +54,13 @@
   ((name :initarg :name
 	 :initform (error "Network name not specified")
 	 :accessor name)
-  (nodes :initform nil)))
+  (nodes :initform nil)
+  (order :initform nil) ; Node names in order client knows them
+  (gibbs-state :initform nil)
+  (sample-pool :initform nil)
+  ;; Elimination order and its width, found once for network (changes
+  ;; create new network, so it never gets stale)
+  (elimination :initform nil)))
 
 ;;; Class representing node in Bayes network
 (defclass node nil
@@ -80,6 +86,13 @@ v   (meta :initarg :meta
 (defmethod get-node ((net network) name)
   (cdr (assoc name (slot-value net 'nodes) :test #'equal)))
 
+(defun node-name-at (net index)
+  "Gets name of node with index in order in which client sent nodes"
+  (let ((order (slot-value net 'order)))
+    (unless (and (integerp index) (< -1 index (length order)))
+      (error (format nil "Node index ~A out of range" index)))
+    (svref order index)))
+
 (defgeneric get-nodes (net &rest names) (:documentation "Gets list of nodes from network by names"))
 (defmethod get-nodes ((net network) &rest names)
   (remove-duplicates 
@@ -161,6 +174,18 @@ v   (meta :initarg :meta
 
 (defparameter *inference-algorithms* nil "Global list of all available algorithms")
 
+;;; Signalled from safe point when running query should be stopped
+(define-condition query-cancelled (error) ())
+
+(defparameter *cancel-check* nil
+  "Function called on safe points inside inference loops; it should signal
+query-cancelled when running query has to be stopped")
+
+(defun check-cancel ()
+  "Safe point of inference algorithm - query can be cancelled here"
+  (when *cancel-check*
+    (funcall *cancel-check*)))
+
 (defun evidence-value (name evidence)
   "Extracts value from eviddence for given name"
   (second (assoc name evidence :test #'equal)))
@@ -197,6 +222,7 @@ algorithm; full enumeration algorithm uses this method on every node"))
     ;; Recursive function for enumeration
     (labels
 	((calculate-p (loops evidence)
+	   (check-cancel)
 	   (cond ((> (length loops) 0) ; Loop more variables
 		  (loop for val in (vals (get-node net (first loops)))
 		     summing (calculate-p (rest loops)
@@ -310,6 +336,16 @@ Markov Blanket values"))
 (defparameter *diff-small-value* 0.0005 "Sampling global parameters")
 (defparameter *diff-check-period* (round (/ *diff-small-value*))
   "Sampling global parameters")
+(defparameter *gibbs-warm-burn-in* 100
+  "Number of sweeps discarded when Gibbs chain of previous query is resumed
+with different evidence")
+
+(defun evidence-equal (e1 e2)
+  "Checks if two evidence lists set same values on same nodes"
+  (and (= (length e1) (length e2))
+       (every #'(lambda (e)
+		  (equal (second e) (evidence-value (first e) e2)))
+	      e1)))
 
 (defgeneric gibbs-sampling (net n &rest evidence)
   (:documentation "Calculate all probabilities in network using
@@ -321,48 +357,131 @@ gibbs sampling algorithm"))
 	 (evidence-names (mapcar #'car evidence))
 	 (nonevidence-names (set-difference node-names evidence-names
 					    :test #'equal))
-	 (value-counter (make-value-counter net))
+	 (state (slot-value net 'gibbs-state))
+	 (resume (and state (evidence-equal evidence (getf state :evidence))))
+	 (value-counter (if resume
+			    (getf state :counter)
+			    (make-value-counter net)))
 	 (current-vals evidence)
 	 (done 0))
+    ;; Chain continues from state of previous query (with new evidence
+    ;; clamped); without previous state values are chosen randomly
     (dolist (node-name nonevidence-names)
       (setf current-vals
 	    (append-items current-vals
-			  (list node-name (random-element
-					   (vals (get-node net node-name)))))))
-    (do* ((old-probs nil)
-	  (probs nil)
-	  (new-vals nil nil)
-	  (sample))
-	 ((when (> n 0) (>= done n)))
-      (incf done)
-      (dolist (node-name node-names)
-	(let ((evidence-p (member node-name evidence-names :test #'equal)))
-	  (setf sample
-		(if evidence-p
-		    (second (assoc node-name evidence :test #'equal))
-		    (sample-node-mb net node-name current-vals)))
-	  (push (list node-name sample) new-vals)
-	  ;(setf current-vals (assoc-replace current-vals node-name sample))
-	  ;(update-value-counter value-counter node-name sample)
-	  ))
-      (setf current-vals new-vals)
-      (dolist (node-name node-names)
-	(update-value-counter
-	 value-counter node-name (second (assoc node-name
-						current-vals :test #'equal))))
-      (when (zerop (mod done *diff-check-period*))
-	(setf old-probs probs)
-	(setf probs (normalize-values value-counter))
-	(when (and old-probs
-		   (<= (prob-diff probs old-probs) *diff-small-value*))
-	  (return))))
+			  (list node-name
+				(or (and state
+					 (evidence-value node-name
+							 (getf state :vals)))
+				    (random-element
+				     (vals (get-node net node-name))))))))
+    (flet ((sweep (vals)
+	     (let ((new-vals nil))
+	       (dolist (node-name node-names new-vals)
+		 (push (list node-name
+			     (if (member node-name evidence-names :test #'equal)
+				 (evidence-value node-name evidence)
+				 (sample-node-mb net node-name vals)))
+		       new-vals)))))
+      ;; Evidence changed since chain was stopped - discard short burn-in
+      (when (and state (not resume))
+	(dotimes (i *gibbs-warm-burn-in*)
+	  (declare (ignorable i))
+	  (check-cancel)
+	  (setf current-vals (sweep current-vals))))
+      (unwind-protect
+	   (do* ((old-probs nil)
+		 (probs nil))
+		((when (> n 0) (>= done n)))
+	     (check-cancel)
+	     (incf done)
+	     (setf current-vals (sweep current-vals))
+	     (dolist (node-name node-names)
+	       (update-value-counter
+		value-counter node-name (evidence-value node-name current-vals)))
+	     (when (zerop (mod done *diff-check-period*))
+	       (setf old-probs probs)
+	       (setf probs (normalize-values value-counter))
+	       (when (and old-probs
+			  (<= (prob-diff probs old-probs) *diff-small-value*))
+		 (return))))
+	;; Keep chain (even of cancelled query) so next query can resume it
+	(setf (slot-value net 'gibbs-state)
+	      (list :vals current-vals :evidence evidence
+		    :counter value-counter))))
     (values (normalize-values value-counter)
 	    (* 1.0 (/ (- (get-internal-run-time) start-time)
-		      internal-time-units-per-second)) done)))	        
+		      internal-time-units-per-second)) done)))
 
 ;; Add new algorithm to list of algorithms
 (push `("Gibbs sampling" ,#'gibbs-sampling t) *inference-algorithms*)
 
+(defparameter *sample-pool-size* 10000
+  "Maximal number of samples kept for reuse by sampling algorithms")
+(defparameter *sample-reuse-min-ess* 1000
+  "Stored samples are used for query only if their effective sample size
+under new evidence is at least this big (or N if it is smaller)")
+
+;;; Samples kept from previous queries; each one is (vals weight batch) where
+;;; batch is (clamp scale) - evidence the sample was drawn under and weight
+;;; scale of whole batch (NIL while batch is not finished)
+(defstruct sample-pool
+  (samples (make-array *sample-pool-size* :initial-element nil))
+  (next 0))
+
+(defun network-sample-pool (net)
+  "Gets sample pool of network, creating new one if needed"
+  (with-slots (sample-pool) net
+    (unless (and sample-pool
+		 (= (length (sample-pool-samples sample-pool))
+		    (max *sample-pool-size* 0)))
+      (setf sample-pool (make-sample-pool :samples
+					  (make-array (max *sample-pool-size* 0)
+						      :initial-element nil))))
+    sample-pool))
+
+(defun pool-add-sample (pool vals weight batch)
+  "Stores sample into pool, overwriting the oldest one when pool is full"
+  (let ((samples (sample-pool-samples pool)))
+    (when (> (length samples) 0)
+      (setf (aref samples (sample-pool-next pool)) (list vals weight batch))
+      (setf (sample-pool-next pool)
+	    (mod (1+ (sample-pool-next pool)) (length samples))))))
+
+(defun sample-usable-p (sample evidence)
+  "Checks if stored sample can be reweighted for evidence: it has to agree
+with evidence and evidence has to fix every node it was clamped on"
+  (destructuring-bind (vals weight batch) sample
+    (declare (ignore weight))
+    (and (second batch)
+	 (every #'(lambda (e)
+		    (equal (second e) (evidence-value (first e) evidence)))
+		(first batch))
+	 (every #'(lambda (e)
+		    (equal (second e) (evidence-value (first e) vals)))
+		evidence))))
+
+(defun reuse-samples (net n evidence)
+  "Answers query from stored samples reweighted under new evidence; returns
+value counter or NIL if their effective sample size is too small"
+  (let ((counter (make-value-counter net))
+	(sum 0.0)
+	(sum2 0.0))
+    (loop for sample across (sample-pool-samples (network-sample-pool net))
+       when (and sample (sample-usable-p sample evidence))
+       do (let ((w (* (second sample) (second (third sample)))))
+	    (check-cancel)
+	    (incf sum w)
+	    (incf sum2 (* w w))
+	    (dolist (val (first sample))
+	      (update-value-counter counter (first val) (second val) w))))
+    (let ((ess (if (> sum2 0) (/ (* sum sum) sum2) 0))
+	  (needed (if (> n 0)
+		      (min n *sample-reuse-min-ess*)
+		      *sample-reuse-min-ess*)))
+      (when (and (> ess 0) (>= ess needed))
+	counter))))
+
 (defgeneric rejection-sampling (net n &rest evidence)
   (:documentation "Calculate all probabilities in network using
 rejection samppling algorithm"))
@@ -372,11 +491,22 @@ rejection samppling algorithm"))
 	 (evidence-names (mapcar #'car evidence))
 	 (node-names (get-node-names net))
 	 (done 0)
-	 (value-counter (make-value-counter net)))
+	 (accepted 0)
+	 (value-counter (make-value-counter net))
+	 (reused (reuse-samples net n evidence))
+	 (pool (network-sample-pool net))
+	 (batch (list evidence nil)))
+    ;; Stored samples are good enough - no new sampling needed
+    (when reused
+      (return-from rejection-sampling
+	(values (normalize-values reused)
+		(* 1.0 (/ (- (get-internal-run-time) start-time)
+			  internal-time-units-per-second)) 0)))
     (do* ((old-probs nil)
 	  (current-vals nil nil)
 	  (probs nil))
 	 ((when (> n 0) (>= done n)))
+      (check-cancel)
       (block iteration
 	(incf done)
 	(dolist (node node-names)
@@ -386,6 +516,8 @@ rejection samppling algorithm"))
 		(setf current-vals 
 		      (append-items current-vals (list node sample)))
 		(return-from iteration))))
+	(incf accepted)
+	(pool-add-sample pool current-vals 1.0 batch)
 	(dolist (val current-vals)
 	  (update-value-counter value-counter (first val) (second val))))
       (when (zerop (mod done *diff-check-period*))
@@ -394,6 +526,10 @@ rejection samppling algorithm"))
 	(when (and old-probs 
 		   (<= (prob-diff probs old-probs) *diff-small-value*))
 	  (return))))
+    ;; Accepted samples are weighted by acceptance rate (estimate of evidence
+    ;; probability) so they can be mixed with samples from other queries
+    (when (> done 0)
+      (setf (second batch) (* 1.0 (/ accepted done))))
     (values (normalize-values value-counter)
 	    (* 1.0 (/ (- (get-internal-run-time) start-time)
 	       internal-time-units-per-second)) done)))
@@ -410,13 +546,23 @@ likelihood weighting algorithm"))
 	(evidence-names (mapcar #'car evidence))
 	(node-names (get-node-names net))
 	(value-counter (make-value-counter net))
-	(done 0))
+	(done 0)
+	(reused (reuse-samples net n evidence))
+	(pool (network-sample-pool net))
+	(batch (list evidence 1.0)))
+    ;; Stored samples are good enough - no new sampling needed
+    (when reused
+      (return-from likelihood-weighting
+	(values (normalize-values reused)
+		(* 1.0 (/ (- (get-internal-run-time) start-time)
+			  internal-time-units-per-second)) 0)))
     (do* ((old-probs nil)
 	  (current-vals nil nil)
 	  (w 1.0 1.0)
 	  (probs nil)
 	  (sample))
 	 ((when (> n 0) (>= done n)))
+      (check-cancel)
       (incf done)
       (dolist (node node-names)
 	(let ((evidence-p (member node evidence-names :test #'equal)))
@@ -428,6 +574,8 @@ likelihood weighting algorithm"))
 	  (when evidence-p 
 	    (setf w (* w (apply #'probability
 				(append (list net node) current-vals)))))))
+      (when (> w 0)
+	(pool-add-sample pool current-vals w batch))
       (dolist (val current-vals)
 	(update-value-counter value-counter (first val) (second val) w))
       (when (zerop (mod done *diff-check-period*))
@@ -444,6 +592,341 @@ likelihood weighting algorithm"))
 ;;; Add new algorithm to list of algorithms
 (push `("Likelihood weighting" ,#'likelihood-weighting t) *inference-algorithms*)
 
+;;; Factors of variable elimination are lists (variables cardinalities table)
+;;; with table of doubles ordered like node tables (last variable changes
+;;; fastest)
+
+(defun node-factor (net name)
+  "Creates factor of node table"
+  (let* ((node (get-node net name))
+	 (vars (append-items (parents node) name)))
+    (list vars
+	  (mapcar #'(lambda (x) (length (vals (get-node net x)))) vars)
+	  (map '(simple-array double-float (*))
+	       #'(lambda (p) (coerce p 'double-float)) (table node)))))
+
+(defun evidence-factor (net name value)
+  "Creates factor which is 1 for observed value of node and 0 otherwise"
+  (let* ((vals (vals (get-node net name)))
+	 (table (make-array (length vals) :element-type 'double-float
+			    :initial-element 0d0)))
+    (setf (aref table (position value vals :test #'equal)) 1d0)
+    (list (list name) (list (length vals)) table)))
+
+(defun factor-strides (factor vars)
+  "Returns steps by which index into factor table moves when each of vars
+is incremented (0 for variables factor does not depend on)"
+  (let ((strides (make-array (length vars) :initial-element 0))
+	(step 1))
+    (loop for v in (reverse (first factor))
+       for c in (reverse (second factor))
+       do (setf (aref strides (position v vars :test #'equal)) step)
+	 (setf step (* step c)))
+    strides))
+
+(defun factor-product (factors)
+  "Multiplies factors into one factor over all their variables"
+  (let ((vars nil)
+	(cards nil))
+    (dolist (f factors)
+      (loop for v in (first f)
+	 for c in (second f)
+	 unless (member v vars :test #'equal)
+	 do (push v vars)
+	   (push c cards)))
+    (setf vars (nreverse vars)
+	  cards (nreverse cards))
+    (let* ((n (length vars))
+	   (size (reduce #'* cards))
+	   (dims (coerce cards 'simple-vector))
+	   (counter (make-array n :initial-element 0))
+	   (table (make-array size :element-type 'double-float
+			      :initial-element 1d0)))
+      ;; Entries are visited in order and index into factor is moved along
+      ;; (counter wraps back to zeros after last entry)
+      (dolist (f factors)
+	(let ((strides (factor-strides f vars))
+	      (ftable (third f))
+	      (index 0))
+	  (dotimes (i size)
+	    (setf (aref table i) (* (aref table i) (aref ftable index)))
+	    (loop for k from (1- n) downto 0
+	       do (incf index (aref strides k))
+		 (if (< (incf (aref counter k)) (aref dims k))
+		     (return)
+		     (progn
+		       (decf index (* (aref strides k) (aref dims k)))
+		       (setf (aref counter k) 0)))))))
+      (list vars cards table))))
+
+(defun factor-sum-out (factor var)
+  "Sums factor over values of variable"
+  (destructuring-bind (vars cards table) factor
+    (let* ((k (position var vars :test #'equal))
+	   (card (nth k cards))
+	   (inner (reduce #'* (nthcdr (1+ k) cards)))
+	   (outer (/ (length table) (* card inner)))
+	   (result (make-array (* outer inner) :element-type 'double-float
+			       :initial-element 0d0)))
+      (dotimes (o outer)
+	(dotimes (c card)
+	  (dotimes (i inner)
+	    (incf (aref result (+ (* o inner) i))
+		  (aref table (+ (* (+ (* o card) c) inner) i))))))
+      (list (append (subseq vars 0 k) (nthcdr (1+ k) vars))
+	    (append (subseq cards 0 k) (nthcdr (1+ k) cards))
+	    result))))
+
+(defun eliminate (factors order)
+  "Sums variables out of factors in order; returns product of what remains"
+  (dolist (var order)
+    (check-cancel)
+    (let ((with (remove-if-not #'(lambda (f)
+				   (member var (first f) :test #'equal))
+			       factors)))
+      (when with
+	(setf factors
+	      (cons (factor-sum-out (factor-product with) var)
+		    (remove-if #'(lambda (f) (member f with :test #'eq))
+			       factors))))))
+  (factor-product factors))
+
+(defgeneric variable-elimination (net &rest evidence)
+  (:documentation "Calculate all probabilities in network exactly by summing
+out other nodes in elimination order of network; time and memory grow
+exponentially with treewidth only"))
+(defmethod variable-elimination ((net network) &rest evidence)
+  (let ((start-time (get-internal-run-time))
+	(order (network-elimination net))
+	(factors (mapcar #'(lambda (name) (node-factor net name))
+			 (get-node-names net))))
+    (dolist (e evidence)
+      (push (evidence-factor net (first e) (second e)) factors))
+    (values
+     (normalize-values
+      (loop for name in (get-node-names net)
+	 collecting
+	   (let ((f (eliminate factors (remove name order :test #'equal))))
+	     (list name
+		   (loop for val in (vals (get-node net name))
+		      for p across (third f)
+		      collecting (list val p))))))
+     (* 1.0 (/ (- (get-internal-run-time) start-time)
+	       internal-time-units-per-second)) nil)))
+
+;;; Add new algorithm to list of algorithms
+(push `("Variable elimination" ,#'variable-elimination nil)
+      *inference-algorithms*)
+
+;;; Automatic algorithm selection ;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+
+(defparameter *auto-accuracy* 0.01
+  "Wanted maximal error of probabilities calculated by sampling algorithms")
+(defparameter *auto-memory-budget* (* 256 1024 1024)
+  "Memory (in bytes) algorithm chosen automatically is allowed to use")
+(defparameter *auto-pilot-samples* 200
+  "Number of samples used to estimate evidence likelihood")
+(defparameter *auto-gibbs-mixing* 10
+  "Assumed number of Gibbs sweeps per one independent sample")
+(defparameter *auto-exact-width* 12
+  "Networks with treewidth below this are queried exactly (by variable
+elimination) if its tables fit into memory budget")
+
+(defun moral-graph (net)
+  "Creates moral graph of network as list of (name . neighbour-names)"
+  (let ((graph (mapcar #'list (get-node-names net))))
+    (flet ((link (a b)
+	     (unless (equal a b)
+	       (pushnew b (cdr (assoc a graph :test #'equal)) :test #'equal)
+	       (pushnew a (cdr (assoc b graph :test #'equal)) :test #'equal))))
+      (dolist (name (get-node-names net))
+	(let ((parents (parents (get-node net name))))
+	  (dolist (parent parents)
+	    (link name parent)
+	    (dolist (other parents)
+	      (link parent other))))))
+    graph))
+
+(defun fill-in-count (graph neighbours)
+  "Counts edges which elimination of node with given neighbours would add"
+  (loop for (a . rest) on neighbours
+     summing (loop for b in rest
+		count (not (member b (cdr (assoc a graph :test #'equal))
+				   :test #'equal)))))
+
+(defun min-fill-elimination (net)
+  "Finds min-fill elimination order of network; returns order, its width
+(estimate of treewidth), sum and maximum of sizes of tables it creates"
+  (let ((graph (moral-graph net))
+	(order nil)
+	(width 0)
+	(cost 0)
+	(largest 0))
+    (loop while graph
+       do (let ((best nil)
+		(best-fill nil))
+	    (dolist (entry graph)
+	      (let ((fill (fill-in-count graph (cdr entry))))
+		(when (or (null best-fill) (< fill best-fill))
+		  (setf best entry
+			best-fill fill))))
+	    (let* ((neighbours (cdr best))
+		   (size (reduce #'* (mapcar #'(lambda (x)
+						 (length (vals (get-node net x))))
+					     best))))
+	      (push (car best) order)
+	      (setf width (max width (length neighbours)))
+	      (incf cost size)
+	      (setf largest (max largest size))
+	      (setf graph (remove best graph))
+	      (dolist (entry graph)
+		(when (member (car entry) neighbours :test #'equal)
+		  (setf (cdr entry)
+			(union (remove (car best) (cdr entry) :test #'equal)
+			       (remove (car entry) neighbours :test #'equal)
+			       :test #'equal)))))))
+    (values (nreverse order) width cost largest)))
+
+(defun network-elimination (net)
+  "Gets elimination order of network with its width, cost and largest
+table (see min-fill-elimination); it is found only once for network"
+  (with-slots (elimination) net
+    (unless elimination
+      (setf elimination (multiple-value-list (min-fill-elimination net))))
+    (values-list elimination)))
+
+(defun induced-width (net)
+  "Estimates treewidth of network as width of min-fill elimination order"
+  (nth-value 1 (network-elimination net)))
+
+(defun evidence-pilot (net m evidence)
+  "Draws M likelihood weighted samples; returns estimated probability of
+evidence and ratio of effective to drawn samples"
+  (let ((evidence-names (mapcar #'car evidence))
+	(sum 0.0)
+	(sum2 0.0))
+    (dotimes (i m)
+      (declare (ignorable i))
+      (check-cancel)
+      (let ((current-vals nil)
+	    (w 1.0))
+	(dolist (node (get-node-names net))
+	  (let* ((evidence-p (member node evidence-names :test #'equal))
+		 (sample (if evidence-p
+			     (evidence-value node evidence)
+			     (sample-node net node current-vals))))
+	    (setf current-vals (append-items current-vals (list node sample)))
+	    (when evidence-p
+	      (setf w (* w (apply #'probability
+				  (append (list net node) current-vals)))))))
+	(incf sum w)
+	(incf sum2 (* w w))))
+    (values (/ sum m)
+	    (if (> sum2 0) (/ (* sum sum) (* m sum2)) 0))))
+
+(defun auto-sample-count (n)
+  "Number of independent samples needed for wanted accuracy (at least N)"
+  (max n (ceiling (/ 1 (* *auto-accuracy* *auto-accuracy*)))))
+
+(defun algorithm-costs (net n evidence)
+  "Estimates cost (number of probability lookups), memory and number of
+samples (iterations) of every algorithm; returns list of (name cost memory
+samples) and description of network"
+  (let* ((names (get-node-names net))
+	 (nodes (length names))
+	 (evidence-names (mapcar #'car evidence))
+	 (cards (mapcar #'(lambda (x) (length (vals (get-node net x)))) names))
+	 (avg-card (/ (reduce #'+ cards) nodes))
+	 (space (reduce #'* (loop for name in names
+			       for card in cards
+			       unless (member name evidence-names :test #'equal)
+			       collect card)))
+	 (wanted (auto-sample-count n))
+	 (pool-memory (* (max *sample-pool-size* 0) nodes 48))
+	 (sweep (loop for name in names
+		   for card in cards
+		   unless (member name evidence-names :test #'equal)
+		   summing (* card (1+ (length (children (get-node net name)))))))
+	 (deterministic (some #'(lambda (x) (some #'zerop (table (get-node net x))))
+			      names)))
+    (multiple-value-bind (order width elimination-cost largest)
+	(network-elimination net)
+      (declare (ignore order))
+      (multiple-value-bind (p-evidence ess-ratio)
+	  (evidence-pilot net *auto-pilot-samples* evidence)
+	(let ((rejection (when (> p-evidence 0)
+			   (ceiling (/ wanted p-evidence))))
+	      (weighting (when (> ess-ratio 0)
+			   (ceiling (/ wanted ess-ratio)))))
+	  (values
+	   (list
+	    ;; Exact, sums over whole state space for every node
+	    (list "Enumeration" (* nodes nodes space) (* nodes 128) nil)
+	    ;; Exact, sums out nodes in elimination order for every node
+	    (list "Variable elimination" (* nodes elimination-cost)
+		  (* 8 largest nodes) nil)
+	    ;; Only consistent samples are useful
+	    (list "Rejection sampling"
+		  (when rejection (* rejection nodes avg-card))
+		  pool-memory rejection)
+	    ;; Samples lose effectiveness with unlikely evidence
+	    (list "Likelihood weighting"
+		  (when weighting (* weighting nodes avg-card))
+		  pool-memory weighting)
+	    ;; Chain does not mix on networks with zero probabilities
+	    (list "Gibbs sampling"
+		  (unless deterministic (* wanted *auto-gibbs-mixing* sweep))
+		  (* nodes avg-card 16)
+		  (* wanted *auto-gibbs-mixing*)))
+	   (format nil "treewidth ~D, state space 2^~D, P(e)~~~,4F"
+		   width (integer-length (1- space)) p-evidence)))))))
+
+(defun choose-algorithm (net n evidence)
+  "Chooses algorithm for query - variable elimination when treewidth of
+network is small enough, otherwise one estimated to be the cheapest meeting
+wanted accuracy; returns its name, number of samples it has to draw and
+description of network"
+  (multiple-value-bind (order width cost largest) (network-elimination net)
+    (declare (ignore order cost))
+    (when (and (< width *auto-exact-width*)
+	       (<= (* 8 largest (length (get-node-names net)))
+		   *auto-memory-budget*))
+      (return-from choose-algorithm
+	(values "Variable elimination" nil
+		(format nil "treewidth ~D" width)))))
+  (multiple-value-bind (costs description) (algorithm-costs net n evidence)
+    (let ((best nil))
+      (dolist (c costs)
+	(when (and (second c)
+		   (<= (third c) *auto-memory-budget*)
+		   (or (null best) (< (second c) (second best))))
+	  (setf best c)))
+      ;; Nothing is feasible (impossible evidence?) - weighting degrades best
+      (unless best
+	(setf best (list "Likelihood weighting" nil nil (auto-sample-count n))))
+      (values (first best) (fourth best) description))))
+
+(defgeneric auto-inference (net n &rest evidence)
+  (:documentation "Calculate all probabilities in network using algorithm
+chosen by choose-algorithm; name of chosen algorithm is returned as fourth
+value"))
+(defmethod auto-inference ((net network) n &rest evidence)
+  (multiple-value-bind (name samples description)
+      (choose-algorithm net n evidence)
+    (let ((algorithm (assoc name *inference-algorithms* :test #'equal)))
+      (multiple-value-bind (result time iterations)
+	  (if (third algorithm)
+	      ;; All samples needed for accuracy are drawn - convergence
+	      ;; check could stop sampling before that
+	      (let ((*diff-small-value* -1))
+		(apply (second algorithm) net samples evidence))
+	      (apply (second algorithm) net evidence))
+	(values result time iterations
+		(format nil "~A (~A)" name description))))))
+
+;;; Add new algorithm to list of algorithms
+(push `("Auto" ,#'auto-inference t) *inference-algorithms*)
+
 ;;; Reading and printing of Bayes networks ;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
 
 (defun make-bayes-network (name &rest nodes)
@@ -466,7 +949,8 @@ properties:  - name, vals, parents, table, meta"
 	    (let* ((name (getf node :name))
 		   (vals (getf node :vals))
 		   (parents (getf node :parents))
-		   (table (getf node :table))
+		   ;; Table may come as vector of doubles
+		   (table (coerce (getf node :table) 'list))
 		   (meta (getf node :meta))
 		   (n (make-instance 'node :vals vals :parents parents
 				     :table table :meta meta)))
@@ -490,7 +974,165 @@ properties:  - name, vals, parents, table, meta"
 		    ((eql name 'node) (push options node-list))
 		    (t (error (format nil "Unknown command ~A"
 				      (symbol-name name)))))))
-    (apply #'make-bayes-network (cons network-name node-list))))
+    (let ((network (apply #'make-bayes-network
+			  (cons network-name node-list))))
+      (setf (slot-value network 'order)
+	    (map 'simple-vector #'(lambda (node) (getf node :name))
+		 (reverse node-list)))
+      network)))
+
+(defun copy-bayes-network (net)
+  "Creates copy of network which can be changed without changing original"
+  (let ((copy (make-instance 'network :name (name net))))
+    (setf (slot-value copy 'nodes)
+	  (mapcar #'(lambda (item)
+		      (let ((n (cdr item)))
+			(cons (car item)
+			      (make-instance 'node :vals (vals n)
+					     :parents (parents n)
+					     :table (table n)
+					     :meta (meta n)))))
+		  (slot-value net 'nodes)))
+    (setf (slot-value copy 'order) (copy-seq (slot-value net 'order)))
+    copy))
+
+(defun share-bayes-network (net)
+  "Creates network sharing nodes with network (they are never changed in
+place) but having own state kept between queries"
+  (let ((copy (make-instance 'network :name (name net))))
+    (setf (slot-value copy 'nodes) (copy-list (slot-value net 'nodes)))
+    (setf (slot-value copy 'order) (copy-seq (slot-value net 'order)))
+    (setf (slot-value copy 'elimination) (slot-value net 'elimination))
+    copy))
+
+(defun sort-bayes-network (net)
+  "Orders nodes of network so that parents come before children"
+  (let* ((nodes (slot-value net 'nodes))
+	 (indegree (make-hash-table :test #'equal))
+	 (children (make-hash-table :test #'equal))
+	 (queue (make-array (length nodes) :fill-pointer 0))
+	 (head 0))
+    (dolist (item nodes)
+      (setf (gethash (car item) indegree) (length (parents (cdr item))))
+      (dolist (parent (parents (cdr item)))
+	(unless (get-node net parent)
+	  (error (format nil "Parent node ~A does not exist" parent)))
+	(push item (gethash parent children))))
+    (dolist (item nodes)
+      (when (zerop (gethash (car item) indegree))
+	(vector-push item queue)))
+    (loop while (< head (fill-pointer queue))
+       do (let ((item (aref queue head)))
+	    (incf head)
+	    (dolist (child (reverse (gethash (car item) children)))
+	      (when (zerop (decf (gethash (car child) indegree)))
+		(vector-push child queue)))))
+    (unless (= (fill-pointer queue) (length nodes))
+      (error "Cycle found in network"))
+    (setf (slot-value net 'nodes) (coerce queue 'list))))
+
+(defun update-bayes-network (net &rest changes)
+  "Creates new network by applying changes to existing one. Changes are
+lists: (set-name name), (add-node :name .. :vals .. :parents .. :table ..
+:meta ..), (remove-node name), (rename-node name new-name), (set-vals name
+vals), (set-parents name parents), (set-table name table), (set-meta name
+meta). Changed nodes (and children of nodes with changed values) are checked
+after all changes are applied."
+  (let ((new (copy-bayes-network net))
+	(touched nil)
+	(structure-changed nil))
+    (flet ((node-of (name)
+	     (or (get-node new name)
+		 (error (format nil "Node ~A does not exist" name)))))
+      (dolist (change changes)
+	(let ((cmd (first change))
+	      (args (rest change)))
+	  (with-slots (nodes order) new
+	    (cond ((eql cmd 'set-name)
+		   (setf (slot-value new 'name) (first args)))
+		  ((eql cmd 'add-node)
+		   (let ((node-name (getf args :name)))
+		     (when (get-node new node-name)
+		       (error (format nil "Duplicate node name: ~A" node-name)))
+		     (setf nodes
+			   (append-items nodes
+					 (cons node-name
+					       (make-instance
+						'node
+						:vals (getf args :vals)
+						:parents (getf args :parents)
+						:table (coerce (getf args :table)
+							       'list)
+						:meta (getf args :meta)))))
+		     (setf order (concatenate 'simple-vector order
+					      (list node-name)))
+		     (push node-name touched)
+		     (setf structure-changed t)))
+		  ((eql cmd 'remove-node)
+		   (node-of (first args))
+		   (setf nodes (remove (first args) nodes
+				       :key #'car :test #'equal))
+		   (setf order (remove (first args) order :test #'equal))
+		   (setf touched (remove (first args) touched :test #'equal))
+		   (setf structure-changed t))
+		  ((eql cmd 'rename-node)
+		   (let ((old-name (first args))
+			 (new-name (second args)))
+		     (node-of old-name)
+		     (when (get-node new new-name)
+		       (error (format nil "Duplicate node name: ~A" new-name)))
+		     (setf nodes
+			   (mapcar #'(lambda (item)
+				       (if (equal (car item) old-name)
+					   (cons new-name (cdr item))
+					   item))
+				   nodes))
+		     ;; Parents are referenced by name
+		     (dolist (item nodes)
+		       (setf (slot-value (cdr item) 'parents)
+			     (substitute new-name old-name (parents (cdr item))
+					 :test #'equal)))
+		     (setf order (substitute new-name old-name order
+					     :test #'equal))
+		     (setf touched (substitute new-name old-name touched
+					       :test #'equal))))
+		  ((eql cmd 'set-vals)
+		   (setf (slot-value (node-of (first args)) 'vals) (second args))
+		   (push (first args) touched))
+		  ((eql cmd 'set-parents)
+		   (setf (slot-value (node-of (first args)) 'parents)
+			 (second args))
+		   (push (first args) touched)
+		   (setf structure-changed t))
+		  ((eql cmd 'set-table)
+		   (setf (slot-value (node-of (first args)) 'table)
+			 (coerce (second args) 'list))
+		   (push (first args) touched))
+		  ((eql cmd 'set-meta)
+		   (setf (slot-value (node-of (first args)) 'meta)
+			 (second args)))
+		  (t (error (format nil "Unknown change ~A" cmd))))))))
+    (when (null (slot-value new 'nodes))
+      (error "Empty network"))
+    (when structure-changed
+      (sort-bayes-network new))
+    ;; Rebuild children lists
+    (dolist (item (slot-value new 'nodes))
+      (setf (slot-value (cdr item) 'children) nil))
+    (dolist (item (slot-value new 'nodes))
+      (dolist (parent (parents (cdr item)))
+	(add-node-children new parent (car item))))
+    ;; Check changed nodes; tables of children depend on values of parents
+    (dolist (node-name (remove-duplicates touched :test #'equal))
+      (let ((n (get-node new node-name)))
+	(when (duplicates-p (vals n))
+	  (error (format nil "Duplicate values in node ~A" node-name)))
+	(when (> 2 (length (vals n)))
+	  (error (format nil "Less than two values in node ~A" node-name)))
+	(check-node-table new node-name)
+	(dolist (child (children n))
+	  (check-node-table new child))))
+    new))
 
 (defun print-bayes-network (network)
   "Exports Bayes network in the same format it can read it"
@@ -0,0 +1,86 @@
+;;;
+;;; Tests of automatic algorithm choice (sbcl --script tests/auto.lisp)
+;;;
+
+(load (merge-pathnames "../bayes.lisp" *load-truename*))
+
+(defparameter *failures* 0)
+
+(defun check (description ok)
+  "Reports result of one check"
+  (format t "~:[FAIL~;PASS~] ~A~%" ok description)
+  (unless ok
+    (incf *failures*)))
+
+(defun chain-network (n)
+  "Creates chain of n binary nodes, each one depending on previous one"
+  (apply #'make-bayes-network "chain"
+	 (loop for i below n
+	    collect (list :name (format nil "N~D" i)
+			  :vals '("T" "F")
+			  :parents (when (> i 0)
+				     (list (format nil "N~D" (1- i))))
+			  :table (if (> i 0)
+				     '(0.9 0.1 0.2 0.8)
+				     '(0.3 0.7))))))
+
+(defun dense-network (n)
+  "Creates network of n binary nodes, each one depending on all previous
+ones (its moral graph is complete)"
+  (apply #'make-bayes-network "dense"
+	 (loop for i below n
+	    collect (list :name (format nil "N~D" i)
+			  :vals '("T" "F")
+			  :parents (loop for j below i
+				      collect (format nil "N~D" j))
+			  :table (loop repeat (expt 2 i)
+				    append '(0.6 0.4))))))
+
+(defun max-difference (result1 result2)
+  "Returns largest difference between probabilities of two query results"
+  (loop for (name vals) in result1
+     maximizing (loop for (val p) in vals
+		   maximizing (abs (- p (second
+					 (assoc val
+						(second (assoc name result2
+							       :test #'equal))
+						:test #'equal)))))))
+
+;;; Chain has treewidth 1 - it is queried exactly even when it is too big
+;;; for enumeration
+(let ((net (chain-network 40)))
+  (check "chain has treewidth 1" (= (induced-width net) 1))
+  (check "chain is queried by variable elimination"
+	 (equal (choose-algorithm net 0 nil) "Variable elimination"))
+  (let ((elimination (slot-value net 'elimination)))
+    (choose-algorithm net 0 '(("N5" "T")))
+    (check "elimination order is found once for network"
+	   (eq elimination (slot-value net 'elimination)))))
+
+;;; Variable elimination is exact
+(let ((net (chain-network 6))
+      (evidence '(("N1" "F") ("N4" "T"))))
+  (check "variable elimination agrees with enumeration"
+	 (< (max-difference (apply #'variable-elimination net evidence)
+			    (apply #'enumeration net evidence))
+	    1e-9)))
+
+;;; Network wider than limit is sampled, with enough samples for wanted
+;;; accuracy even when query does not ask for any
+(let ((*auto-exact-width* 4)
+      (*auto-accuracy* 0.05)
+      (net (dense-network 8)))
+  (check "dense network has treewidth 7" (= (induced-width net) 7))
+  (multiple-value-bind (name samples) (choose-algorithm net 0 nil)
+    (check "dense network is sampled"
+	   (member name '("Rejection sampling" "Likelihood weighting"
+			  "Gibbs sampling")
+		   :test #'equal))
+    (check "sample count meets wanted accuracy"
+	   (and samples (>= samples (auto-sample-count 0)))))
+  (multiple-value-bind (result time iterations) (auto-inference net 0)
+    (declare (ignore result time))
+    (check "sampling is not stopped before wanted accuracy"
+	   (and iterations (>= iterations (auto-sample-count 0))))))
+
+(sb-ext:exit :code (if (zerop *failures*) 0 1))
@@ -0,0 +1,100 @@
+;;;
+;;; Tests of engine requests over one connection (sbcl --script
+;;; tests/engine.lisp after bayes-cmd is built; BAYES_ENGINE can point to
+;;; other engine executable)
+;;;
+
+(defparameter *failures* 0)
+
+;;; Seconds to wait for expected message
+(defparameter *timeout* 30)
+
+(defparameter *engine*
+  (sb-ext:run-program (or (sb-ext:posix-getenv "BAYES_ENGINE")
+			  (namestring (merge-pathnames "../bayes-cmd"
+						       *load-truename*)))
+		      nil :input :stream :output :stream :wait nil))
+
+;;; Messages received so far (latest first)
+(defparameter *messages* nil)
+
+(defun check (description ok)
+  "Reports result of one check"
+  (format t "~:[FAIL~;PASS~] ~A~%" ok description)
+  (unless ok
+    (incf *failures*)))
+
+(defun send (&rest request)
+  "Sends request to engine"
+  (let ((stream (sb-ext:process-input *engine*)))
+    (format stream "~S~%" request)
+    (finish-output stream)))
+
+(defun wait-for (id &rest commands)
+  "Reads messages of engine until one of commands arrives for request id;
+returns that message (NIL if it does not arrive in time)"
+  (handler-case
+      (sb-ext:with-timeout *timeout*
+	(loop
+	   (let ((message (read (sb-ext:process-output *engine*) nil nil)))
+	     (unless message
+	       (return nil))
+	     (push message *messages*)
+	     (when (and (eql (first message) id)
+			(member (second message) commands :test #'equal))
+	       (return message)))))
+    (sb-ext:timeout () nil)))
+
+(defun received-p (id command)
+  "Checks if command has arrived for request id"
+  (find-if #'(lambda (m)
+	       (and (eql (first m) id) (equal (second m) command)))
+	   *messages*))
+
+;;; Without convergence check Gibbs sampling runs until it is cancelled
+(send 1 'set-option "diff-small-value" -1)
+(send 2 'load-network
+      '(network :name "test")
+      '(node :name "A" :vals ("T" "F") :parents () :table (0.3 0.7))
+      '(node :name "B" :vals ("T" "F") :parents ("A")
+	:table (0.9 0.1 0.2 0.8)))
+(check "loaded network is acknowledged" (wait-for 2 "NETWORK-DONE"))
+
+;;; Second query waits in queue until first one is cancelled
+(send 3 'query "Gibbs sampling" 0)
+(send 4 'query "Enumeration")
+(send 5 'cancel 3)
+
+(check "running query is cancelled"
+       (equal (second (wait-for 3 "QUERY-CANCELLED" "QUERY-DONE"))
+	      "QUERY-CANCELLED"))
+(check "queued query runs after cancelled one"
+       (wait-for 4 "QUERY-DONE"))
+(check "queued query has result" (received-p 4 "QUERY-RESULT"))
+
+;;; Options set after query thread started are used by next query
+(send 6 'set-option "diff-small-value" 0.01)
+(send 7 'query "Gibbs sampling" 0)
+(check "option set after first query reaches query thread"
+       (wait-for 7 "QUERY-DONE"))
+
+;;; Rejected network is reported as error and not acknowledged
+(send 8 'load-network
+      '(network :name "bad")
+      '(node :name "A" :vals ("T" "F") :parents () :table (0.3 0.3)))
+(check "rejected network is reported"
+       (equal (second (wait-for 8 "ERROR" "NETWORK-DONE")) "ERROR"))
+
+;;; Engine stops its query thread and quits
+(send 9 'quit)
+(check "engine quits"
+       (handler-case
+	   (sb-ext:with-timeout *timeout*
+	     (sb-ext:process-wait *engine*)
+	     (eql (sb-ext:process-exit-code *engine*) 0))
+	 (sb-ext:timeout () nil)))
+
+(when (sb-ext:process-alive-p *engine*)
+  (sb-ext:process-kill *engine* 9))
+
+(sb-ext:exit :code (if (zerop *failures*) 0 1))
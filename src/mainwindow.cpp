@@ -33,10 +33,13 @@
 #include "networkeditortabs.h"
 #include "networkeditor.h"
 #include "engine.h"
+#include "enginepool.h"
 #include "network.h"
+#include "netfile.h"
 #include "graphicsnode.h"
 #include "node.h"
 #include "settingsdialog.h"
+#include "queryscheduler.h"
 
 // Reference to (single) instance of MainWindow
 MainWindow* MainWindow::instance = 0;
@@ -56,14 +59,26 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent) {
     createTabs();
     createDocks();
     createMenus();
+    createStatusBar();
     createEngine();
     readSettings();
 
     // Settings dialog
     settingsDialog = new SettingsDialog(this);
+    connect(settingsDialog, SIGNAL(accepted()), this, SLOT(settingsChanged()));
+
+    // Results of previous queries
+    queryCache = new QueryCache(Settings::queryCacheSize(), this);
+
+    // Rapid evidence changes are coalesced into one query
+    queryScheduler = new QueryScheduler(Settings::queryDelay(), this);
+    connect(tabs(), SIGNAL(evidenceChanged()),
+            queryScheduler, SLOT(evidenceChanged()));
+    connect(queryScheduler, SIGNAL(queryDue()), this, SLOT(doQuery()));
 
     // Reset status flags
-    loadingFile = savingFile = query = false;
+    runningQueries = 0;
+    engineNeedsNetwork = true;
 }
 
 /*
@@ -75,7 +90,6 @@ void MainWindow::createTabs() {
     connect(tabs, SIGNAL(currentChanged(int)), this, SLOT(tabChanged(int)));
     connect(tabs, SIGNAL(message(QString)), this, SLOT(showMessage(QString)));
     connect(tabs, SIGNAL(networkChange()), this, SLOT(networkChanged()));
-    connect(tabs, SIGNAL(evidenceChanged()), this, SLOT(doQuery()));
     connect(tabs, SIGNAL(tabCloseRequested(int)), this, SLOT(tabClose(int)));
 
     // Set as main (central) widget
@@ -169,21 +183,34 @@ void MainWindow::createMenus() {
 }
 
 /*
- * Creates engine communication
+ * Creates status bar with (initially hidden) button to cancel running query
+ */
+void MainWindow::createStatusBar() {
+    cancelQueryBtn = new QPushButton(tr("Cancel query"), this);
+    cancelQueryBtn->setVisible(false);
+    connect(cancelQueryBtn, SIGNAL(clicked()), this, SLOT(cancelQuery()));
+    statusBar()->addPermanentWidget(cancelQueryBtn);
+}
+
+/*
+ * Creates engine communication (pool of engines, every tab is served by one)
  */
 void MainWindow::createEngine() {
-    engine = new Engine(this);
-    connect(engine, SIGNAL(command(QString,QStringList)),
-            this, SLOT(engineCmd(QString,QStringList)));
-    engine->algorithms();
+    engines = new EnginePool(Settings::enginePoolSize(), this);
+    connect(engines, SIGNAL(command(int,QString,QVariantList)),
+            this, SLOT(engineCmd(int,QString,QVariantList)));
+    connect(engines, SIGNAL(queryResult(int,QVector<double>)),
+            this, SLOT(engineQueryResult(int,QVector<double>)));
+
+    engines->engine()->algorithms();
 }
 
 /*
  * Clean exit: networks & settings are saved
  */
 void MainWindow::closeEvent(QCloseEvent *event) {
-    // Quiot engine
-    engine->exit();
+    // Quiot engines
+    engines->exit();
 
     saveSettings();
     QMainWindow::closeEvent(event);
@@ -194,6 +221,11 @@ void MainWindow::closeEvent(QCloseEvent *event) {
  */
 void MainWindow::keyReleaseEvent ( QKeyEvent * event ) {
     NetworkEditor *e = tabs()->currentNetwork();
+    if ( event->key() == Qt::Key_Escape && runningQueries > 0 ) {
+        cancelQuery();
+        return;
+    }
+
     if ( event->key() == Qt::Key_Escape && e!=NULL ) {
         e->cancelAdd();
         return;
@@ -244,11 +276,22 @@ void MainWindow::createNewNetwork(QString fromFile) {
     // Create tab
     tabs()->createTab();
 
-    // Load file
+    // Load file (tab is closed if it cannot be read)
     if ( fromFile.length() > 0 ) {
-        setEnabled(false);
-        loadingFile = true;
-        engine->loadFile(fromFile);
+        NetworkEditor *e = tabs()->currentNetwork();
+        QString error;
+
+        if ( !e->load(fromFile, error) ) {
+            QMessageBox::critical(this, tr("Error loading network"),
+                                  tr("Loading error: ") + error);
+            tabClose(tabs()->indexOf(e));
+            return;
+        }
+
+        e->setFileName(fromFile);
+        tabs()->setTabTitle();
+        tabChanged(tabs()->currentIndex());
+        showMessage(tr("Network \"%1\" loaded.").arg(fromFile));
     }
 }
 
@@ -266,7 +309,7 @@ void MainWindow::fileOpen() {
             QFileDialog::getOpenFileName(this,
                                          tr("Open existing Bayes network"),
                                          directory,
-                                         tr("Bayes network (*.net);;"\
+                                         tr("Bayes network (*.net *.netb);;"\
                                             "All files (*.*)"));
     if ( fileName.isEmpty() ) {
         return;
@@ -274,8 +317,6 @@ void MainWindow::fileOpen() {
 
     Settings::setOpenPath(QDir(fileName).absolutePath());
     createNewNetwork(fileName);
-
-    tabs()->currentNetwork()->setFileName(fileName);
 }
 
 void MainWindow::fileSave() {
@@ -283,10 +324,14 @@ void MainWindow::fileSave() {
 
     if ( e != NULL ) {
         if ( e->fileName().length() > 0 ) {
-            setEnabled(false);
-            savingFile = true;
-            defineNetwork();
-            engine->saveFile(e->fileName());
+            QString error;
+            if ( NetFile::write(e->fileName(), e->getNetwork(), error) ) {
+                e->networkModified(false);
+                showMessage(tr("Network \"%1\" saved.").arg(e->fileName()));
+            } else {
+                QMessageBox::critical(this, tr("Error saving network"),
+                                      tr("Saving error: ") + error);
+            }
             Settings::setSavePath(QDir(e->fileName()).absolutePath());
 
         } else {
@@ -310,7 +355,8 @@ void MainWindow::fileSaveAs() {
                 QFileDialog::getSaveFileName(this,
                                              tr("Save Bayes network"),
                                              directory,
-                                             tr("Bayes network (*.net);;"\
+                                             tr("Bayes network "\
+                                                "(*.net *.netb);;"\
                                                 "All files (*.*)"));
 
         if ( fileName.length() > 0 ) {
@@ -332,6 +378,14 @@ void MainWindow::fileSettings() {
     settingsDialog->show();
 }
 
+/*
+ * Settings dialog closed with new settings
+ */
+void MainWindow::settingsChanged() {
+    queryCache->setMaxSize(Settings::queryCacheSize());
+    queryScheduler->setDelay(Settings::queryDelay());
+}
+
 /*
  * Command from dock to add node
  */
@@ -351,7 +405,7 @@ void MainWindow::dockAddEdge() {
  */
 void MainWindow::dockStateChanged() {
     if ( networkDock->state() == EditState ) {
-        query = false;
+        queryScheduler->stop();
         tabs()->currentNetwork()->queryMode(false);
         tabs()->setEnabled(true);
         menuBar()->setEnabled(true);
@@ -361,65 +415,265 @@ void MainWindow::dockStateChanged() {
         menuBar()->setEnabled(false);
         tabs()->enableBar(false);
         tabs()->currentNetwork()->queryMode(true);
-        query = true;
         doQuery(true);
     }
 }
 
 /*
- * Makes query to engine
+ * Makes query to engine (or answers it from cache of previous results)
  */
 void MainWindow::doQuery(bool createNet) {
+    NetworkEditor *e = tabs()->currentNetwork();
 
-    query = true;
-    setEnabled(false);
-    tabs()->setEnabled(false);
-
+    // Network has to be (re)defined before next query reaching the engine
     if ( createNet ) {
-        defineNetwork();
+        engineNeedsNetwork = true;
+    }
+
+    QVariantList queryArgs;
+    queryArgs << networkDock->algorithmName();
+    if ( networkDock->algorithmHasParam() ) {
+        queryArgs << networkDock->algorithmParamVal();
+    }
+
+    // Query is made for network as it is now - engine, cache and result
+    // all see this snapshot (editing is possible only in edit mode, which
+    // stops queries, and results of edited network are dropped as stale)
+    NetworkSnapshot snapshot = e->getNetwork()->snapshot();
+    for ( int i=0; i<snapshot.nodeCount(); ++i ) {
+        int value = snapshot.evidence(i);
+        if ( value != -1 ) {
+            QVariantList evidence;
+            evidence << snapshot.nodeName(i) << snapshot.values(i).at(value);
+            queryArgs << QVariant(evidence);
+        }
+    }
+
+    QList<Node*> nodes;
+    foreach (GraphicsNode *n, e->nodes() ) {
+        nodes << n->getNode();
+    }
+
+    // Options influence sampling results too
+    double smallValue = Settings::diffSmallValue();
+    int checkPeriod = Settings::diffCheckPeriod();
+    QVariantList options;
+    options << smallValue << checkPeriod;
+
+    // Try to answer from cache
+    QueryResult result;
+    QString key = QueryCache::key(nodes, queryArgs, options);
+    if ( queryCache->lookup(key, result) ) {
+        queryScheduler->answered(e);
+        applyQueryResult(e, result);
+        showMessage(tr("Query answered from cache (%1 hits, %2 misses).")
+                    .arg(queryCache->hits()).arg(queryCache->misses()));
+        return;
+    }
+
+    Engine *engine = engines->select(e);
+
+    if ( engineNeedsNetwork ) {
+        engineNeedsNetwork = false;
+        defineNetwork(e);
 
-        double smallValue = Settings::diffSmallValue();
         if ( smallValue > 0 ) {
             engine->setOption("diff-small-value", smallValue);
         }
 
-        int checkPeriod = Settings::diffCheckPeriod();
         if ( checkPeriod > 0 ) {
             engine->setOption("diff-check-period", checkPeriod);
         }
+
+    // Network was edited since engine got it
+    } else if ( !synced.contains(e) ||
+                synced.value(e).version != e->getNetwork()->version() ) {
+        defineNetwork(e);
     }
 
-    QVariantList queryArgs;
-    queryArgs << networkDock->algorithmName();
-    if ( networkDock->algorithmHasParam() ) {
-        queryArgs << networkDock->algorithmParamVal();
+    int id = engine->query(networkDock->algorithmName(),
+                           networkDock->algorithmHasParam(),
+                           networkDock->algorithmParamVal(), snapshot);
+    addRequest(id, engine, PendingRequest::Query, e, key, snapshot);
+    queryScheduler->started(id, engine, e);
+}
+
+/*
+ * Sets query result (probabilities of values for every node, in order of
+ * nodes in editor) to nodes of network in editor `e'
+ */
+void MainWindow::applyQueryResult(NetworkEditor *e, QueryResult result) {
+    QList<GraphicsNode*> nodes = e->nodes();
+
+    for ( int i=0; i<nodes.length() && i<result.length(); ++i ) {
+        nodes.at(i)->getNode()->setQueryValues(result.at(i));
     }
 
-    foreach (GraphicsNode *n, tabs()->currentNetwork()->nodes() ) {
-        Node *node = n->getNode();
+    // Nodes are not cached in query mode - one repaint shows all values
+    e->scene()->update();
+}
 
-        int e = node->getEvidence();
-        if ( e != -1 ) {
-            QVariantList evidence;
-            evidence << node->name() << node->valueList().at(e);
-            queryArgs << QVariant(evidence);
+/*
+ * Query result arrived from engine - probabilities of all values of all
+ * nodes, in order of nodes of network snapshot query was made for
+ */
+void MainWindow::engineQueryResult(int request, QVector<double> result) {
+    if ( isStaleQuery(request) ) {
+        return;
+    }
+
+    NetworkSnapshot snapshot = requests.value(request).snapshot;
+    QueryResult r;
+    int pos = 0;
+
+    for ( int n=0; n<snapshot.nodeCount(); ++n ) {
+        int count = snapshot.cardinality(n);
+        QList<double> p;
+
+        for ( int i=0; i<count && pos<result.size(); ++i ) {
+            p << result.at(pos++);
         }
+        r << p;
+    }
+
+    applyQueryResult(requests.value(request).editor, r);
+}
+
+/*
+ * Checks if results of query are not wanted any more: its tab is closed,
+ * newer evidence is queried or network was edited since query was made
+ */
+bool MainWindow::isStaleQuery(int request) {
+    if ( !requests.contains(request) ) {
+        return true;
     }
 
-    engine->query(queryArgs);
+    PendingRequest r = requests.value(request);
+    if ( r.type != PendingRequest::Query || r.editor == NULL ) {
+        return true;
+    }
+
+    return queryScheduler->isStale(request) ||
+           r.snapshot.version() != r.editor->getNetwork()->version();
 }
 
 /*
- * Defines network to engine
+ * Gets query result currently set to nodes of network in editor `e'
  */
-void MainWindow::defineNetwork() {
+QueryResult MainWindow::currentQueryResult(NetworkEditor *e) {
+    QueryResult result;
+
+    foreach ( GraphicsNode *n, e->nodes() ) {
+        result << n->getNode()->queryValues();
+    }
+
+    return result;
+}
+
+/*
+ * Asks engine to stop all queries which are not done yet
+ */
+void MainWindow::cancelQuery() {
+    queryScheduler->stop();
+
+    if ( runningQueries > 0 ) {
+        foreach ( int id, requests.keys() ) {
+            if ( requests[id].type == PendingRequest::Query ) {
+                requests[id].engine->cancel(id);
+            }
+        }
+        showMessage(tr("Cancelling query..."));
+    }
+}
+
+/*
+ * Remembers command sent to engine until its final response arrives
+ */
+void MainWindow::addRequest(int id, Engine *engine, PendingRequest::Type type,
+                            NetworkEditor *e, QString cacheKey,
+                            NetworkSnapshot snapshot) {
+    PendingRequest r;
+    r.type = type;
+    r.engine = engine;
+    r.editor = e;
+    r.cacheKey = cacheKey;
+    r.snapshot = snapshot;
+    requests[id] = r;
+
+    if ( type == PendingRequest::Query ) {
+        ++runningQueries;
+        cancelQueryBtn->setVisible(true);
+    }
+}
+
+/*
+ * Forgets command whose final response has arrived
+ */
+void MainWindow::finishRequest(int id) {
+    if ( requests.contains(id) &&
+         requests[id].type == PendingRequest::Query ) {
+        queryScheduler->finished(id);
+        --runningQueries;
+        cancelQueryBtn->setVisible(runningQueries > 0);
+    }
+
+    requests.remove(id);
+}
+
+/*
+ * Drops queries for editor `e' sent after network request `id' which engine
+ * rejected - they run on network engine had before and their results do not
+ * match network in editor
+ */
+void MainWindow::failQueuedQueries(int id, NetworkEditor *e) {
+    QList<int> ids = requests.keys();
+
+    foreach ( int q, ids ) {
+        PendingRequest r = requests.value(q);
+        if ( q > id && r.type == PendingRequest::Query && r.editor == e ) {
+            r.engine->cancel(q);
+            finishRequest(q);
+        }
+    }
+}
+
+/*
+ * Defines network in editor `e' to engine serving it
+ */
+void MainWindow::defineNetwork(NetworkEditor *e) {
+    Engine *engine = engines->select(e);
+    QString name = e->getNetwork()->name();
     QList<Node*> nodes;
 
-    foreach(GraphicsNode *n, tabs()->currentNetwork()->nodes()) {
+    foreach(GraphicsNode *n, e->nodes()) {
         nodes << n->getNode();
     }
 
-    engine->loadNetwork(tabs()->currentNetwork()->getNetwork()->name(), nodes);
+    // Engine already has this network - send only what has changed
+    int id = -1;
+    if ( synced.contains(e) ) {
+        SyncedNetwork s = synced.value(e);
+        id = engine->updateNetwork(name == s.name ? "" : name, nodes, s);
+    }
+
+    if ( id < 0 ) {
+        id = engine->loadNetwork(name, nodes);
+    }
+
+    // Queries sent after network depend on engine accepting it
+    if ( id > 0 ) {
+        addRequest(id, engine, PendingRequest::Network, e);
+    }
+
+    // Remember what engine has now
+    SyncedNetwork &s = synced[e];
+    s.name = name;
+    s.version = e->getNetwork()->version();
+    s.revision = e->getNetwork()->revision();
+    s.nodes.clear();
+    foreach ( Node *n, nodes ) {
+        s.nodes.insert(n->id(), n->name());
+    }
 }
 
 /*
@@ -438,6 +692,10 @@ void MainWindow::tabChanged(int index) {
  * Tab should be closed ("X" has been clicked)
  */
 void MainWindow::tabClose(int index) {
+    NetworkEditor *e = (NetworkEditor*) tabs()->widget(index);
+    engines->release(e);
+    synced.remove(e);
+
     tabs()->removeTab(index);
 }
 
@@ -449,128 +707,91 @@ void MainWindow::networkChanged() {
 }
 
 /*
- * Command from engine received
+ * Command from engine received (`request' is id of command it responds to)
  */
-void MainWindow::engineCmd(QString cmd, QStringList args) {
+void MainWindow::engineCmd(int request, QString cmd, QVariantList args) {
+    bool known = requests.contains(request);
+    PendingRequest r = requests.value(request);
+    NetworkEditor *e = r.editor;
+
+    // Query superseded by newer one or made for older version of network
+    // (its messages are not interesting)
+    bool stale = known && r.type == PendingRequest::Query &&
+                 isStaleQuery(request);
 
     // Info message from engine - show status
     if ( cmd == "info" && args.length()==1 ) {
-        showMessage(args.first());
-
-    // Set loading file network name
-    } else if ( cmd == "network-name" && args.length() == 1 ) {
-        if ( loadingFile ) {
-            tabs()->currentNetwork()->getNetwork()->setName(args.first());
-        }
-
-    // Set loading file new node name
-    } else if ( cmd == "node-name" && args.length() == 1 ) {
-        if ( loadingFile ) {
-            tabs()->currentNetwork()->addNode(args.first());
-        }
-
-    // Set loading file node mta data
-    } else if ( cmd == "node-meta" && args.length() == 3 ) {
-        if ( args.at(1) == ":X" ) {
-            tabs()->currentNetwork()->setNodeX(args.at(0),
-                                               args.at(2).toDouble());
-
-        } else if ( args.at(1) == ":Y" ) {
-            tabs()->currentNetwork()->setNodeY(args.at(0),
-                                                args.at(2).toDouble());
+        if ( !stale ) {
+            showMessage(args.first().toString());
         }
 
-    // Set loading file node values
-    } else if ( cmd == "node-vals" && args.length() >= 3 ) {
-        if ( loadingFile ) {
-            QString name = args.first();
-            args.pop_front();
-
-            for (int i=1; i<args.length(); ++i) {
-                tabs()->currentNetwork()->setNodeVals(name, args);
-            }
-        }
-
-    } else if ( cmd == "node-table" && args.length() >= 3 ) {
-        QList<double> tbl = QList<double>();
-
-        for(int i=1; i<args.length(); ++i) {
-            tbl << args.at(i).toDouble();
-        }
-
-        tabs()->currentNetwork()->setNodeTable(args.first(), tbl);
-
     // Adds new algorithm to list of algorithms
     } else if ( cmd == "add-algorithm" && args.length() == 2 ) {
-        QString name = args.first();
-        bool hasParam = args.at(1) != "NIL";
+        QString name = args.first().toString();
+        bool hasParam = args.at(1).toString() != "NIL";
         networkDock->addAlgorithm(name, hasParam);
 
-    // Set loading file node parent
-    } else if ( cmd == "node-parent" && args.length() == 2 ) {
-        tabs()->currentNetwork()->addEdge(args.at(1), args.at(0));
-
-    // File loading is done
-    } else if ( cmd == "load-file-done" ) {
-        loadingFile = false;
-        setEnabled(true);
-        tabChanged(tabs()->currentIndex());
-
-    // Query result
-    } else if ( cmd == "setval" && args.length() == 3 ) {
-        GraphicsNode *node = tabs()->currentNetwork()->getByName(args.at(0));
-
-        if ( node != NULL ) {
-            Node *n = node->getNode();
-
-            n->setQueryP(args.at(1), args.at(2).toDouble());
-            node->update();
+    // Algorithm engine has chosen for "Auto" query
+    } else if ( cmd == "chosen-algorithm" && args.length() == 1 ) {
+        if ( !stale && e != NULL && e == tabs()->currentNetwork() ) {
+            networkDock->setChosenAlgorithm(args.first().toString());
         }
 
     // Query is done
     } else if ( cmd == "query-done" ) {
-        query = false;
-        setEnabled(true);
-        tabs()->setEnabled(true);
+        finishRequest(request);
+        if ( !stale && e != NULL ) {
+            queryCache->insert(r.cacheKey, currentQueryResult(e));
+        }
 
-    // Saving file is done
-    } else if ( cmd == "file-save-done" ) {
-        savingFile = false;
-        setEnabled(true);
+    // Query was cancelled - keep query mode with previous results
+    } else if ( cmd == "query-cancelled" ) {
+        finishRequest(request);
+
+    // Engine has accepted network
+    } else if ( cmd == "network-done" ) {
+        finishRequest(request);
 
     // Error occured
     } else if ( cmd == "error" ) {
-        QString err = args.join(" ");
-        if ( loadingFile ) {
-            QMessageBox::critical(this, tr("Error loading network"),
-                                  tr("Loading error: ") + err);
-            tabs()->removeTab(tabs()->currentIndex());
-            loadingFile = false;
+        QStringList parts;
+        foreach ( QVariant v, args ) {
+            parts << v.toString();
+        }
+        QString err = parts.join(" ");
+
+        finishRequest(request);
+
+        // Engine may have rejected network - send whole one next time
+        if ( known ) {
+            synced.remove(e);
+        } else {
+            synced.clear();
+        }
+
+        bool rejected = known && r.type == PendingRequest::Network;
+        if ( rejected ) {
+            failQueuedQueries(request, e);
+        }
 
-        } else if ( savingFile ) {
-            QMessageBox::critical(this, tr("Error saving network"),
-                                  tr("Saving error: ") + err);
-            savingFile = false;
+        if ( !known ) {
+            showMessage(tr("Engine error: ") + err);
 
-        } else if ( query ) {
+        } else if ( rejected || (r.type == PendingRequest::Query && !stale) ) {
             QMessageBox::critical(this, tr("Query error"),
                                   tr("Query error: ") + err);
-            networkDock->setState(EditState);
-            dockStateChanged();
+            if ( e != NULL && e == tabs()->currentNetwork() ) {
+                networkDock->setState(EditState);
+                dockStateChanged();
+            }
         }
 
-        setEnabled(true);
-
     // Unknown command - show error msg
     } else {
-        if ( loadingFile ) {
-            tabs()->removeTab(tabs()->currentIndex());
-            loadingFile = false;
+        finishRequest(request);
 
-        } else if ( savingFile ) {
-            savingFile = false;
-
-        } else if ( query ) {
+        if ( known && r.type == PendingRequest::Query && e != NULL
+             && e == tabs()->currentNetwork() ) {
             networkDock->setState(EditState);
             dockStateChanged();
         }
@@ -578,7 +799,5 @@ void MainWindow::engineCmd(QString cmd, QStringList args) {
         QString m = tr("Unknown command: ") + cmd +
                                     " (" + QString::number(args.length()) + ")";
         QMessageBox::critical(this, tr("Engine error"), m);
-
-        setEnabled(true);
     }
 }
@@ -22,15 +22,41 @@
 
 #include <QMainWindow>
 #include <QCloseEvent>
+#include <QPushButton>
+#include <QPointer>
+#include <QHash>
+#include <QVector>
+
+#include "engine.h"
+#include "querycache.h"
+#include "networksnapshot.h"
 
 class NetworkDock;
 class NodeDock;
 class NetworkEditorTabs;
-class Engine;
+class NetworkEditor;
+class EnginePool;
 class SettingsDialog;
+class QueryScheduler;
 
 #define MAIN_WINDOW_TITLE "Bayes GUI"
 
+/*
+ * Command sent to engine whose responses are still expected
+ */
+struct PendingRequest {
+    enum Type {
+        Network,
+        Query
+    };
+
+    Type type;
+    Engine *engine;                 // Engine request was sent to
+    QPointer<NetworkEditor> editor; // Editor request was made for
+    QString cacheKey;               // Key of query result in cache
+    NetworkSnapshot snapshot;       // Network query was made for
+};
+
 class MainWindow : public QMainWindow {
     Q_OBJECT
 
@@ -45,7 +71,8 @@ signals:
 
 public slots:
     void showMessage(QString message);
-    void engineCmd(QString cmd, QStringList args);
+    void engineCmd(int request, QString cmd, QVariantList args);
+    void engineQueryResult(int request, QVector<double> result);
 
 private slots:
     void fileNew();
@@ -53,6 +80,7 @@ private slots:
     void fileSave();
     void fileSaveAs();
     void fileSettings();
+    void settingsChanged();
 
     void helpAbout();
 
@@ -65,6 +93,7 @@ private slots:
     void networkChanged();
 
     void doQuery(bool createNet=false);
+    void cancelQuery();
 
 private:
     static MainWindow *instance;
@@ -73,11 +102,20 @@ private:
     void createDocks();
     void createMenus();
     void createEngine();
+    void createStatusBar();
 
     void saveSettings();
     void readSettings();
 
-    void defineNetwork();
+    void defineNetwork(NetworkEditor *e);
+    void addRequest(int id, Engine *engine, PendingRequest::Type type,
+                    NetworkEditor *e, QString cacheKey = QString(),
+                    NetworkSnapshot snapshot = NetworkSnapshot());
+    void finishRequest(int id);
+    void failQueuedQueries(int id, NetworkEditor *e);
+    void applyQueryResult(NetworkEditor *e, QueryResult result);
+    QueryResult currentQueryResult(NetworkEditor *e);
+    bool isStaleQuery(int request);
 
     NetworkEditorTabs *tabs();
     void createNewNetwork(QString fromFile = QString(""));
@@ -85,14 +123,24 @@ private:
     NetworkDock *networkDock;
     NodeDock *nodeDock;
 
-    Engine *engine;
+    EnginePool *engines;
 
     SettingsDialog *settingsDialog;
 
+    QPushButton *cancelQueryBtn;
+
+    QueryCache *queryCache;
+    QueryScheduler *queryScheduler;
+
+    // Commands in flight by their id
+    QHash<int, PendingRequest> requests;
+
+    // Networks engines have for editors
+    QHash<NetworkEditor*, SyncedNetwork> synced;
+
     // Status flags
-    bool loadingFile;
-    bool savingFile;
-    bool query;
+    int runningQueries;
+    bool engineNeedsNetwork;
 };
 
 #endif // MAINWINDOW_H
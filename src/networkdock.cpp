@@ -57,6 +57,10 @@ NetworkDock::NetworkDock(QWidget *parent) : QDockWidget(parent) {
     algorithmParamLabel = new QLabel(tr("N"));
     algorithmParamLabel->setVisible(false);
     layout->addRow(algorithmParamLabel, algorithmParam);
+    chosenAlgorithmLabel = new QLabel;
+    chosenAlgorithmLabel->setWordWrap(true);
+    chosenAlgorithmLabel->setVisible(false);
+    layout->addRow(chosenAlgorithmLabel);
 
     // Edit / query button row
     editQueryBtn = new QPushButton("Query");
@@ -145,6 +149,14 @@ void NetworkDock::addAlgorithm(QString name, bool hasParam) {
     algorithmCombo->addItem(name, QVariant(hasParam));
 }
 
+/*
+ * Shows which algorithm engine has chosen (when selection is automatic)
+ */
+void NetworkDock::setChosenAlgorithm(QString description) {
+    chosenAlgorithmLabel->setText(tr("Chosen: ") + description);
+    chosenAlgorithmLabel->setVisible(!description.isEmpty());
+}
+
 /*
  * Gets selected algorithm name
  */
@@ -204,6 +216,7 @@ void NetworkDock::algorithmChanged(int i) {
 
     algorithmParam->setVisible(v);
     algorithmParamLabel->setVisible(v);
+    setChosenAlgorithm(QString());
 }
 
 /*
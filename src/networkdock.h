@@ -57,6 +57,7 @@ public slots:
     void toggleNetwork(Network* net);
     void setState(NetworkDockState newState);
     void addAlgorithm(QString name, bool hasParam);
+    void setChosenAlgorithm(QString description);
 
 private slots:
     void nameChanged();
@@ -75,6 +76,7 @@ private:
     QComboBox *algorithmCombo;
     QLabel *algorithmParamLabel;
     QLineEdit *algorithmParam;
+    QLabel *chosenAlgorithmLabel;
     QPushButton *editQueryBtn;
     QPushButton *newNodeBtn;
     QPushButton *newEdgeBtn;
@@ -22,6 +22,7 @@
 #include <QMouseEvent>
 
 #include "network.h"
+#include "netfile.h"
 #include "graphicsnode.h"
 #include "graphicsedge.h"
 #include "node.h"
@@ -107,60 +108,61 @@ void NetworkEditor::cancelAdd() {
 }
 
 /*
- * Adds new named node to editor
+ * Reads network from file into editor (which has to be empty) and creates
+ * graphics nodes and edges for it; on failure `error' describes problem
  */
-void NetworkEditor::addNode(QString name, qreal x, qreal y) {
-    GraphicsNode *node = new GraphicsNode(name);
-    node->setX(x);
-    node->setY(y);
-    scene()->addItem(node);
-    node->setSelected(true);
-    nodeList << node;
-    connect(node, SIGNAL(evidenceChanged()), this, SIGNAL(evidenceChanged()));
-}
+bool NetworkEditor::load(QString fileName, QString &error) {
+    if ( !NetFile::read(fileName, network, error) ) {
+        return false;
+    }
 
-/*
- * Sets tables for named  named node
- */
-void NetworkEditor::setNodeTable(QString name, QList<double> tbl) {
-    GraphicsNode *n = getByName(name);
+    // Items are created while scene is detached from view and added to it
+    // in one pass, so there is no repaint or scene update per item
+    QGraphicsScene *s = scene();
+    setScene(NULL);
 
-    if ( n != NULL ) {
-        n->getNode()->setTable(tbl);
+    QList<QGraphicsItem*> items;
+    for ( int id=0; id<network->nodeCount(); ++id ) {
+        QVariantHash meta = network->meta(id);
+        items << createNode(network->node(id), meta.value("x").toDouble(),
+                            meta.value("y").toDouble());
     }
-}
 
-/*
- * Set list of values for named node
- */
-void NetworkEditor::setNodeVals(QString name, QStringList vals) {
-    GraphicsNode *n = getByName(name);
+    for ( int id=0; id<network->nodeCount(); ++id ) {
+        foreach ( int p, network->parents(id) ) {
+            items << createEdge(nodeList.at(p), nodeList.at(id));
+        }
+    }
 
-    if ( n != NULL ) {
-        n->getNode()->setValueList(vals);
+    foreach ( QGraphicsItem *item, items ) {
+        s->addItem(item);
     }
+    setScene(s);
+
+    isModified = false;
+
+    return true;
 }
 
 /*
- * Set node X position by name
+ * Adds new named node to editor
  */
-void NetworkEditor::setNodeX(QString name, qreal x) {
-    GraphicsNode *n = getByName(name);
-
-    if ( n != NULL ) {
-        n->setX(x);
-    }
+void NetworkEditor::addNode(QString name, qreal x, qreal y) {
+    GraphicsNode *node = createNode(network->addNode(name), x, y);
+    scene()->addItem(node);
+    node->setSelected(true);
 }
 
 /*
- * Set node Y postiion bt name
+ * Creates graphics node for node of network (it is not added to scene)
  */
-void NetworkEditor::setNodeY(QString name, qreal y) {
-    GraphicsNode *n = getByName(name);
+GraphicsNode* NetworkEditor::createNode(Node *n, qreal x, qreal y) {
+    GraphicsNode *node = new GraphicsNode(n);
+    node->setPos(x, y);
+    nodeList << node;
+    connect(node, SIGNAL(evidenceChanged()), this, SIGNAL(evidenceChanged()));
 
-    if ( n != NULL ) {
-        n->setY(y);
-    }
+    return node;
 }
 
 /*
@@ -239,21 +241,6 @@ Network* NetworkEditor::getNetwork() {
     return network;
 }
 
-/*
- * Adds edge between two nodes by name
-   (this method should be used carefully, only on valid networks with no
-    duplicate node names - ie. ones freshly loaded from file)
- */
-void NetworkEditor::addEdge(QString src, QString dest) {
-    GraphicsNode *srcNode = getByName(src);
-    GraphicsNode *destNode = getByName(dest);
-
-    if ( srcNode!=NULL && destNode!=NULL ) {
-        addEdge(srcNode, destNode);
-        destNode->setSelected(true);
-    }
-}
-
 /*
  * Adds edge between two graphical nodes
  */
@@ -268,28 +255,40 @@ bool NetworkEditor::addEdge(GraphicsNode *src, GraphicsNode *dst) {
         return false;
     }
 
-    // Create edge
+    dst->getNode()->addParent(src->getNode());
+    scene()->addItem(createEdge(src, dst));
+
+    return true;
+}
+
+/*
+ * Creates graphics edge for existing parent of node (it is not added to
+ * scene)
+ */
+GraphicsEdge* NetworkEditor::createEdge(GraphicsNode *src,
+                                        GraphicsNode *dst) {
     GraphicsEdge *edge = new GraphicsEdge(src, dst);
 
     // Add edge to nodes
     src->addEdge(edge);
     dst->addEdge(edge);
 
-    // Add them to the scene
-    scene()->addItem(edge);
-
-    return true;
+    return edge;
 }
 
 /*
  * Fetches graphics node by name
  */
 GraphicsNode* NetworkEditor::getByName(QString name) {
-    foreach(GraphicsNode *n, nodeList) {
+    return getById(network->nodeId(name));
+}
 
-        if ( n->getNode()->name() == name ) {
-            return n;
-        }
+/*
+ * Fetches graphics node by id of its node in network
+ */
+GraphicsNode* NetworkEditor::getById(int id) {
+    if ( id >= 0 && id < nodeList.length() ) {
+        return nodeList.at(id);
     }
 
     return NULL;
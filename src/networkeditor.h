@@ -24,6 +24,7 @@
 
 class Network;
 class GraphicsNode;
+class GraphicsEdge;
 class Node;
 
 enum NetworkEditorState {
@@ -44,11 +45,14 @@ public:
     GraphicsNode *selectedGNode();
     Network* getNetwork();
     GraphicsNode *getByName(QString name);
+    GraphicsNode *getById(int id);
     QList<GraphicsNode*> nodes() const;
 
     QString fileName() const;
     void setFileName(QString name);
 
+    bool load(QString fileName, QString &error);
+
 protected:
     void mouseReleaseEvent(QMouseEvent *event);
 
@@ -63,20 +67,16 @@ public slots:
     void cancelAdd();
 
     void addNode(QString name, qreal x=0.0, qreal y=0.0);
-    void setNodeVals(QString name, QStringList vals);
-    void setNodeTable(QString name, QList<double>);
-    void addEdge(QString src, QString dest);
     bool addEdge(GraphicsNode *src, GraphicsNode *dst);
 
     void updateNode(bool modified=true);
     void networkModified(bool modified);
 
-    void setNodeX(QString name, qreal x);
-    void setNodeY(QString name, qreal y);
-
     void queryMode(bool t);
 
 private:
+    GraphicsNode* createNode(Node *n, qreal x, qreal y);
+    GraphicsEdge* createEdge(GraphicsNode *src, GraphicsNode *dst);
 
     NetworkEditorState state;
     Network *network;
@@ -84,6 +84,7 @@ private:
 
     GraphicsNode* edgeFirstNode;
 
+    // Graphics nodes in order of creation (index is id of node in network)
     QList<GraphicsNode*> nodeList;
 
     QString fName;
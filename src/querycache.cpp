@@ -0,0 +1,127 @@
+/*
+    Copyright (C) 2012 Ivan Radicek
+
+    This file is part of Bayes.
+
+    Bayes is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bayes is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Bayes.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "querycache.h"
+
+#include <QStringList>
+
+#include "node.h"
+
+/*
+ * Creates cache holding at most `size' query results
+ */
+QueryCache::QueryCache(int size, QObject *parent) : QObject(parent) {
+    cache.setMaxCost(size);
+    nHits = nMisses = 0;
+}
+
+/*
+ * Builds cache key from network (structure and parameters), query arguments
+ * (algorithm, its parameter and evidence) and engine options
+ */
+QString QueryCache::key(QList<Node*> nodes, QVariantList queryArgs,
+                        QVariantList options) {
+    quint64 h = 0;
+
+    // Network - node contents and parent names (in node order)
+    foreach ( Node *n, nodes ) {
+        quint64 nh = n->hash();
+        h = Node::hashBytes(h, &nh, sizeof(nh));
+
+        foreach ( Node *p, n->getParents() ) {
+            h = Node::hashString(h, p->name());
+        }
+    }
+
+    // Algorithm and parameters come first, evidence pairs follow in any
+    // order - sort them so same evidence always gives same key
+    QStringList params;
+    QStringList evidence;
+    foreach ( QVariant v, queryArgs ) {
+        if ( v.type() == QVariant::List ) {
+            QStringList pair;
+            foreach ( QVariant x, v.toList() ) {
+                pair << x.toString();
+            }
+            evidence << pair.join("\x1f");
+
+        } else {
+            params << v.toString();
+        }
+    }
+    evidence.sort();
+
+    foreach ( QVariant v, options ) {
+        params << v.toString();
+    }
+
+    return QString::number(h, 16) + "\x1e" + params.join("\x1f") + "\x1e" +
+            evidence.join("\x1e");
+}
+
+/*
+ * Looks up query result; returns true (and sets `result') on cache hit
+ */
+bool QueryCache::lookup(QString key, QueryResult &result) {
+    QueryResult *r = cache.object(key);
+
+    if ( r == NULL ) {
+        ++nMisses;
+        return false;
+    }
+
+    ++nHits;
+    result = *r;
+    return true;
+}
+
+/*
+ * Stores query result (least recently used one is dropped if cache is full)
+ */
+void QueryCache::insert(QString key, QueryResult result) {
+    cache.insert(key, new QueryResult(result));
+}
+
+/*
+ * Changes maximal number of cached results
+ */
+void QueryCache::setMaxSize(int size) {
+    cache.setMaxCost(size);
+}
+
+/*
+ * Drops all cached results
+ */
+void QueryCache::clear() {
+    cache.clear();
+}
+
+/*
+ * Gets number of queries answered from cache
+ */
+int QueryCache::hits() const {
+    return nHits;
+}
+
+/*
+ * Gets number of queries which were not found in cache
+ */
+int QueryCache::misses() const {
+    return nMisses;
+}
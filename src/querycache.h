@@ -0,0 +1,60 @@
+/*
+    Copyright (C) 2012 Ivan Radicek
+
+    This file is part of Bayes.
+
+    Bayes is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bayes is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Bayes.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef QUERYCACHE_H
+#define QUERYCACHE_H
+
+#include <QObject>
+#include <QCache>
+#include <QVariantList>
+
+class Node;
+
+typedef QList<QList<double> > QueryResult;
+
+class QueryCache : public QObject {
+    Q_OBJECT
+
+public:
+    QueryCache(int size, QObject *parent = 0);
+
+    static QString key(QList<Node*> nodes, QVariantList queryArgs,
+                       QVariantList options = QVariantList());
+
+    bool lookup(QString key, QueryResult &result);
+    void insert(QString key, QueryResult result);
+
+    void setMaxSize(int size);
+    void clear();
+
+    int hits() const;
+    int misses() const;
+
+signals:
+
+public slots:
+
+private:
+    QCache<QString, QueryResult> cache;
+
+    int nHits;
+    int nMisses;
+};
+
+#endif // QUERYCACHE_H
@@ -0,0 +1,127 @@
+/*
+    Copyright (C) 2012 Ivan Radicek
+
+    This file is part of Bayes.
+
+    Bayes is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bayes is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Bayes.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "queryscheduler.h"
+
+#include <QTimer>
+
+#include "engine.h"
+
+/*
+ * Creates scheduler coalescing evidence changes made within `delay' ms
+ */
+QueryScheduler::QueryScheduler(int delay, QObject *parent) : QObject(parent) {
+    timer = new QTimer(this);
+    timer->setSingleShot(true);
+    setDelay(delay);
+    connect(timer, SIGNAL(timeout()), this, SLOT(timeout()));
+}
+
+/*
+ * Sets how long to wait for further evidence changes before querying
+ */
+void QueryScheduler::setDelay(int msec) {
+    timer->setInterval(msec);
+}
+
+/*
+ * Query for latest evidence of `session' has been sent to `engine' - all
+ * earlier ones of session are outdated now
+ */
+void QueryScheduler::started(int request, Engine *engine, QObject *session) {
+    supersede(session);
+
+    Query q;
+    q.engine = engine;
+    q.session = session;
+    q.cancelled = false;
+    queries.insert(request, q);
+
+    latest[session] = request;
+}
+
+/*
+ * Latest evidence of `session' has been answered without engine (from
+ * cache) - all queries of session still running are outdated now
+ */
+void QueryScheduler::answered(QObject *session) {
+    supersede(session);
+    latest.remove(session);
+}
+
+/*
+ * Engine is done with query (it finished, was cancelled or failed)
+ */
+void QueryScheduler::finished(int request) {
+    queries.remove(request);
+}
+
+/*
+ * Checks if query was made for evidence which is not latest any more
+ */
+bool QueryScheduler::isStale(int request) const {
+    if ( !queries.contains(request) ) {
+        return true;
+    }
+
+    return latest.value(queries.value(request).session) != request;
+}
+
+/*
+ * Evidence changed - (re)start waiting for further changes
+ */
+void QueryScheduler::evidenceChanged() {
+    if ( timer->interval() > 0 ) {
+        timer->start();
+
+    } else {
+        emit queryDue();
+    }
+}
+
+/*
+ * Forgets evidence changes not queried yet
+ */
+void QueryScheduler::stop() {
+    timer->stop();
+}
+
+/*
+ * No more evidence changes arrived in time - latest evidence should be queried
+ */
+void QueryScheduler::timeout() {
+    emit queryDue();
+}
+
+/*
+ * Cancels pending timer and every running query of `session' (they are all
+ * outdated)
+ */
+void QueryScheduler::supersede(QObject *session) {
+    timer->stop();
+
+    // Each one is cancelled only once - its response is ignored anyway
+    QHash<int, Query>::iterator i;
+    for ( i = queries.begin(); i != queries.end(); ++i ) {
+        if ( i.value().session == session && !i.value().cancelled ) {
+            i.value().engine->cancel(i.key());
+            i.value().cancelled = true;
+        }
+    }
+}
@@ -0,0 +1,77 @@
+/*
+    Copyright (C) 2012 Ivan Radicek
+
+    This file is part of Bayes.
+
+    Bayes is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bayes is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Bayes.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef QUERYSCHEDULER_H
+#define QUERYSCHEDULER_H
+
+#include <QObject>
+#include <QHash>
+
+class QTimer;
+
+class Engine;
+
+/*
+ * Stands between evidence changes and engines: changes arriving within
+ * `delay' milliseconds of each other are coalesced into one query, and
+ * queries made for older evidence of a session (editor tab) are cancelled
+ * once a newer one is sent for it. Results of such outdated (stale) queries
+ * should be dropped.
+ */
+class QueryScheduler : public QObject {
+    Q_OBJECT
+
+public:
+    QueryScheduler(int delay, QObject *parent = 0);
+
+    void setDelay(int msec);
+
+    void started(int request, Engine *engine, QObject *session);
+    void answered(QObject *session);
+    void finished(int request);
+
+    bool isStale(int request) const;
+
+signals:
+    void queryDue();
+
+public slots:
+    void evidenceChanged();
+    void stop();
+
+private slots:
+    void timeout();
+
+private:
+    void supersede(QObject *session);
+
+    QTimer *timer;
+
+    // Query sent to engine and not finished yet
+    struct Query {
+        Engine *engine;
+        QObject *session;
+        bool cancelled;
+    };
+
+    QHash<int, Query> queries;
+    QHash<QObject*, int> latest; // Query for latest evidence of session
+};
+
+#endif // QUERYSCHEDULER_H
@@ -21,6 +21,7 @@
 
 #include <QDir>
 #include <QApplication>
+#include <QThread>
 
 // Reference to (single) instance of settings
 Settings* Settings::instance = 0;
@@ -62,6 +63,22 @@ QString Settings::enginePath(bool expand) {
     return expand ? expandPath(path) : path;
 }
 
+/*
+ * Saves path of engine daemon socket to settings (empty if daemon should not
+ * be used)
+ */
+void Settings::setEngineSocket(QString path) {
+    getInstance()->setValue("engine/socket", path);
+}
+
+/*
+ * Gets path of engine daemon socket from settings (daemon is not used by
+ * default)
+ */
+QString Settings::engineSocket() {
+    return getInstance()->value("engine/socket").toString();
+}
+
 /*
  * Set *diff-small-value* param
  */
@@ -90,6 +107,79 @@ int Settings::diffCheckPeriod() {
     return getInstance()->value("engine/check-period", 0).toInt();
 }
 
+/*
+ * Set number of query results kept in cache
+ */
+void Settings::setQueryCacheSize(int size) {
+    getInstance()->setValue("engine/query-cache-size", size);
+}
+
+/*
+ * Get number of query results kept in cache
+ */
+int Settings::queryCacheSize() {
+    return getInstance()->value("engine/query-cache-size", 64).toInt();
+}
+
+/*
+ * Set time (in ms) to wait for further evidence changes before querying
+ */
+void Settings::setQueryDelay(int msec) {
+    getInstance()->setValue("engine/query-delay", msec);
+}
+
+/*
+ * Get time (in ms) to wait for further evidence changes before querying
+ */
+int Settings::queryDelay() {
+    return getInstance()->value("engine/query-delay", 150).toInt();
+}
+
+/*
+ * Set largest number of engines run at once
+ */
+void Settings::setEnginePoolSize(int size) {
+    getInstance()->setValue("engine/pool-size", size);
+}
+
+/*
+ * Get largest number of engines run at once (one per core by default)
+ */
+int Settings::enginePoolSize() {
+    return getInstance()->value("engine/pool-size",
+                                qMax(QThread::idealThreadCount(), 1)).toInt();
+}
+
+/*
+ * Set size (in bytes) from which arrays are passed to and from engine through
+ * shared memory (0 disables it)
+ */
+void Settings::setSharedMemoryThreshold(int bytes) {
+    getInstance()->setValue("engine/shared-memory-threshold", bytes);
+}
+
+/*
+ * Get size (in bytes) from which arrays are passed through shared memory
+ */
+int Settings::sharedMemoryThreshold() {
+    return getInstance()->value("engine/shared-memory-threshold",
+                                1024*1024).toInt();
+}
+
+/*
+ * Set protocol used to communicate with engine ("binary" or "sexp")
+ */
+void Settings::setEngineProtocol(QString protocol) {
+    getInstance()->setValue("engine/protocol", protocol);
+}
+
+/*
+ * Get protocol used to communicate with engine
+ */
+QString Settings::engineProtocol() {
+    return getInstance()->value("engine/protocol", "binary").toString();
+}
+
 /*
  * Saves file save path to settings
  */
@@ -36,12 +36,30 @@ public:
     static void setEnginePath(QString path);
     static QString enginePath(bool expand = true);
 
+    static void setEngineSocket(QString path);
+    static QString engineSocket();
+
     static void setDiffSmallValue(double val);
     static double diffSmallValue();
 
     static void setDiffCheckPeriod(int val);
     static int diffCheckPeriod();
 
+    static void setQueryCacheSize(int size);
+    static int queryCacheSize();
+
+    static void setQueryDelay(int msec);
+    static int queryDelay();
+
+    static void setEnginePoolSize(int size);
+    static int enginePoolSize();
+
+    static void setSharedMemoryThreshold(int bytes);
+    static int sharedMemoryThreshold();
+
+    static void setEngineProtocol(QString protocol);
+    static QString engineProtocol();
+
     static void setSavePath(QString path);
     static QString savePath();
 
@@ -35,6 +35,12 @@ SettingsDialog::SettingsDialog(QWidget *parent) : QDialog(parent) {
     enginePath->setText(Settings::enginePath(false));
     dialogLayout->addRow(tr("Engine path"), enginePath);
 
+    // Add engine daemon socket item (empty if daemon should not be used,
+    // which is default)
+    engineSocket = new QLineEdit(this);
+    engineSocket->setText(Settings::engineSocket());
+    dialogLayout->addRow(tr("Engine daemon socket"), engineSocket);
+
     // Add small value item
     diffSmallValue = new QLineEdit(this);
     diffSmallValue->setText(QString::number(Settings::diffSmallValue()));
@@ -45,6 +51,36 @@ SettingsDialog::SettingsDialog(QWidget *parent) : QDialog(parent) {
     diffCheckPeriod->setText(QString::number(Settings::diffCheckPeriod()));
     dialogLayout->addRow(tr("*diff-check-period*"), diffCheckPeriod);
 
+    // Add query cache size item
+    queryCacheSize = new QLineEdit(this);
+    queryCacheSize->setText(QString::number(Settings::queryCacheSize()));
+    dialogLayout->addRow(tr("Query cache size"), queryCacheSize);
+
+    // Add query delay item
+    queryDelay = new QLineEdit(this);
+    queryDelay->setText(QString::number(Settings::queryDelay()));
+    dialogLayout->addRow(tr("Query delay (ms)"), queryDelay);
+
+    // Add engine pool size item (used when application is started)
+    enginePoolSize = new QLineEdit(this);
+    enginePoolSize->setText(QString::number(Settings::enginePoolSize()));
+    dialogLayout->addRow(tr("Engine pool size"), enginePoolSize);
+
+    // Add shared memory threshold item (used when engine is started)
+    sharedMemoryThreshold = new QLineEdit(this);
+    sharedMemoryThreshold->setText(
+                        QString::number(Settings::sharedMemoryThreshold()));
+    dialogLayout->addRow(tr("Shared memory threshold (bytes)"),
+                         sharedMemoryThreshold);
+
+    // Add engine protocol item (used when engine is started)
+    engineProtocol = new QComboBox(this);
+    engineProtocol->addItem(tr("Binary"), "binary");
+    engineProtocol->addItem(tr("S-Expressions"), "sexp");
+    engineProtocol->setCurrentIndex(
+                        engineProtocol->findData(Settings::engineProtocol()));
+    dialogLayout->addRow(tr("Engine protocol"), engineProtocol);
+
     // Add buttons
     QDialogButtonBox *buttonBox = new QDialogButtonBox(this);
     buttonBox->setStandardButtons(QDialogButtonBox::Ok |
@@ -85,10 +121,49 @@ void SettingsDialog::accept() {
         return;
     }
 
+    int cacheSize = queryCacheSize->text().toInt(&ok);
+    if ( !ok || cacheSize < 0 ) {
+        QMessageBox::critical(this, tr("Settings error"),
+                              tr("Query cache size should be non-negative "\
+                                 "integer."));
+        return;
+    }
+
+    int delay = queryDelay->text().toInt(&ok);
+    if ( !ok || delay < 0 ) {
+        QMessageBox::critical(this, tr("Settings error"),
+                              tr("Query delay should be non-negative "\
+                                 "integer."));
+        return;
+    }
+
+    int poolSize = enginePoolSize->text().toInt(&ok);
+    if ( !ok || poolSize < 1 ) {
+        QMessageBox::critical(this, tr("Settings error"),
+                              tr("Engine pool size should be positive "\
+                                 "integer."));
+        return;
+    }
+
+    int threshold = sharedMemoryThreshold->text().toInt(&ok);
+    if ( !ok || threshold < 0 ) {
+        QMessageBox::critical(this, tr("Settings error"),
+                              tr("Shared memory threshold should be "\
+                                 "non-negative integer."));
+        return;
+    }
+
     // And store
     Settings::setEnginePath(enginePath->text());
+    Settings::setEngineSocket(engineSocket->text());
     Settings::setDiffCheckPeriod(checkPeriod);
     Settings::setDiffSmallValue(smallValue);
+    Settings::setQueryCacheSize(cacheSize);
+    Settings::setQueryDelay(delay);
+    Settings::setEnginePoolSize(poolSize);
+    Settings::setSharedMemoryThreshold(threshold);
+    Settings::setEngineProtocol(engineProtocol->itemData(
+                            engineProtocol->currentIndex()).toString());
     QDialog::accept();
 }
 
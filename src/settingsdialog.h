@@ -22,6 +22,7 @@
 
 #include <QDialog>
 #include <QLineEdit>
+#include <QComboBox>
 
 class SettingsDialog : public QDialog {
     Q_OBJECT
@@ -36,8 +37,14 @@ public slots:
 
 private:
     QLineEdit *enginePath;
+    QLineEdit *engineSocket;
     QLineEdit *diffSmallValue;
     QLineEdit *diffCheckPeriod;
+    QLineEdit *queryCacheSize;
+    QLineEdit *queryDelay;
+    QLineEdit *enginePoolSize;
+    QLineEdit *sharedMemoryThreshold;
+    QComboBox *engineProtocol;
 };
 
 #endif // SETTINGSDIALOG_H
@@ -0,0 +1,163 @@
+/*
+    Copyright (C) 2012 Ivan Radicek
+
+    This file is part of Bayes.
+
+    Bayes is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bayes is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Bayes.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "sharedsegment.h"
+
+#include <QAtomicInt>
+
+#ifdef Q_OS_UNIX
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#endif
+
+// Number of segments created so far (makes names unique)
+static QAtomicInt segmentCount(0);
+
+/*
+ * Checks if name is plain segment name - slash followed by letters, digits,
+ * dots, underscores and dashes (without "..")
+ */
+static bool validName(const QByteArray &name) {
+    if ( name.size() < 2 || name.at(0) != '/' || name.contains("..") ) {
+        return false;
+    }
+
+    for ( int i=1; i<name.size(); ++i ) {
+        char c = name.at(i);
+        if ( !(c >= 'a' && c <= 'z') && !(c >= 'A' && c <= 'Z') &&
+             !(c >= '0' && c <= '9') && c != '.' && c != '_' && c != '-' ) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/*
+ * Checks if shared memory is available on this platform
+ */
+bool SharedSegment::isSupported() {
+#ifdef Q_OS_UNIX
+    return true;
+#else
+    return false;
+#endif
+}
+
+/*
+ * Creates segment holding `values'; returns its name (empty on failure)
+ */
+QByteArray SharedSegment::write(const QList<double> &values) {
+#ifdef Q_OS_UNIX
+    int n = segmentCount.fetchAndAddRelaxed(1);
+    QByteArray name = "/bayes-gui-" + QByteArray::number((int) getpid()) +
+                      "-" + QByteArray::number(n);
+    size_t size = values.length() * sizeof(double);
+
+    int fd = shm_open(name.constData(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if ( fd < 0 ) {
+        return QByteArray();
+    }
+
+    bool ok = ftruncate(fd, size) == 0;
+    if ( ok && size > 0 ) {
+        void *p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ok = p != MAP_FAILED;
+
+        if ( ok ) {
+            double *d = (double*) p;
+            for ( int i=0; i<values.length(); ++i ) {
+                d[i] = values.at(i);
+            }
+            munmap(p, size);
+        }
+    }
+    close(fd);
+
+    if ( !ok ) {
+        shm_unlink(name.constData());
+        return QByteArray();
+    }
+
+    return name;
+#else
+    Q_UNUSED(values);
+    return QByteArray();
+#endif
+}
+
+/*
+ * Copies `count' doubles from segment `name' to `values' and removes segment;
+ * returns false if segment can not be read or name is not plain segment name
+ */
+bool SharedSegment::read(QByteArray name, quint32 count,
+                         QVector<double> &values) {
+#ifdef Q_OS_UNIX
+    if ( !validName(name) ) {
+        return false;
+    }
+
+    size_t size = (size_t) count * sizeof(double);
+
+    int fd = shm_open(name.constData(), O_RDONLY, 0);
+    if ( fd < 0 ) {
+        return false;
+    }
+    shm_unlink(name.constData());
+
+    struct stat st;
+    bool ok = fstat(fd, &st) == 0 && (size_t) st.st_size >= size;
+    if ( ok ) {
+        values.resize(count);
+        if ( size > 0 ) {
+            void *p = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+            ok = p != MAP_FAILED;
+
+            if ( ok ) {
+                memcpy(values.data(), p, size);
+                munmap(p, size);
+            }
+        }
+    }
+    close(fd);
+
+    return ok;
+#else
+    Q_UNUSED(name);
+    Q_UNUSED(count);
+    Q_UNUSED(values);
+    return false;
+#endif
+}
+
+/*
+ * Removes segment `name' if it still exists
+ */
+void SharedSegment::remove(QByteArray name) {
+#ifdef Q_OS_UNIX
+    if ( validName(name) ) {
+        shm_unlink(name.constData());
+    }
+#else
+    Q_UNUSED(name);
+#endif
+}
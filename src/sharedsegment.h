@@ -0,0 +1,44 @@
+/*
+    Copyright (C) 2012 Ivan Radicek
+
+    This file is part of Bayes.
+
+    Bayes is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bayes is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Bayes.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SHAREDSEGMENT_H
+#define SHAREDSEGMENT_H
+
+#include <QByteArray>
+#include <QList>
+#include <QVector>
+
+/*
+ * Bulk arrays of doubles passed to and from engine through POSIX shared
+ * memory instead of pipe. Writer creates named segment holding doubles (in
+ * native byte order, both sides run on same machine) and sends only its name;
+ * reader copies them out and removes segment. Writer removes segments reader
+ * never got to (removing segment twice is harmless).
+ */
+class SharedSegment {
+
+public:
+    static bool isSupported();
+
+    static QByteArray write(const QList<double> &values);
+    static bool read(QByteArray name, quint32 count, QVector<double> &values);
+    static void remove(QByteArray name);
+};
+
+#endif // SHAREDSEGMENT_H
@@ -0,0 +1,92 @@
+/*
+    Copyright (C) 2012 Ivan Radicek
+
+    This file is part of Bayes.
+
+    Bayes is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bayes is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Bayes.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+
+#include <QAtomicPointer>
+
+/*
+ * Unbounded lock-free queue with one producer and one consumer thread. Items
+ * are kept in linked list which always starts with already consumed item, so
+ * producer and consumer never touch same link.
+ */
+template <class T>
+class SpscQueue {
+
+public:
+    SpscQueue() {
+        head = tail = new Item();
+    }
+
+    ~SpscQueue() {
+        T item;
+        while ( pop(item) ) {
+        }
+        delete head;
+    }
+
+    /*
+     * Adds item to end of queue (producer thread only)
+     */
+    void push(const T &value) {
+        Item *item = new Item();
+        item->value = value;
+
+        // Release makes item contents visible before link to it
+        tail->next.fetchAndStoreRelease(item);
+        tail = item;
+    }
+
+    /*
+     * Takes item from start of queue; returns false if queue is empty
+     * (consumer thread only)
+     */
+    bool pop(T &value) {
+        Item *next = head->next.fetchAndAddAcquire(0);
+        if ( next == 0 ) {
+            return false;
+        }
+
+        value = next->value;
+        next->value = T();
+
+        delete head;
+        head = next;
+
+        return true;
+    }
+
+private:
+    struct Item {
+        Item() : next(0) {}
+
+        T value;
+        QAtomicPointer<Item> next;
+    };
+
+    Item *head; // Consumed item before first one (consumer side)
+    Item *tail; // Last item (producer side)
+
+    // Not copyable
+    SpscQueue(const SpscQueue&);
+    SpscQueue& operator=(const SpscQueue&);
+};
+
+#endif // SPSCQUEUE_H
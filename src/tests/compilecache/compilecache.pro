@@ -0,0 +1,15 @@
+# Cache of compiled junction trees
+
+QT = core testlib
+CONFIG += console testcase
+CONFIG -= app_bundle
+
+TARGET = tst_compilecache
+TEMPLATE = app
+
+INCLUDEPATH += ../../libbayes
+LIBS += -L$$OUT_PWD/../../libbayes -lbayes
+unix:QMAKE_RPATHDIR += $$OUT_PWD/../../libbayes
+
+SOURCES += \
+    tst_compilecache.cpp
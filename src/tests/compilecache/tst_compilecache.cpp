@@ -0,0 +1,307 @@
+/*
+    Copyright (C) 2012 Ivan Radicek
+
+    This file is part of Bayes.
+
+    Bayes is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bayes is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Bayes.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <QtTest>
+#include <QCoreApplication>
+
+#include <string.h>
+
+#include "compilecache.h"
+#include "junctiontree.h"
+#include "network.h"
+#include "node.h"
+
+/*
+ * Tests of compile cache - tree is stored under key of network, reused only
+ * for network with the same key and any change influencing compilation
+ * changes key
+ */
+class TestCompileCache : public QObject {
+    Q_OBJECT
+
+private slots:
+    void init();
+    void cleanup();
+
+    void keyIgnoresNames();
+    void keyChanges();
+    void storedAndReused();
+    void changedNetwork();
+    void wrongFile();
+    void corruptFile();
+    void disabled();
+
+private:
+    static void build(Network &network);
+    static void compare(JunctionTree &tree, const NetworkSnapshot &network);
+    QStringList cached() const;
+
+    QString dir;
+};
+
+/*
+ * Creates empty cache directory for each test
+ */
+void TestCompileCache::init() {
+    dir = QString("%1/tst_compilecache-%2").arg(QDir::tempPath())
+          .arg(QCoreApplication::applicationPid());
+    cleanup();
+    QVERIFY(QDir().mkpath(dir));
+}
+
+/*
+ * Removes cache directory
+ */
+void TestCompileCache::cleanup() {
+    QDir d(dir);
+    foreach ( QString f, d.entryList(QDir::Files) ) {
+        d.remove(f);
+    }
+    QDir().rmdir(dir);
+}
+
+/*
+ * Builds network A -> B, A -> C, B -> C
+ */
+void TestCompileCache::build(Network &network) {
+    int a = network.addNode("A")->id();
+    network.setValues(a, QStringList() << "T" << "F");
+    network.setTable(a, QList<double>() << 0.3 << 0.7);
+
+    int b = network.addNode("B")->id();
+    network.setValues(b, QStringList() << "T" << "F");
+    network.addParent(b, a);
+    network.setTable(b, QList<double>() << 0.9 << 0.1 << 0.2 << 0.8);
+
+    int c = network.addNode("C")->id();
+    network.setValues(c, QStringList() << "T" << "F");
+    network.addParent(c, a);
+    network.addParent(c, b);
+    network.setTable(c, QList<double>() << 0.5 << 0.5 << 0.6 << 0.4
+                                        << 0.7 << 0.3 << 0.8 << 0.2);
+}
+
+/*
+ * Checks marginals of all nodes of tree (with evidence on C) against tree
+ * compiled right away
+ */
+void TestCompileCache::compare(JunctionTree &tree,
+                               const NetworkSnapshot &network) {
+    JunctionTree fresh(network);
+    QCOMPARE(tree.nodeCount(), fresh.nodeCount());
+
+    tree.setEvidence(2, 0);
+    fresh.setEvidence(2, 0);
+
+    for ( int v=0; v<fresh.nodeCount(); ++v ) {
+        QVector<double> found = tree.marginal(v);
+        QVector<double> expected = fresh.marginal(v);
+
+        QCOMPARE(found.size(), expected.size());
+        for ( int i=0; i<found.size(); ++i ) {
+            QVERIFY(qAbs(found.at(i) - expected.at(i)) < 1e-12);
+        }
+    }
+}
+
+/*
+ * Gets names of files in cache directory
+ */
+QStringList TestCompileCache::cached() const {
+    return QDir(dir).entryList(QDir::Files, QDir::Name);
+}
+
+/*
+ * Names and meta data do not change compiled tree, so they keep key
+ */
+void TestCompileCache::keyIgnoresNames() {
+    Network n1;
+    Network n2;
+    build(n1);
+    build(n2);
+
+    QCOMPARE(JunctionTree::key(n1.snapshot()),
+             JunctionTree::key(n2.snapshot()));
+
+    n2.setName("other");
+    n2.setNodeName(0, "X");
+    n2.renameValue(1, 0, "yes");
+    n2.setMeta(2, "x", 100);
+    QCOMPARE(JunctionTree::key(n1.snapshot()),
+             JunctionTree::key(n2.snapshot()));
+}
+
+/*
+ * Tables, parents and cardinalities change key
+ */
+void TestCompileCache::keyChanges() {
+    Network original;
+    build(original);
+    quint64 key = JunctionTree::key(original.snapshot());
+
+    Network table;
+    build(table);
+    table.setProbability(0, 0, 0.4);
+    table.setProbability(0, 1, 0.6);
+    QVERIFY(JunctionTree::key(table.snapshot()) != key);
+
+    Network parents;
+    build(parents);
+    parents.removeParent(2, 1);
+    parents.setTable(2, QList<double>() << 0.5 << 0.5 << 0.6 << 0.4);
+    QVERIFY(JunctionTree::key(parents.snapshot()) != key);
+
+    Network values;
+    build(values);
+    values.insertValue(0, -1, "X");
+    values.setTable(0, QList<double>() << 0.3 << 0.6 << 0.1);
+    QVERIFY(JunctionTree::key(values.snapshot()) != key);
+}
+
+/*
+ * Compiled tree is stored in file named by key and loaded next time
+ */
+void TestCompileCache::storedAndReused() {
+    Network network;
+    build(network);
+    NetworkSnapshot s = network.snapshot();
+    CompileCache cache(dir);
+
+    JunctionTree tree = cache.tree(s);
+    QString name = QString("%1.jt").arg(JunctionTree::key(s), 16, 16,
+                                        QChar('0'));
+    QCOMPARE(cached(), QStringList() << name);
+    compare(tree, s);
+
+    QDateTime written = QFileInfo(dir + "/" + name).lastModified();
+    JunctionTree loaded = cache.tree(s);
+    QCOMPARE(cached(), QStringList() << name);
+    QCOMPARE(QFileInfo(dir + "/" + name).lastModified(), written);
+    compare(loaded, s);
+}
+
+/*
+ * Changed network gets its own tree, not one of network it was before
+ */
+void TestCompileCache::changedNetwork() {
+    Network network;
+    build(network);
+    CompileCache cache(dir);
+    cache.tree(network.snapshot());
+
+    network.setTable(1, QList<double>() << 0.1 << 0.9 << 0.6 << 0.4);
+    NetworkSnapshot s = network.snapshot();
+    JunctionTree tree = cache.tree(s);
+
+    QCOMPARE(cached().size(), 2);
+    compare(tree, s);
+}
+
+/*
+ * File which is not tree of network (stored under its name by mistake) is
+ * not used - tree is compiled again and file replaced
+ */
+void TestCompileCache::wrongFile() {
+    Network n1;
+    build(n1);
+    Network n2;
+    build(n2);
+    n2.setTable(0, QList<double>() << 0.9 << 0.1);
+
+    NetworkSnapshot s1 = n1.snapshot();
+    NetworkSnapshot s2 = n2.snapshot();
+    CompileCache cache(dir);
+    cache.tree(s1);
+
+    QString name1 = QString("%1/%2.jt").arg(dir)
+                    .arg(JunctionTree::key(s1), 16, 16, QChar('0'));
+    QString name2 = QString("%1/%2.jt").arg(dir)
+                    .arg(JunctionTree::key(s2), 16, 16, QChar('0'));
+    QVERIFY(QFile::copy(name1, name2));
+
+    JunctionTree tree = cache.tree(s2);
+    compare(tree, s2);
+
+    JunctionTree check;
+    QVERIFY(check.load(name2, JunctionTree::key(s2), s2));
+    QVERIFY(!check.load(name1, JunctionTree::key(s2), s2));
+}
+
+/*
+ * File with right key whose structure is not junction tree of network is not
+ * used - tree is compiled again and file replaced
+ */
+void TestCompileCache::corruptFile() {
+    Network network;
+    build(network);
+    NetworkSnapshot s = network.snapshot();
+    quint64 key = JunctionTree::key(s);
+    CompileCache cache(dir);
+    cache.tree(s);
+
+    QString name = QString("%1/%2.jt").arg(dir).arg(key, 16, 16, QChar('0'));
+    QFile file(name);
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    QByteArray original = file.readAll();
+    file.close();
+
+    // Network with other cardinalities is not compiled to this file
+    Network values;
+    build(values);
+    values.insertValue(0, -1, "X");
+    values.setTable(0, QList<double>() << 0.3 << 0.6 << 0.1);
+    JunctionTree check;
+    QVERIFY(check.load(name, key, s));
+    QVERIFY(!check.load(name, key, values.snapshot()));
+
+    // Header (56 bytes) is followed by cardinalities, elimination order and
+    // clique parents of 3 nodes - clique of node 0 is made its own parent
+    QByteArray corrupt = original;
+    qint32 self = 0;
+    memcpy(corrupt.data() + 56 + 6 * sizeof(qint32), &self, sizeof(self));
+    QVERIFY(file.open(QIODevice::WriteOnly | QIODevice::Truncate));
+    file.write(corrupt);
+    file.close();
+
+    QVERIFY(!check.load(name, key, s));
+    JunctionTree tree = cache.tree(s);
+    compare(tree, s);
+    QVERIFY(check.load(name, key, s));
+
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    QCOMPARE(file.readAll(), original);
+    file.close();
+}
+
+/*
+ * Cache without directory only compiles
+ */
+void TestCompileCache::disabled() {
+    Network network;
+    build(network);
+    NetworkSnapshot s = network.snapshot();
+
+    JunctionTree tree = CompileCache("").tree(s);
+    compare(tree, s);
+    QVERIFY(cached().isEmpty());
+}
+
+QTEST_APPLESS_MAIN(TestCompileCache)
+
+#include "tst_compilecache.moc"
@@ -0,0 +1,15 @@
+# Junction tree marginals against brute force enumeration
+
+QT = core testlib
+CONFIG += console testcase
+CONFIG -= app_bundle
+
+TARGET = tst_junctiontree
+TEMPLATE = app
+
+INCLUDEPATH += ../../libbayes
+LIBS += -L$$OUT_PWD/../../libbayes -lbayes
+unix:QMAKE_RPATHDIR += $$OUT_PWD/../../libbayes
+
+SOURCES += \
+    tst_junctiontree.cpp
@@ -0,0 +1,277 @@
+/*
+    Copyright (C) 2012 Ivan Radicek
+
+    This file is part of Bayes.
+
+    Bayes is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bayes is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Bayes.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <QtTest>
+
+#include "junctiontree.h"
+#include "network.h"
+#include "node.h"
+
+/*
+ * Tests of junction tree inference - marginals are compared with ones found
+ * by summing joint distribution of whole network
+ */
+class TestJunctionTree : public QObject {
+    Q_OBJECT
+
+private slots:
+    void prior();
+    void evidence();
+    void evidenceChange();
+    void copies();
+    void impossibleEvidence();
+
+private:
+    static void build(Network &network);
+    static QVector<double> bruteForce(const NetworkSnapshot &network,
+                                      int node, QVector<int> evidence);
+    static void compare(JunctionTree &tree, const NetworkSnapshot &network,
+                        QVector<int> evidence);
+};
+
+/*
+ * Builds network with undirected cycles (A -> B -> D, A -> C -> D, D -> E,
+ * C -> E) and one three-valued node; tables are pseudo-random but fixed
+ */
+void TestJunctionTree::build(Network &network) {
+    quint32 seed = 12345;
+    QStringList names = QStringList() << "A" << "B" << "C" << "D" << "E";
+    QList<QVector<int> > parents;
+    parents << QVector<int>()
+            << (QVector<int>() << 0)
+            << (QVector<int>() << 0)
+            << (QVector<int>() << 1 << 2)
+            << (QVector<int>() << 3 << 2);
+
+    for ( int v=0; v<names.size(); ++v ) {
+        int id = network.addNode(names.at(v))->id();
+        int card = v == 1 ? 3 : 2;
+        QStringList values;
+        for ( int i=0; i<card; ++i ) {
+            values << QString("v%1").arg(i);
+        }
+        network.setValues(id, values);
+
+        int rows = 1;
+        foreach ( int p, parents.at(v) ) {
+            network.addParent(id, p);
+            rows *= network.cardinality(p);
+        }
+
+        // Each row of table sums to one
+        QList<double> table;
+        for ( int r=0; r<rows; ++r ) {
+            QList<double> row;
+            double sum = 0.0;
+            for ( int i=0; i<card; ++i ) {
+                seed = seed * 1103515245 + 12345;
+                row << 1.0 + (seed >> 16) % 100;
+                sum += row.last();
+            }
+            foreach ( double p, row ) {
+                table << p / sum;
+            }
+        }
+        network.setTable(id, table);
+    }
+}
+
+/*
+ * Gets marginal of node given evidence (-1 for nodes without it) by
+ * summing probabilities of all assignments of network
+ */
+QVector<double> TestJunctionTree::bruteForce(const NetworkSnapshot &network,
+                                             int node,
+                                             QVector<int> evidence) {
+    int n = network.nodeCount();
+    QVector<int> values(n, 0);
+    QVector<double> m(network.cardinality(node), 0.0);
+
+    while ( true ) {
+        bool consistent = true;
+        for ( int v=0; v<n; ++v ) {
+            if ( evidence.at(v) >= 0 && evidence.at(v) != values.at(v) ) {
+                consistent = false;
+            }
+        }
+
+        // Table index of node: its parents and node itself, last one
+        // changes fastest
+        if ( consistent ) {
+            double p = 1.0;
+            for ( int v=0; v<n; ++v ) {
+                int i = 0;
+                foreach ( int u, network.parents(v) ) {
+                    i = i * network.cardinality(u) + values.at(u);
+                }
+                i = i * network.cardinality(v) + values.at(v);
+                p *= network.tableList(v).at(i);
+            }
+            m[values.at(node)] += p;
+        }
+
+        int v = n - 1;
+        while ( v >= 0 && ++values[v] == network.cardinality(v) ) {
+            values[v--] = 0;
+        }
+        if ( v < 0 ) {
+            break;
+        }
+    }
+
+    double sum = 0.0;
+    foreach ( double p, m ) {
+        sum += p;
+    }
+    for ( int i=0; i<m.size(); ++i ) {
+        m[i] /= sum;
+    }
+
+    return m;
+}
+
+/*
+ * Checks marginals of all nodes of tree against brute force ones
+ */
+void TestJunctionTree::compare(JunctionTree &tree,
+                               const NetworkSnapshot &network,
+                               QVector<int> evidence) {
+    for ( int v=0; v<network.nodeCount(); ++v ) {
+        QVector<double> expected = bruteForce(network, v, evidence);
+        QVector<double> found = tree.marginal(v);
+
+        QCOMPARE(found.size(), expected.size());
+        for ( int i=0; i<found.size(); ++i ) {
+            QVERIFY2(qAbs(found.at(i) - expected.at(i)) < 1e-9,
+                     qPrintable(QString("node %1, value %2: %3 instead of %4")
+                                .arg(v).arg(i).arg(found.at(i))
+                                .arg(expected.at(i))));
+        }
+    }
+}
+
+/*
+ * Marginals without evidence
+ */
+void TestJunctionTree::prior() {
+    Network network;
+    build(network);
+    NetworkSnapshot s = network.snapshot();
+    JunctionTree tree(s);
+
+    QCOMPARE(tree.nodeCount(), 5);
+    QCOMPARE(tree.cardinality(1), 3);
+    compare(tree, s, QVector<int>(5, -1));
+}
+
+/*
+ * Marginals given evidence on root, inner node and leaf
+ */
+void TestJunctionTree::evidence() {
+    Network network;
+    build(network);
+    NetworkSnapshot s = network.snapshot();
+    JunctionTree tree(s);
+
+    QVector<int> evidence(5, -1);
+    evidence[1] = 2;
+    evidence[4] = 0;
+    tree.setEvidence(1, 2);
+    tree.setEvidence(4, 0);
+    compare(tree, s, evidence);
+
+    evidence[0] = 1;
+    tree.setEvidence(0, 1);
+    compare(tree, s, evidence);
+}
+
+/*
+ * Messages kept from previous evidence are not used after it changes
+ */
+void TestJunctionTree::evidenceChange() {
+    Network network;
+    build(network);
+    NetworkSnapshot s = network.snapshot();
+    JunctionTree tree(s);
+
+    QVector<int> evidence(5, -1);
+    evidence[3] = 0;
+    tree.setEvidence(3, 0);
+    compare(tree, s, evidence);
+
+    evidence[3] = 1;
+    tree.setEvidence(3, 1);
+    compare(tree, s, evidence);
+
+    evidence[3] = -1;
+    evidence[2] = 0;
+    tree.setEvidence(3, -1);
+    tree.setEvidence(2, 0);
+    compare(tree, s, evidence);
+
+    tree.clearEvidence();
+    compare(tree, s, QVector<int>(5, -1));
+}
+
+/*
+ * Copies of tree share compiled structure but not evidence
+ */
+void TestJunctionTree::copies() {
+    Network network;
+    build(network);
+    NetworkSnapshot s = network.snapshot();
+    JunctionTree tree(s);
+    JunctionTree copy = tree;
+
+    QVector<int> evidence(5, -1);
+    evidence[4] = 1;
+    copy.setEvidence(4, 1);
+
+    compare(copy, s, evidence);
+    QCOMPARE(tree.evidence(4), -1);
+    compare(tree, s, QVector<int>(5, -1));
+}
+
+/*
+ * Evidence of zero probability gives uniform marginals
+ */
+void TestJunctionTree::impossibleEvidence() {
+    Network network;
+    network.addNode("A");
+    network.setValues(0, QStringList() << "T" << "F");
+    network.setTable(0, QList<double>() << 1.0 << 0.0);
+    network.addNode("B");
+    network.setValues(1, QStringList() << "T" << "F" << "X");
+    network.addParent(1, 0);
+    network.setTable(1, QList<double>() << 0.5 << 0.25 << 0.25
+                                        << 0.2 << 0.3 << 0.5);
+
+    JunctionTree tree(network.snapshot());
+    tree.setEvidence(0, 1);
+
+    QVector<double> m = tree.marginal(1);
+    QCOMPARE(m.size(), 3);
+    for ( int i=0; i<m.size(); ++i ) {
+        QVERIFY(qAbs(m.at(i) - 1.0 / 3) < 1e-12);
+    }
+}
+
+QTEST_APPLESS_MAIN(TestJunctionTree)
+
+#include "tst_junctiontree.moc"
@@ -0,0 +1,15 @@
+# Binary .netb network files
+
+QT = core testlib
+CONFIG += console testcase
+CONFIG -= app_bundle
+
+TARGET = tst_netbfile
+TEMPLATE = app
+
+INCLUDEPATH += ../../libbayes
+LIBS += -L$$OUT_PWD/../../libbayes -lbayes
+unix:QMAKE_RPATHDIR += $$OUT_PWD/../../libbayes
+
+SOURCES += \
+    tst_netbfile.cpp
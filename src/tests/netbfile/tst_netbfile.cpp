@@ -0,0 +1,297 @@
+/*
+    Copyright (C) 2012 Ivan Radicek
+
+    This file is part of Bayes.
+
+    Bayes is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bayes is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Bayes.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <QtTest>
+#include <QTemporaryFile>
+
+#include <string.h>
+
+#include "netbfile.h"
+#include "netfile.h"
+#include "network.h"
+#include "node.h"
+
+/*
+ * Tests of binary network files - networks read back equal to ones written
+ * (tables bit for bit), damaged files and invalid networks are rejected
+ */
+class TestNetbFile : public QObject {
+    Q_OBJECT
+
+private slots:
+    void roundTrip();
+    void textRoundTrip();
+    void mappedTables();
+    void bigTable();
+    void damaged();
+    void invalidNotSaved();
+
+private:
+    static void build(Network &network);
+    static void compare(const Network &n1, const Network &n2);
+    static QString tempName();
+};
+
+/*
+ * Builds network with nodes A, B and C (A is parent of B and C, B of C),
+ * shared value names and meta data of every type
+ */
+void TestNetbFile::build(Network &network) {
+    network.setName("binary");
+
+    int a = network.addNode("A")->id();
+    network.setValues(a, QStringList() << "T" << "F");
+    network.setTable(a, QList<double>() << 0.1 << 0.9);
+    network.setMeta(a, "x", 10.5);
+    network.setMeta(a, "label", QString::fromUtf8("\xc5\xa1ljiva"));
+    network.setMeta(a, "shown", true);
+    network.setMeta(a, "none", QVariant());
+
+    int b = network.addNode("B")->id();
+    network.setValues(b, QStringList() << "T" << "F" << "X");
+    network.addParent(b, a);
+    network.setTable(b, QList<double>() << 1.0 / 3 << 1.0 / 3 << 1.0 / 3
+                                        << 0.25 << 0.5 << 0.25);
+
+    int c = network.addNode("C")->id();
+    network.setValues(c, QStringList() << "T" << "F");
+    network.addParent(c, a);
+    network.addParent(c, b);
+    QList<double> table;
+    for ( int i=0; i<6; ++i ) {
+        table << 0.1 * i << 1.0 - 0.1 * i;
+    }
+    network.setTable(c, table);
+}
+
+/*
+ * Checks that networks have same names, values, parents, tables and meta
+ * data
+ */
+void TestNetbFile::compare(const Network &n1, const Network &n2) {
+    QCOMPARE(n1.name(), n2.name());
+    QCOMPARE(n1.nodeCount(), n2.nodeCount());
+
+    for ( int id=0; id<n1.nodeCount(); ++id ) {
+        QCOMPARE(n1.nodeName(id), n2.nodeName(id));
+        QCOMPARE(n1.values(id), n2.values(id));
+        QCOMPARE(n1.parents(id), n2.parents(id));
+        QCOMPARE(n1.tableList(id), n2.tableList(id));
+
+        QVariantHash m1 = n1.meta(id);
+        QVariantHash m2 = n2.meta(id);
+        QCOMPARE(m1.keys().toSet(), m2.keys().toSet());
+        foreach ( QString key, m1.keys() ) {
+            QCOMPARE(m1.value(key).type(), m2.value(key).type());
+            QCOMPARE(m1.value(key), m2.value(key));
+        }
+    }
+}
+
+/*
+ * Gets name of file in temporary directory which does not exist yet
+ */
+QString TestNetbFile::tempName() {
+    QTemporaryFile f(QDir::tempPath() + "/tst_netbfile.XXXXXX");
+    f.open();
+    return f.fileName() + ".netb";
+}
+
+/*
+ * Written network reads back the same, also through NetFile (which
+ * recognizes binary file by its contents)
+ */
+void TestNetbFile::roundTrip() {
+    Network network;
+    build(network);
+
+    QString fileName = tempName();
+    QString error;
+    QVERIFY2(NetbFile::write(fileName, &network, error), qPrintable(error));
+    QVERIFY(NetbFile::matches(fileName));
+
+    Network read;
+    QVERIFY2(NetbFile::read(fileName, &read, error), qPrintable(error));
+    compare(network, read);
+
+    Network readText;
+    QVERIFY2(NetFile::read(fileName, &readText, error), qPrintable(error));
+    compare(network, readText);
+
+    QFile::remove(fileName);
+}
+
+/*
+ * Network converted from text file to binary one and back keeps its tables
+ * and types of meta data
+ */
+void TestNetbFile::textRoundTrip() {
+    Network network;
+    build(network);
+
+    QString binaryName = tempName();
+    QString textName = tempName();
+    textName.chop(1);
+    QString error;
+
+    QVERIFY2(NetFile::write(textName, &network, error), qPrintable(error));
+    Network fromText;
+    QVERIFY2(NetFile::read(textName, &fromText, error), qPrintable(error));
+    compare(network, fromText);
+
+    QVERIFY2(NetFile::write(binaryName, &fromText, error),
+             qPrintable(error));
+    QVERIFY(NetbFile::matches(binaryName));
+    Network fromBinary;
+    QVERIFY2(NetFile::read(binaryName, &fromBinary, error),
+             qPrintable(error));
+    compare(network, fromBinary);
+
+    QVERIFY2(NetFile::write(textName, &fromBinary, error), qPrintable(error));
+    QVERIFY(!NetbFile::matches(textName));
+    Network back;
+    QVERIFY2(NetFile::read(textName, &back, error), qPrintable(error));
+    compare(network, back);
+
+    QFile::remove(textName);
+    QFile::remove(binaryName);
+}
+
+/*
+ * Open file gives network contents without reading them into network
+ */
+void TestNetbFile::mappedTables() {
+    Network network;
+    build(network);
+
+    QString fileName = tempName();
+    QString error;
+    QVERIFY2(NetbFile::write(fileName, &network, error), qPrintable(error));
+
+    NetbFile f;
+    QVERIFY2(f.open(fileName, error), qPrintable(error));
+    QCOMPARE(f.name(), network.name());
+    QCOMPARE(f.nodeCount(), 3);
+    QCOMPARE(f.parents(2), QVector<int>() << 0 << 1);
+
+    for ( int id=0; id<3; ++id ) {
+        QCOMPARE(f.nodeName(id), network.nodeName(id));
+        QCOMPARE(f.values(id), network.values(id));
+        QCOMPARE(f.tableSize(id), network.tableSize(id));
+        QVERIFY(memcmp(f.table(id), network.table(id),
+                       f.tableSize(id) * sizeof(double)) == 0);
+    }
+
+    f.close();
+    QVERIFY(!f.isOpen());
+
+    QFile::remove(fileName);
+}
+
+/*
+ * Tables of at least page size start on page boundary and survive exactly
+ */
+void TestNetbFile::bigTable() {
+    Network network;
+    int a = network.addNode("A")->id();
+    QStringList values;
+    QList<double> table;
+    for ( int i=0; i<1024; ++i ) {
+        values << QString::number(i);
+        table << (i % 2 == 0 ? 1.0 / 3 : 2.0 / 3) / 512;
+    }
+    network.setValues(a, values);
+    network.setTable(a, table);
+
+    QString fileName = tempName();
+    QString error;
+    QVERIFY2(NetbFile::write(fileName, &network, error), qPrintable(error));
+
+    NetbFile f;
+    QVERIFY2(f.open(fileName, error), qPrintable(error));
+    QCOMPARE(f.tableSize(0), 1024);
+    QCOMPARE((quintptr) f.table(0) % 4096, (quintptr) 0);
+    QVERIFY(memcmp(f.table(0), network.table(a), 1024 * sizeof(double)) == 0);
+    f.close();
+
+    QFile::remove(fileName);
+}
+
+/*
+ * Truncated file and file with wrong magic are not opened
+ */
+void TestNetbFile::damaged() {
+    Network network;
+    build(network);
+
+    QString fileName = tempName();
+    QString error;
+    QVERIFY2(NetbFile::write(fileName, &network, error), qPrintable(error));
+
+    QFile file(fileName);
+    QVERIFY(file.open(QIODevice::ReadWrite));
+    QByteArray contents = file.readAll();
+    QVERIFY(file.resize(contents.size() / 2));
+    file.close();
+
+    Network read;
+    QVERIFY(!NetbFile::read(fileName, &read, error));
+    QVERIFY(!error.isEmpty());
+    QCOMPARE(read.nodeCount(), 0);
+
+    contents[0] = 'X';
+    QVERIFY(file.open(QIODevice::WriteOnly | QIODevice::Truncate));
+    file.write(contents);
+    file.close();
+
+    QVERIFY(!NetbFile::matches(fileName));
+    QVERIFY(!NetbFile::read(fileName, &read, error));
+
+    QFile::remove(fileName);
+}
+
+/*
+ * Invalid network is not written and file it would replace stays intact
+ */
+void TestNetbFile::invalidNotSaved() {
+    Network network;
+    build(network);
+
+    QString fileName = tempName();
+    QString error;
+    QVERIFY2(NetbFile::write(fileName, &network, error), qPrintable(error));
+
+    QFile file(fileName);
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    QByteArray saved = file.readAll();
+    file.close();
+
+    network.clearTable(2, 3);
+    QVERIFY(!NetbFile::write(fileName, &network, error));
+
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    QCOMPARE(file.readAll(), saved);
+    file.close();
+
+    QFile::remove(fileName);
+}
+
+QTEST_APPLESS_MAIN(TestNetbFile)
+
+#include "tst_netbfile.moc"
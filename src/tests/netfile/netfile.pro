@@ -0,0 +1,15 @@
+# Reading, writing and checking of .net files
+
+QT = core testlib
+CONFIG += console testcase
+CONFIG -= app_bundle
+
+TARGET = tst_netfile
+TEMPLATE = app
+
+INCLUDEPATH += ../../libbayes
+LIBS += -L$$OUT_PWD/../../libbayes -lbayes
+unix:QMAKE_RPATHDIR += $$OUT_PWD/../../libbayes
+
+SOURCES += \
+    tst_netfile.cpp
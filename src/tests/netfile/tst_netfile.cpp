@@ -0,0 +1,214 @@
+/*
+    Copyright (C) 2012 Ivan Radicek
+
+    This file is part of Bayes.
+
+    Bayes is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bayes is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Bayes.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <QtTest>
+#include <QTemporaryFile>
+
+#include "netfile.h"
+#include "network.h"
+#include "node.h"
+
+/*
+ * Tests of .net files - networks read back equal to ones written, invalid
+ * networks are neither read nor written
+ */
+class TestNetFile : public QObject {
+    Q_OBJECT
+
+private slots:
+    void roundTrip();
+    void readData();
+    void checkInvalid();
+    void invalidNotSaved();
+
+private:
+    static void build(Network &network);
+    static void compare(const Network &n1, const Network &n2);
+    static QString tempName();
+};
+
+/*
+ * Builds network with nodes A and B (A is parent of B), names needing
+ * quotes, numbers which are not short in decimal and meta data
+ */
+void TestNetFile::build(Network &network) {
+    network.setName("test \"network\"");
+
+    int a = network.addNode("A")->id();
+    network.setValues(a, QStringList() << "T" << "F\\x");
+    network.setTable(a, QList<double>() << 0.1 << 0.9);
+    network.setMeta(a, "x", 10.5);
+    network.setMeta(a, "label", "first");
+    network.setMeta(a, "shown", true);
+    network.setMeta(a, "color", QVariant());
+
+    int b = network.addNode("B")->id();
+    network.setValues(b, QStringList() << "1" << "2" << "3");
+    network.addParent(b, a);
+    network.setTable(b, QList<double>() << 1.0 / 3 << 1.0 / 3 << 1.0 / 3
+                                        << 0.25 << 0.5 << 0.25);
+}
+
+/*
+ * Checks that networks have same names, values, parents, tables and meta
+ * data
+ */
+void TestNetFile::compare(const Network &n1, const Network &n2) {
+    QCOMPARE(n1.name(), n2.name());
+    QCOMPARE(n1.nodeCount(), n2.nodeCount());
+
+    for ( int id=0; id<n1.nodeCount(); ++id ) {
+        QCOMPARE(n1.nodeName(id), n2.nodeName(id));
+        QCOMPARE(n1.values(id), n2.values(id));
+        QCOMPARE(n1.parents(id), n2.parents(id));
+        QCOMPARE(n1.tableList(id), n2.tableList(id));
+        QCOMPARE(n1.meta(id).keys().toSet(), n2.meta(id).keys().toSet());
+        foreach ( QString key, n1.meta(id).keys() ) {
+            QVariant v1 = n1.meta(id).value(key);
+            QVariant v2 = n2.meta(id).value(key);
+            QCOMPARE(v1.type(), v2.type());
+            QCOMPARE(v1, v2);
+        }
+    }
+}
+
+/*
+ * Gets name of file in temporary directory which does not exist yet
+ */
+QString TestNetFile::tempName() {
+    QTemporaryFile f(QDir::tempPath() + "/tst_netfile.XXXXXX");
+    f.open();
+    return f.fileName() + ".net";
+}
+
+/*
+ * Written network reads back the same (tables exactly)
+ */
+void TestNetFile::roundTrip() {
+    Network network;
+    build(network);
+
+    QString fileName = tempName();
+    QString error;
+    QVERIFY2(NetFile::write(fileName, &network, error), qPrintable(error));
+
+    Network read;
+    QVERIFY2(NetFile::read(fileName, &read, error), qPrintable(error));
+    compare(network, read);
+
+    QFile::remove(fileName);
+}
+
+/*
+ * Network is read from text in memory as from file
+ */
+void TestNetFile::readData() {
+    QByteArray text =
+            "((NETWORK :NAME \"mem\")"
+            " (NODE :NAME \"B\" :VALS (\"T\" \"F\") :PARENTS (\"A\")"
+            " :TABLE (0.9 0.1 2/10 8d-1) :META NIL)"
+            " (NODE :NAME \"A\" :VALS (\"T\" \"F\") :PARENTS NIL"
+            " :TABLE (0.3 0.7) :META (:X 1)))";
+
+    Network network;
+    QString error;
+    QVERIFY2(NetFile::readData(text, &network, error), qPrintable(error));
+
+    QCOMPARE(network.name(), QString("mem"));
+    QCOMPARE(network.nodeCount(), 2);
+    QCOMPARE(network.parents(0), QVector<int>() << 1);
+    QCOMPARE(network.tableList(0), QList<double>() << 0.9 << 0.1 << 0.2
+                                                   << 0.8);
+    QCOMPARE(network.meta(0), QVariantHash());
+    QCOMPARE(network.meta(1).keys(), QStringList() << "x");
+    QCOMPARE(network.meta(1).value("x").type(), QVariant::Double);
+    QCOMPARE(network.meta(1).value("x").toDouble(), 1.0);
+
+    QVERIFY(!NetFile::readData("((NETWORK :NAME \"x\")", &network, error));
+    QVERIFY(!error.isEmpty());
+}
+
+/*
+ * Networks which could not be read back do not pass check
+ */
+void TestNetFile::checkInvalid() {
+    QString error;
+
+    Network valid;
+    build(valid);
+    QVERIFY2(NetFile::check(&valid, error), qPrintable(error));
+
+    Network sum;
+    build(sum);
+    sum.setProbability(0, 0, 0.5);
+    QVERIFY(!NetFile::check(&sum, error));
+
+    Network size;
+    build(size);
+    size.insertValue(0, -1, "X");
+    QVERIFY(!NetFile::check(&size, error));
+
+    Network duplicate;
+    build(duplicate);
+    duplicate.setNodeName(1, "A");
+    QVERIFY(!NetFile::check(&duplicate, error));
+
+    Network cycle;
+    build(cycle);
+    cycle.addParent(0, 1);
+    cycle.setTable(0, QList<double>() << 0.5 << 0.5 << 0.5 << 0.5
+                                      << 0.5 << 0.5);
+    QVERIFY(!NetFile::check(&cycle, error));
+}
+
+/*
+ * Invalid network is not written and file it would replace stays intact
+ */
+void TestNetFile::invalidNotSaved() {
+    Network network;
+    build(network);
+
+    QString fileName = tempName();
+    QString error;
+    QVERIFY2(NetFile::write(fileName, &network, error), qPrintable(error));
+
+    QFile file(fileName);
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    QByteArray saved = file.readAll();
+    file.close();
+
+    network.setProbability(1, 0, 0.9);
+    QVERIFY(!NetFile::write(fileName, &network, error));
+
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    QCOMPARE(file.readAll(), saved);
+    file.close();
+
+    // No temporary file is left behind
+    QFileInfo info(fileName);
+    QStringList left = info.dir().entryList(QStringList()
+                                            << info.fileName() + ".*");
+    QVERIFY(left.isEmpty());
+
+    QFile::remove(fileName);
+}
+
+QTEST_APPLESS_MAIN(TestNetFile)
+
+#include "tst_netfile.moc"
@@ -0,0 +1,19 @@
+# Query cache keys and lookups
+
+QT = core testlib
+CONFIG += console testcase
+CONFIG -= app_bundle
+
+TARGET = tst_querycache
+TEMPLATE = app
+
+INCLUDEPATH += ../.. ../../libbayes
+LIBS += -L$$OUT_PWD/../../libbayes -lbayes
+unix:QMAKE_RPATHDIR += $$OUT_PWD/../../libbayes
+
+SOURCES += \
+    tst_querycache.cpp \
+    ../../querycache.cpp
+
+HEADERS += \
+    ../../querycache.h
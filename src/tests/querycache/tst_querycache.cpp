@@ -0,0 +1,190 @@
+/*
+    Copyright (C) 2012 Ivan Radicek
+
+    This file is part of Bayes.
+
+    Bayes is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bayes is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Bayes.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <QtTest>
+
+#include "querycache.h"
+#include "network.h"
+#include "node.h"
+
+/*
+ * Tests of query cache keys (same query on same network always gives same
+ * key, any change gives different one) and of cache itself
+ */
+class TestQueryCache : public QObject {
+    Q_OBJECT
+
+private slots:
+    void sameNetwork();
+    void evidenceOrder();
+    void networkChange();
+    void queryChange();
+    void lookup();
+
+private:
+    static void build(Network &network);
+    static QList<Node*> nodes(const Network &network);
+    static QVariantList query(QString a, QString b);
+};
+
+/*
+ * Builds network with nodes A and B (A is parent of B)
+ */
+void TestQueryCache::build(Network &network) {
+    network.setName("test");
+
+    int a = network.addNode("A")->id();
+    network.setValues(a, QStringList() << "T" << "F");
+    network.setTable(a, QList<double>() << 0.3 << 0.7);
+
+    int b = network.addNode("B")->id();
+    network.setValues(b, QStringList() << "T" << "F");
+    network.addParent(b, a);
+    network.setTable(b, QList<double>() << 0.9 << 0.1 << 0.2 << 0.8);
+}
+
+/*
+ * Gets all nodes of network in order of ids
+ */
+QList<Node*> TestQueryCache::nodes(const Network &network) {
+    QList<Node*> list;
+
+    for ( int id=0; id<network.nodeCount(); ++id ) {
+        list << network.node(id);
+    }
+
+    return list;
+}
+
+/*
+ * Builds query arguments with evidence on A and B (in that order)
+ */
+QVariantList TestQueryCache::query(QString a, QString b) {
+    return QVariantList() << "Gibbs sampling" << 1000
+                          << QVariant(QVariantList() << "A" << a)
+                          << QVariant(QVariantList() << "B" << b);
+}
+
+/*
+ * Separately built equal networks give equal keys
+ */
+void TestQueryCache::sameNetwork() {
+    Network n1;
+    Network n2;
+    build(n1);
+    build(n2);
+
+    QCOMPARE(QueryCache::key(nodes(n1), query("T", "F")),
+             QueryCache::key(nodes(n2), query("T", "F")));
+    QCOMPARE(QueryCache::key(nodes(n1), query("T", "F")),
+             QueryCache::key(nodes(n1), query("T", "F")));
+}
+
+/*
+ * Order in which evidence is given does not matter
+ */
+void TestQueryCache::evidenceOrder() {
+    Network n;
+    build(n);
+
+    QVariantList reversed;
+    reversed << "Gibbs sampling" << 1000
+             << QVariant(QVariantList() << "B" << "F")
+             << QVariant(QVariantList() << "A" << "T");
+
+    QCOMPARE(QueryCache::key(nodes(n), query("T", "F")),
+             QueryCache::key(nodes(n), reversed));
+}
+
+/*
+ * Changes of table, values, structure or names give new keys
+ */
+void TestQueryCache::networkChange() {
+    Network n;
+    build(n);
+    QString key = QueryCache::key(nodes(n), query("T", "F"));
+
+    n.setProbability(0, 0, 0.4);
+    n.setProbability(0, 1, 0.6);
+    QString tableKey = QueryCache::key(nodes(n), query("T", "F"));
+    QVERIFY(tableKey != key);
+
+    n.renameValue(1, 1, "X");
+    QString valueKey = QueryCache::key(nodes(n), query("T", "F"));
+    QVERIFY(valueKey != tableKey);
+
+    n.removeParent(1, 0);
+    QString parentKey = QueryCache::key(nodes(n), query("T", "F"));
+    QVERIFY(parentKey != valueKey);
+
+    n.setNodeName(0, "C");
+    QVERIFY(QueryCache::key(nodes(n), query("T", "F")) != parentKey);
+}
+
+/*
+ * Changes of algorithm, its parameter, evidence or options give new keys
+ */
+void TestQueryCache::queryChange() {
+    Network n;
+    build(n);
+    QString key = QueryCache::key(nodes(n), query("T", "F"));
+
+    QVERIFY(QueryCache::key(nodes(n), query("T", "T")) != key);
+
+    QVariantList args = query("T", "F");
+    args[0] = "Likelihood weighting";
+    QVERIFY(QueryCache::key(nodes(n), args) != key);
+
+    args = query("T", "F");
+    args[1] = 2000;
+    QVERIFY(QueryCache::key(nodes(n), args) != key);
+
+    QVERIFY(QueryCache::key(nodes(n), query("T", "F"),
+                            QVariantList() << 0.001) != key);
+}
+
+/*
+ * Stored results are found, counted and dropped when cache is full
+ */
+void TestQueryCache::lookup() {
+    QueryCache cache(2);
+    QueryResult result;
+    result << (QList<double>() << 0.25 << 0.75);
+
+    QueryResult found;
+    QVERIFY(!cache.lookup("a", found));
+
+    cache.insert("a", result);
+    QVERIFY(cache.lookup("a", found));
+    QCOMPARE(found, result);
+    QCOMPARE(cache.hits(), 1);
+    QCOMPARE(cache.misses(), 1);
+
+    cache.insert("b", result);
+    cache.insert("c", result);
+    QVERIFY(!cache.lookup("a", found));
+    QVERIFY(cache.lookup("c", found));
+
+    cache.clear();
+    QVERIFY(!cache.lookup("c", found));
+}
+
+QTEST_APPLESS_MAIN(TestQueryCache)
+
+#include "tst_querycache.moc"
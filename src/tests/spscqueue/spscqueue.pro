@@ -0,0 +1,16 @@
+# Lock-free queue between engine I/O and GUI threads
+
+QT = core testlib
+CONFIG += console testcase
+CONFIG -= app_bundle
+
+TARGET = tst_spscqueue
+TEMPLATE = app
+
+INCLUDEPATH += ../..
+
+SOURCES += \
+    tst_spscqueue.cpp
+
+HEADERS += \
+    ../../spscqueue.h
@@ -0,0 +1,136 @@
+/*
+    Copyright (C) 2012 Ivan Radicek
+
+    This file is part of Bayes.
+
+    Bayes is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bayes is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Bayes.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <QtTest>
+#include <QThread>
+
+#include "spscqueue.h"
+
+// Number of items passed between threads
+static const int ItemCount = 1000000;
+
+/*
+ * Thread pushing numbers 0, 1, ... to queue
+ */
+class Producer : public QThread {
+public:
+    Producer(SpscQueue<int> *queue) : queue(queue) {}
+
+protected:
+    void run() {
+        for ( int i=0; i<ItemCount; ++i ) {
+            queue->push(i);
+        }
+    }
+
+private:
+    SpscQueue<int> *queue;
+};
+
+/*
+ * Tests of single producer single consumer queue
+ */
+class TestSpscQueue : public QObject {
+    Q_OBJECT
+
+private slots:
+    void empty();
+    void order();
+    void values();
+    void threads();
+};
+
+/*
+ * Nothing can be taken from new or emptied queue
+ */
+void TestSpscQueue::empty() {
+    SpscQueue<int> queue;
+    int item = -1;
+
+    QVERIFY(!queue.pop(item));
+    QCOMPARE(item, -1);
+
+    queue.push(1);
+    QVERIFY(queue.pop(item));
+    QVERIFY(!queue.pop(item));
+    QCOMPARE(item, 1);
+}
+
+/*
+ * Items come out in order they were pushed, also when pushes and pops
+ * interleave
+ */
+void TestSpscQueue::order() {
+    SpscQueue<int> queue;
+    int item;
+
+    queue.push(1);
+    queue.push(2);
+    QVERIFY(queue.pop(item));
+    QCOMPARE(item, 1);
+
+    queue.push(3);
+    QVERIFY(queue.pop(item));
+    QCOMPARE(item, 2);
+    QVERIFY(queue.pop(item));
+    QCOMPARE(item, 3);
+}
+
+/*
+ * Implicitly shared values (as engine data) pass whole, null ones included
+ */
+void TestSpscQueue::values() {
+    SpscQueue<QByteArray> queue;
+    QByteArray item;
+
+    queue.push(QByteArray("(1 query)"));
+    queue.push(QByteArray());
+
+    QVERIFY(queue.pop(item));
+    QCOMPARE(item, QByteArray("(1 query)"));
+    QVERIFY(queue.pop(item));
+    QVERIFY(item.isNull());
+}
+
+/*
+ * Consumer sees all items of producer running in other thread, in order
+ */
+void TestSpscQueue::threads() {
+    SpscQueue<int> queue;
+    Producer producer(&queue);
+    producer.start();
+
+    int expected = 0;
+    int item;
+    while ( expected < ItemCount ) {
+        if ( queue.pop(item) ) {
+            QCOMPARE(item, expected);
+            ++expected;
+        } else {
+            QThread::yieldCurrentThread();
+        }
+    }
+
+    producer.wait();
+    QVERIFY(!queue.pop(item));
+}
+
+QTEST_APPLESS_MAIN(TestSpscQueue)
+
+#include "tst_spscqueue.moc"
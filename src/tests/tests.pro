@@ -0,0 +1,5 @@
+# Unit tests of libbayes and GUI side modules (run with make check)
+
+TEMPLATE = subdirs
+
+SUBDIRS = querycache spscqueue junctiontree netfile netbfile compilecache